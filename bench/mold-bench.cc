@@ -0,0 +1,779 @@
+// mold-bench generates a reproducible synthetic program, links it with
+// mold a few times and reports per-phase timings as JSON.
+//
+// The generated program is written in a small subset of C++ so that the
+// target compiler emits everything a real-world program would give to
+// the linker: relocations between object files, mergeable string
+// sections, COMDAT groups (inline functions), .eh_frame, DWARF debug
+// info, archive members and shared libraries. The program does not
+// depend on libc or crt files, so the link command contains nothing but
+// the generated files, and it is linkable for any target as long as a
+// cross compiler is given by `--cc`.
+//
+// The shape of the program is controlled by command line options and a
+// random seed. The same options and the same compiler always produce the
+// same input files. Symbol popularity (i.e. which functions, strings and
+// inline functions are referenced by others) follows a Zipf distribution
+// whose exponent is given by `--skew`. Object file sizes follow a Zipf
+// distribution too, whose exponent is given by `--size-skew`.
+//
+// The link is run with `--perf-trace`, and the phase records in the trace
+// file (which are the TimerRecords that `--perf` would print) are
+// collected into the output.
+
+#include "../lib/integers.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <set>
+#include <span>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mold {
+
+static const char helpmsg[] = R"(Usage: mold-bench [options] [-- linker-options...]
+
+Options:
+  --help                      Report usage information
+  --objects N                 Number of object files to link directly [500]
+  --symbols N                 Average number of functions per object file [100]
+  --strings N                 Number of string literals per object file [20]
+  --string-pool N             Number of distinct string literals [10000]
+  --comdats N                 Number of inline functions per object file [10]
+  --comdat-pool N             Number of distinct inline functions [500]
+  --archives N                Number of archive files [4]
+  --archive-members N         Number of members in each archive file [50]
+  --dsos N                    Number of shared libraries [2]
+  --dso-objects N             Number of object files in each shared library [20]
+  --skew S                    Zipf exponent of symbol popularity [1.0]
+  --size-skew S               Zipf exponent of object file sizes [0.5]
+  --seed N                    Random seed [1]
+  --no-debug-info             Do not generate DWARF debug info
+  --runs N                    Number of measured links [3]
+  --warmup N                  Number of unmeasured links before measuring [1]
+  --jobs N, -j N              Number of parallel compiler processes
+  --dir DIR                   Directory for generated files [mold-bench.out]
+  --mold PATH                 mold executable [mold next to mold-bench]
+  --cc COMMAND                C++ compiler to compile generated files [cc]
+  --ar COMMAND                Archiver to create archive files [ar]
+  -o FILE, --output FILE      Write the JSON report to FILE instead of stdout
+
+Options after `--` are appended to the link command line.)";
+
+struct Config {
+  i64 objects = 500;
+  i64 symbols = 100;
+  i64 strings = 20;
+  i64 string_pool = 10000;
+  i64 comdats = 10;
+  i64 comdat_pool = 500;
+  i64 archives = 4;
+  i64 archive_members = 50;
+  i64 dsos = 2;
+  i64 dso_objects = 20;
+  double skew = 1.0;
+  double size_skew = 0.5;
+  i64 seed = 1;
+  bool debug_info = true;
+  i64 runs = 3;
+  i64 warmup = 1;
+  i64 jobs = std::max<i64>(1, std::thread::hardware_concurrency());
+  std::string dir = "mold-bench.out";
+  std::string mold;
+  std::string cc = "cc";
+  std::string ar = "ar";
+  std::string output;
+  std::vector<std::string> link_args;
+};
+
+[[noreturn]] static void fatal(const std::string &msg) {
+  std::cerr << "mold-bench: " << msg << "\n";
+  exit(1);
+}
+
+static std::string quote(const std::string &s) {
+  std::string out = "'";
+  for (char c : s) {
+    if (c == '\'')
+      out += "'\\''";
+    else
+      out += c;
+  }
+  return out + "'";
+}
+
+static int run(const std::string &cmd) {
+  int status = std::system(cmd.c_str());
+  return (status == 0) ? 0 : 1;
+}
+
+// Returns true if `opt` is an option that takes an argument.
+static bool takes_argument(const std::string &opt) {
+  return std::string_view(helpmsg).find(" " + opt + " ") != std::string_view::npos;
+}
+
+static Config parse_args(int argc, char **argv) {
+  Config config;
+  std::vector<std::string> args(argv + 1, argv + argc);
+
+  for (i64 i = 0; i < args.size(); i++) {
+    std::string opt = args[i];
+
+    if (opt == "--") {
+      config.link_args.assign(args.begin() + i + 1, args.end());
+      break;
+    }
+
+    if (opt == "--help") {
+      std::cout << helpmsg << "\n";
+      exit(0);
+    }
+
+    if (opt == "--no-debug-info") {
+      config.debug_info = false;
+      continue;
+    }
+
+    std::string name = opt;
+    std::string val;
+
+    if (size_t pos = opt.find('='); opt.starts_with("--") && pos != opt.npos) {
+      name = opt.substr(0, pos);
+      val = opt.substr(pos + 1);
+    } else if ((opt.starts_with("-j") || opt.starts_with("-o")) && opt.size() > 2) {
+      name = opt.substr(0, 2);
+      val = opt.substr(2);
+    } else if (!opt.starts_with("-") || !takes_argument(opt)) {
+      fatal("unknown command line option: " + opt);
+    } else {
+      if (i + 1 == args.size())
+        fatal("option " + opt + ": argument missing");
+      val = args[++i];
+    }
+
+    auto get_int = [&] {
+      char *end;
+      i64 v = strtoll(val.c_str(), &end, 0);
+      if (val.empty() || *end || v < 0)
+        fatal("option " + name + ": not a non-negative integer: " + val);
+      return v;
+    };
+
+    auto get_double = [&] {
+      char *end;
+      double v = strtod(val.c_str(), &end);
+      if (val.empty() || *end || v < 0)
+        fatal("option " + name + ": not a non-negative number: " + val);
+      return v;
+    };
+
+    if (name == "--objects")
+      config.objects = get_int();
+    else if (name == "--symbols")
+      config.symbols = std::max<i64>(1, get_int());
+    else if (name == "--strings")
+      config.strings = get_int();
+    else if (name == "--string-pool")
+      config.string_pool = std::max<i64>(1, get_int());
+    else if (name == "--comdats")
+      config.comdats = get_int();
+    else if (name == "--comdat-pool")
+      config.comdat_pool = std::max<i64>(1, get_int());
+    else if (name == "--archives")
+      config.archives = get_int();
+    else if (name == "--archive-members")
+      config.archive_members = get_int();
+    else if (name == "--dsos")
+      config.dsos = get_int();
+    else if (name == "--dso-objects")
+      config.dso_objects = get_int();
+    else if (name == "--skew")
+      config.skew = get_double();
+    else if (name == "--size-skew")
+      config.size_skew = get_double();
+    else if (name == "--seed")
+      config.seed = get_int();
+    else if (name == "--runs")
+      config.runs = std::max<i64>(1, get_int());
+    else if (name == "--warmup")
+      config.warmup = get_int();
+    else if (name == "--jobs" || name == "-j")
+      config.jobs = std::max<i64>(1, get_int());
+    else if (name == "--dir")
+      config.dir = val;
+    else if (name == "--mold")
+      config.mold = val;
+    else if (name == "--cc")
+      config.cc = val;
+    else if (name == "--ar")
+      config.ar = val;
+    else if (name == "--output" || name == "-o")
+      config.output = val;
+    else
+      fatal("unknown command line option: " + opt);
+  }
+
+  if (config.mold.empty()) {
+    std::error_code ec;
+    std::filesystem::path self = std::filesystem::read_symlink("/proc/self/exe", ec);
+    if (!ec && std::filesystem::exists(self.parent_path() / "mold"))
+      config.mold = self.parent_path() / "mold";
+    else
+      config.mold = "mold";
+  }
+
+  if (config.mold.find('/') != config.mold.npos)
+    config.mold = std::filesystem::absolute(config.mold);
+  return config;
+}
+
+// We don't use std::uniform_real_distribution and friends because their
+// output is implementation-defined. std::mt19937_64 is fully specified,
+// so the same seed yields the same program everywhere.
+class Random {
+public:
+  Random(u64 seed) : gen(seed) {}
+
+  u64 next() { return gen(); }
+  i64 below(i64 n) { return next() % n; }
+  double real() { return (next() >> 11) * 0x1.0p-53; }
+
+private:
+  std::mt19937_64 gen;
+};
+
+// Returns a value in [0, n) where 0 is the most likely.
+class Zipf {
+public:
+  Zipf(i64 n, double s) : cdf(n) {
+    double sum = 0;
+    for (i64 i = 0; i < n; i++)
+      cdf[i] = (sum += 1 / std::pow(i + 1, s));
+  }
+
+  i64 operator()(Random &rand) const {
+    double x = rand.real() * cdf.back();
+    return std::upper_bound(cdf.begin(), cdf.end(), x) - cdf.begin();
+  }
+
+  double weight(i64 i) const {
+    return (cdf[i] - (i ? cdf[i - 1] : 0)) / cdf.back();
+  }
+
+private:
+  std::vector<double> cdf;
+};
+
+template <typename T>
+static void shuffle(std::vector<T> &vec, Random &rand) {
+  for (i64 i = vec.size() - 1; i > 0; i--)
+    std::swap(vec[i], vec[rand.below(i + 1)]);
+}
+
+// A set of functions that may be referenced from a unit, in the order
+// of popularity.
+struct Pool {
+  Pool(std::vector<std::string> syms, double skew, Random &rand)
+    : syms(std::move(syms)), zipf(this->syms.size(), skew) {
+    shuffle(this->syms, rand);
+  }
+
+  const std::string &pick(Random &rand) const { return syms[zipf(rand)]; }
+
+  std::vector<std::string> syms;
+  Zipf zipf;
+};
+
+enum UnitKind { MAIN, ARCHIVE, DSO };
+
+struct Unit {
+  UnitKind kind;
+  i64 lib = 0;
+  i64 nfuncs = 0;
+  std::string name;
+};
+
+static std::string get_string_literal(u64 seed, i64 id) {
+  static const char chars[] = "abcdefghijklmnopqrstuvwxyz0123456789 _-";
+  Random rand(seed * 1'000'003 + id);
+  std::string str = "str" + std::to_string(id) + ":";
+  for (i64 len = 8 + rand.below(56); len > 0; len--)
+    str += chars[rand.below(sizeof(chars) - 1)];
+  return str;
+}
+
+// Distribute `total` functions to `units` so that their sizes follow a
+// Zipf distribution. Which unit gets the largest share is random.
+static void set_unit_sizes(std::span<Unit> units, i64 avg, double skew,
+                           Random &rand) {
+  if (units.empty())
+    return;
+
+  std::vector<i64> ranks(units.size());
+  for (i64 i = 0; i < ranks.size(); i++)
+    ranks[i] = i;
+  shuffle(ranks, rand);
+
+  Zipf zipf(units.size(), skew);
+  double total = avg * units.size();
+  for (i64 i = 0; i < units.size(); i++)
+    units[i].nfuncs = std::max<i64>(1, std::llround(total * zipf.weight(ranks[i])));
+}
+
+static std::string func_name(i64 unit, i64 idx) {
+  return "f" + std::to_string(unit) + "_" + std::to_string(idx);
+}
+
+static std::string generate_unit(const Config &config, const Unit &unit,
+                                 i64 idx, const Pool &pool, const Zipf &strings,
+                                 const Zipf &comdats) {
+  Random rand(config.seed * 7919 + idx);
+
+  std::set<std::string> decls;
+  std::set<i64> inline_funcs;
+  std::vector<std::vector<std::string>> callees(unit.nfuncs);
+  std::vector<std::vector<i64>> literals(unit.nfuncs);
+  std::vector<std::vector<i64>> inline_callees(unit.nfuncs);
+
+  for (i64 i = 0; i < unit.nfuncs; i++) {
+    decls.insert(func_name(idx, i));
+    for (i64 j = 1 + rand.below(3); j > 0; j--) {
+      callees[i].push_back(pool.pick(rand));
+      decls.insert(callees[i].back());
+    }
+  }
+
+  std::vector<std::string> table_entries((unit.nfuncs + 3) / 4);
+  for (std::string &name : table_entries) {
+    name = pool.pick(rand);
+    decls.insert(name);
+  }
+
+  for (i64 i = 0; i < config.strings; i++)
+    literals[i % unit.nfuncs].push_back(strings(rand));
+
+  for (i64 i = 0; i < config.comdats; i++) {
+    i64 id = comdats(rand);
+    inline_funcs.insert(id);
+    inline_callees[i % unit.nfuncs].push_back(id);
+  }
+
+  std::ostringstream out;
+  out << "// Generated by mold-bench. Do not edit.\n"
+      << "extern \"C\" void bench_sink(const char *);\n";
+
+  for (const std::string &name : decls)
+    out << "extern \"C\" void " << name << "();\n";
+
+  // Inline functions are emitted to COMDAT groups. Their contents depend
+  // only on their IDs so that duplicate definitions are identical.
+  for (i64 id : inline_funcs)
+    out << "inline __attribute__((noinline)) void c" << id << "() { "
+        << "bench_sink(\"" << get_string_literal(config.seed, id) << "\"); }\n";
+
+  for (i64 i = 0; i < unit.nfuncs; i++) {
+    out << "extern \"C\" void " << func_name(idx, i) << "() {\n";
+    for (i64 id : literals[i])
+      out << "  bench_sink(\"" << get_string_literal(config.seed, id) << "\");\n";
+    for (i64 id : inline_callees[i])
+      out << "  c" << id << "();\n";
+    for (const std::string &name : callees[i])
+      out << "  " << name << "();\n";
+    out << "}\n";
+  }
+
+  // Function pointer tables, which need dynamic relocations if PIC.
+  // Every other table is read-only after relocation and goes to
+  // .data.rel.ro.
+  for (i64 i = 0; i < table_entries.size(); i++) {
+    out << "extern \"C\" { void (*" << (i % 2 ? "const " : "")
+        << "d" << idx << "_" << i << "[])() = {";
+    for (i64 j = 0; j < 4 && i * 4 + j < unit.nfuncs; j++)
+      out << " " << func_name(idx, i * 4 + j) << ",";
+    out << " " << table_entries[i] << " }; }\n";
+  }
+
+  return out.str();
+}
+
+// The entry point. It references a few popular functions so that some
+// archive members are pulled out.
+static std::string generate_main(const Config &config, const Pool &pool) {
+  Random rand(config.seed);
+  std::set<std::string> roots;
+  for (i64 i = 0; i < 16; i++)
+    roots.insert(pool.pick(rand));
+
+  std::ostringstream out;
+  out << "// Generated by mold-bench. Do not edit.\n"
+      << "const char *volatile bench_last;\n"
+      << "extern \"C\" __attribute__((noinline)) void bench_sink(const char *p) {\n"
+      << "  bench_last = p;\n"
+      << "}\n";
+
+  for (const std::string &name : roots)
+    out << "extern \"C\" void " << name << "();\n";
+
+  out << "extern \"C\" void bench_start() {\n";
+  for (const std::string &name : roots)
+    out << "  " << name << "();\n";
+  out << "  for (;;);\n"
+      << "}\n";
+  return out.str();
+}
+
+static std::string get_cflags(const Config &config) {
+  std::string cflags = " -c -O1 -fPIC -xc++ -ffreestanding -fno-exceptions"
+                       " -fno-rtti -fasynchronous-unwind-tables"
+                       " -ffunction-sections -fdata-sections";
+
+  // The debug info would contain the current directory without
+  // -fdebug-prefix-map, making the output depend on --dir.
+  if (config.debug_info)
+    cflags += " -g -fdebug-prefix-map=" +
+              quote(std::filesystem::current_path().string()) + "=.";
+  return cflags;
+}
+
+// Returns a string that identifies the generated files. If it matches
+// the one in the output directory, we can skip generating files.
+static std::string get_stamp(const Config &config) {
+  std::ostringstream out;
+  out << "objects=" << config.objects << "\n"
+      << "symbols=" << config.symbols << "\n"
+      << "strings=" << config.strings << "\n"
+      << "string_pool=" << config.string_pool << "\n"
+      << "comdats=" << config.comdats << "\n"
+      << "comdat_pool=" << config.comdat_pool << "\n"
+      << "archives=" << config.archives << "\n"
+      << "archive_members=" << config.archive_members << "\n"
+      << "dsos=" << config.dsos << "\n"
+      << "dso_objects=" << config.dso_objects << "\n"
+      << "skew=" << config.skew << "\n"
+      << "size_skew=" << config.size_skew << "\n"
+      << "seed=" << config.seed << "\n"
+      << "debug_info=" << config.debug_info << "\n"
+      << "cc=" << config.cc << get_cflags(config) << "\n"
+      << "ar=" << config.ar << "\n"
+      << "mold=" << config.mold << "\n";
+  return out.str();
+}
+
+static std::string read_file(const std::filesystem::path &path) {
+  std::ifstream in(path, std::ios::binary);
+  std::ostringstream ss;
+  ss << in.rdbuf();
+  return ss.str();
+}
+
+static void write_file(const std::filesystem::path &path, const std::string &str) {
+  std::ofstream out(path, std::ios::binary);
+  out << str;
+  out.close();
+  if (!out)
+    fatal("cannot write " + path.string());
+}
+
+// Creates all input files in the current directory and returns the
+// arguments to link them.
+static std::vector<std::string> generate(const Config &config) {
+  Random rand(config.seed);
+
+  std::vector<Unit> units;
+  for (i64 i = 0; i < config.objects; i++)
+    units.push_back({MAIN});
+  for (i64 i = 0; i < config.archives; i++)
+    for (i64 j = 0; j < config.archive_members; j++)
+      units.push_back({ARCHIVE, i});
+  for (i64 i = 0; i < config.dsos; i++)
+    for (i64 j = 0; j < config.dso_objects; j++)
+      units.push_back({DSO, i});
+
+  for (i64 i = 0; i < units.size(); i++)
+    units[i].name = "u" + std::to_string(i);
+
+  // Object files in each group get different sizes.
+  auto begin = units.begin();
+  for (i64 n : {config.objects, config.archives * config.archive_members}) {
+    set_unit_sizes({begin, begin + n}, config.symbols, config.size_skew, rand);
+    begin += n;
+  }
+  for (i64 i = 0; i < config.dsos; i++) {
+    set_unit_sizes({begin, begin + config.dso_objects}, config.symbols,
+                   config.size_skew, rand);
+    begin += config.dso_objects;
+  }
+
+  // Object files and archive members may reference any function except
+  // the ones in shared libraries. Functions in a shared library reference
+  // only the ones in the same library so that no shared library has
+  // undefined symbols other than `bench_sink`.
+  std::vector<std::string> exe_syms;
+  std::vector<std::string> all_syms;
+  std::vector<std::vector<std::string>> dso_syms(config.dsos);
+
+  for (i64 i = 0; i < units.size(); i++) {
+    for (i64 j = 0; j < units[i].nfuncs; j++) {
+      std::string name = func_name(i, j);
+      all_syms.push_back(name);
+      if (units[i].kind == DSO)
+        dso_syms[units[i].lib].push_back(name);
+      else
+        exe_syms.push_back(name);
+    }
+  }
+
+  Pool main_pool(all_syms, config.skew, rand);
+  Pool exe_pool(exe_syms, config.skew, rand);
+  std::vector<Pool> dso_pools;
+  for (i64 i = 0; i < config.dsos; i++)
+    dso_pools.emplace_back(dso_syms[i], config.skew, rand);
+
+  std::string stamp = get_stamp(config);
+  std::vector<std::string> link_args = {"bench.o"};
+  for (i64 i = 0; i < config.objects; i++)
+    link_args.push_back(units[i].name + ".o");
+  for (i64 i = 0; i < config.archives; i++)
+    link_args.push_back("libbench" + std::to_string(i) + ".a");
+  for (i64 i = 0; i < config.dsos; i++)
+    link_args.push_back("libbenchdso" + std::to_string(i) + ".so");
+
+  if (read_file("stamp") == stamp)
+    return link_args;
+  std::filesystem::remove("stamp");
+
+  std::cerr << "mold-bench: generating " << units.size() + 1 << " files\n";
+
+  Zipf strings(config.string_pool, config.skew);
+  Zipf comdats(config.comdat_pool, config.skew);
+
+  write_file("bench.cc", generate_main(config, main_pool));
+  for (i64 i = 0; i < units.size(); i++) {
+    const Pool &pool = (units[i].kind == DSO) ? dso_pools[units[i].lib]
+                     : (units[i].kind == ARCHIVE) ? exe_pool : main_pool;
+    write_file(units[i].name + ".cc",
+               generate_unit(config, units[i], i, pool, strings, comdats));
+  }
+
+  // Compile generated files in parallel
+  std::string cflags = get_cflags(config);
+  std::vector<std::string> srcs = {"bench"};
+  for (Unit &unit : units)
+    srcs.push_back(unit.name);
+
+  std::atomic_int64_t next = 0;
+  std::atomic_bool failed = false;
+  std::vector<std::thread> threads;
+
+  for (i64 i = 0; i < config.jobs; i++) {
+    threads.emplace_back([&] {
+      for (i64 j = next++; j < srcs.size() && !failed; j = next++)
+        if (run(config.cc + cflags + " -o " + srcs[j] + ".o " + srcs[j] + ".cc"))
+          failed = true;
+    });
+  }
+
+  for (std::thread &thread : threads)
+    thread.join();
+  if (failed)
+    fatal("compile failed");
+
+  // Create archive files and shared libraries
+  auto get_members = [&](UnitKind kind, i64 lib) {
+    std::string str;
+    for (Unit &unit : units)
+      if (unit.kind == kind && unit.lib == lib)
+        str += " " + unit.name + ".o";
+    return str;
+  };
+
+  for (i64 i = 0; i < config.archives; i++) {
+    std::string path = "libbench" + std::to_string(i) + ".a";
+    std::filesystem::remove(path);
+    if (run(config.ar + " crsD " + path + get_members(ARCHIVE, i)))
+      fatal("cannot create " + path);
+  }
+
+  for (i64 i = 0; i < config.dsos; i++) {
+    std::string path = "libbenchdso" + std::to_string(i) + ".so";
+    if (run(quote(config.mold) + " -shared -o " + path + get_members(DSO, i)))
+      fatal("cannot create " + path);
+  }
+
+  write_file("stamp", stamp);
+  return link_args;
+}
+
+// Extracts the value of `key` from a line of a trace file
+// written by mold's `--perf-trace`.
+static std::string get_field(const std::string &line, const std::string &key) {
+  std::string pat = "\"" + key + "\":";
+  size_t pos = line.find(pat);
+  if (pos == line.npos)
+    return "";
+  pos += pat.size();
+
+  if (line[pos] == '"')
+    return line.substr(pos, line.find('"', pos + 1) - pos + 1);
+  if (line[pos] == '{')
+    return line.substr(pos + 1, line.find('}', pos) - pos - 1);
+  return line.substr(pos, line.find_first_of(",}", pos) - pos);
+}
+
+struct Phase {
+  std::string name;
+  double real_ms = 0;
+  std::string usage;
+};
+
+struct Result {
+  double wall_ms = 0;
+  std::vector<Phase> phases;
+};
+
+static Result run_link(const Config &config, const std::vector<std::string> &args) {
+  std::filesystem::remove("trace.json");
+
+  std::string cmd = quote(config.mold) +
+                    " -o bench.out -e bench_start --perf-trace=trace.json @link.rsp";
+  for (const std::string &arg : config.link_args)
+    cmd += " " + quote(arg);
+
+  std::ostringstream rsp;
+  for (const std::string &arg : args)
+    rsp << arg << "\n";
+  write_file("link.rsp", rsp.str());
+
+  auto start = std::chrono::steady_clock::now();
+  if (run(cmd))
+    fatal("link failed: " + cmd);
+  auto end = std::chrono::steady_clock::now();
+
+  Result res;
+  res.wall_ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+  std::ifstream in("trace.json");
+  if (!in)
+    fatal("cannot read trace.json");
+
+  for (std::string line; std::getline(in, line);) {
+    if (get_field(line, "cat") != "\"phase\"")
+      continue;
+    Phase phase;
+    phase.name = get_field(line, "name");
+    phase.real_ms = std::stod(get_field(line, "dur")) / 1000;
+    phase.usage = get_field(line, "args");
+    res.phases.push_back(phase);
+  }
+  return res;
+}
+
+static double median(std::vector<double> vec) {
+  std::sort(vec.begin(), vec.end());
+  i64 n = vec.size();
+  return (n % 2) ? vec[n / 2] : (vec[n / 2 - 1] + vec[n / 2]) / 2;
+}
+
+static void print_report(std::ostream &out, const Config &config,
+                         const std::vector<Result> &results) {
+  out << "{\n  \"config\": {"
+      << "\"objects\":" << config.objects
+      << ",\"symbols\":" << config.symbols
+      << ",\"strings\":" << config.strings
+      << ",\"string_pool\":" << config.string_pool
+      << ",\"comdats\":" << config.comdats
+      << ",\"comdat_pool\":" << config.comdat_pool
+      << ",\"archives\":" << config.archives
+      << ",\"archive_members\":" << config.archive_members
+      << ",\"dsos\":" << config.dsos
+      << ",\"dso_objects\":" << config.dso_objects
+      << ",\"skew\":" << config.skew
+      << ",\"size_skew\":" << config.size_skew
+      << ",\"seed\":" << config.seed
+      << ",\"debug_info\":" << (config.debug_info ? "true" : "false")
+      << "},\n  \"runs\": [\n";
+
+  // Phase names in the order of first appearance
+  std::vector<std::string> names;
+  std::map<std::string, std::vector<double>> times;
+
+  for (i64 i = 0; i < results.size(); i++) {
+    const Result &res = results[i];
+    out << "    {\"wall_ms\":" << res.wall_ms << ",\"phases\":[\n";
+
+    for (i64 j = 0; j < res.phases.size(); j++) {
+      const Phase &phase = res.phases[j];
+      out << "      {\"name\":" << phase.name << ",\"real_ms\":" << phase.real_ms;
+      if (!phase.usage.empty())
+        out << "," << phase.usage;
+      out << (j + 1 == res.phases.size() ? "}\n" : "},\n");
+
+      if (!times.contains(phase.name))
+        names.push_back(phase.name);
+      times[phase.name].push_back(phase.real_ms);
+    }
+    out << (i + 1 == results.size() ? "    ]}\n" : "    ]},\n");
+  }
+
+  std::vector<double> wall;
+  for (const Result &res : results)
+    wall.push_back(res.wall_ms);
+
+  out << "  ],\n  \"median\": {\"wall_ms\":" << median(wall) << ",\"phases\":{";
+  for (i64 i = 0; i < names.size(); i++)
+    out << (i ? "," : "") << "\n    " << names[i] << ":" << median(times[names[i]]);
+  out << "\n  }}\n}\n";
+}
+
+static int bench_main(int argc, char **argv) {
+  Config config = parse_args(argc, argv);
+
+  std::filesystem::path output;
+  if (!config.output.empty())
+    output = std::filesystem::absolute(config.output);
+
+  std::error_code ec;
+  std::filesystem::create_directories(config.dir, ec);
+  std::filesystem::current_path(config.dir, ec);
+  if (ec)
+    fatal("cannot use directory " + config.dir + ": " + ec.message());
+
+  std::vector<std::string> args = generate(config);
+
+  for (i64 i = 0; i < config.warmup; i++)
+    run_link(config, args);
+
+  std::vector<Result> results;
+  for (i64 i = 0; i < config.runs; i++) {
+    results.push_back(run_link(config, args));
+    std::cerr << "mold-bench: run " << (i + 1) << ": "
+              << results.back().wall_ms << " ms\n";
+  }
+
+  if (output.empty()) {
+    print_report(std::cout, config, results);
+  } else {
+    std::ofstream out(output);
+    print_report(out, config, results);
+    out.close();
+    if (!out)
+      fatal("cannot write " + output.string());
+  }
+  return 0;
+}
+
+} // namespace mold
+
+int main(int argc, char **argv) {
+  return mold::bench_main(argc, argv);
+}
@@ -0,0 +1,171 @@
+// split-strings-bench measures the throughput of the functions that
+// split mergeable string sections into fragments (lib/split-strings.cc).
+//
+// It generates a buffer resembling .debug_str, i.e. a concatenation of
+// null-terminated strings whose lengths follow a geometric distribution,
+// and runs every implementation that the current CPU supports over it
+// for entsize 1, 2 and 4. Each result is compared with that of the
+// scalar implementation, so this program doubles as a correctness test.
+//
+// It also compares hashing fragments one at a time as they are found
+// with hashing them in a batch by hash_strings().
+
+#include "../lib/common.h"
+
+#include <chrono>
+#include <random>
+
+namespace mold {
+
+static const char helpmsg[] = R"(Usage: split-strings-bench [options]
+
+Options:
+  --help                      Report usage information
+  --size N                    Buffer size in MiB [64]
+  --average-length N          Average string length in bytes [24]
+  --runs N                    Number of runs for each implementation [5]
+  --seed N                    Random seed [1]
+)";
+
+[[noreturn]] static void fatal(const std::string &msg) {
+  std::cerr << "split-strings-bench: " << msg << "\n";
+  exit(1);
+}
+
+static std::string generate(i64 size, i64 avg_len, i64 entsize, u64 seed) {
+  std::mt19937_64 rng(seed);
+  std::geometric_distribution<i64> len_dist(1.0 / avg_len);
+  std::string buf;
+  buf.reserve(size + avg_len * 16);
+
+  while (buf.size() < size) {
+    i64 len = len_dist(rng) / entsize;
+    for (i64 i = 0; i < len; i++) {
+      // Non-null elements may contain null bytes if entsize > 1.
+      for (i64 j = 0; j < entsize; j++)
+        buf += (char)((j == 0) ? 'a' + rng() % 26 : rng() % 2);
+    }
+    buf.append(entsize, '\0');
+  }
+  return buf;
+}
+
+// Returns the best of `runs` runs in seconds.
+template <typename Fn>
+static double measure(i64 runs, Fn fn) {
+  double best = INFINITY;
+  for (i64 i = 0; i < runs; i++) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    std::chrono::duration<double> t = std::chrono::steady_clock::now() - start;
+    best = std::min(best, t.count());
+  }
+  return best;
+}
+
+static int bench_main(int argc, char **argv) {
+  i64 size = 64;
+  i64 avg_len = 24;
+  i64 runs = 5;
+  u64 seed = 1;
+
+  for (i64 i = 1; i < argc; i++) {
+    std::string_view opt = argv[i];
+    if (opt == "--help") {
+      std::cout << helpmsg;
+      return 0;
+    }
+
+    std::string_view name = opt;
+    std::string val;
+    if (size_t pos = opt.find('='); pos != opt.npos) {
+      name = opt.substr(0, pos);
+      val = opt.substr(pos + 1);
+    } else if (i + 1 < argc) {
+      val = argv[++i];
+    } else {
+      fatal("option " + std::string(opt) + ": argument missing");
+    }
+
+    char *end;
+    i64 v = strtoll(val.c_str(), &end, 0);
+    if (val.empty() || *end || v <= 0)
+      fatal("option " + std::string(name) + ": not a positive integer: " + val);
+
+    if (name == "--size")
+      size = v;
+    else if (name == "--average-length")
+      avg_len = v;
+    else if (name == "--runs")
+      runs = v;
+    else if (name == "--seed")
+      seed = v;
+    else
+      fatal("unknown command line option: " + std::string(name));
+  }
+
+  std::vector<SplitStringsImpl> impls = get_split_strings_impls();
+  double mib = size;
+
+  printf("%-10s %7s %12s %10s\n", "impl", "entsize", "MiB/s", "speedup");
+
+  for (i64 entsize : {1, 2, 4}) {
+    std::string buf = generate(size << 20, avg_len, entsize, seed);
+    std::vector<u32> expected;
+    if (!split_strings_scalar(buf, entsize, expected))
+      fatal("generated buffer is not null-terminated");
+
+    double base = 0;
+
+    for (SplitStringsImpl &impl : impls) {
+      std::vector<u32> vec;
+      vec.reserve(expected.size());
+
+      double t = measure(runs, [&] {
+        vec.clear();
+        impl.fn(buf, entsize, vec);
+      });
+
+      if (vec != expected)
+        fatal(std::string(impl.name) + ": wrong result for entsize " +
+              std::to_string(entsize));
+
+      if (base == 0)
+        base = t;
+      printf("%-10s %7d %12.1f %9.2fx\n", std::string(impl.name).c_str(),
+             (int)entsize, mib / t, base / t);
+    }
+  }
+
+  // Hashing
+  std::string buf = generate(size << 20, avg_len, 1, seed);
+  std::vector<u32> offsets;
+  split_strings(buf, 1, offsets);
+  std::vector<u64> hashes1(offsets.size());
+  std::vector<u64> hashes2(offsets.size());
+
+  double t1 = measure(runs, [&] {
+    for (i64 i = 0; i < offsets.size(); i++) {
+      i64 end = (i + 1 == offsets.size()) ? buf.size() : offsets[i + 1];
+      hashes1[i] = hash_string(std::string_view(buf).substr(offsets[i], end - offsets[i]));
+    }
+  });
+
+  double t2 = measure(runs, [&] {
+    hash_strings(buf, offsets, 0, offsets.size(), hashes2.data());
+  });
+
+  if (hashes1 != hashes2)
+    fatal("hash_strings: wrong result");
+
+  printf("\n%-10s %20s %9s\n", "hash", "MiB/s", "speedup");
+  printf("%-10s %20.1f %9.2fx\n", "single", mib / t1, 1.0);
+  printf("%-10s %20.1f %9.2fx\n", "batched", mib / t2, t1 / t2);
+  return 0;
+}
+
+} // namespace mold
+
+int main(int argc, char **argv) {
+  return mold::bench_main(argc, argv);
+}
@@ -87,9 +87,13 @@ struct ArHdr {
   }
 };
 
+// If `hdr_offsets` is not null, the offset of each member's header
+// from the beginning of the archive file is stored to it. The archive
+// symbol table refers to archive members by that offset.
 template <typename Context>
 std::vector<MappedFile *>
-read_thin_archive_members(Context &ctx, MappedFile *mf) {
+read_thin_archive_members(Context &ctx, MappedFile *mf,
+                          std::vector<u64> *hdr_offsets = nullptr) {
   u8 *begin = mf->data;
   u8 *data = begin + 8; // !<thin>\n
   std::vector<MappedFile *> vec;
@@ -130,13 +134,17 @@ read_thin_archive_members(Context &ctx, MappedFile *mf) {
       name : (path_dirname(mf->name) / name).string();
     vec.push_back(must_open_file(ctx, path));
     vec.back()->thin_parent = mf;
+    if (hdr_offsets)
+      hdr_offsets->push_back(data - begin);
     data = body;
   }
   return vec;
 }
 
 template <typename Context>
-std::vector<MappedFile *> read_fat_archive_members(Context &ctx, MappedFile *mf) {
+std::vector<MappedFile *>
+read_fat_archive_members(Context &ctx, MappedFile *mf,
+                         std::vector<u64> *hdr_offsets = nullptr) {
   u8 *begin = mf->data;
   u8 *data = begin + 8; // !<arch>\n
   std::vector<MappedFile *> vec;
@@ -149,6 +157,7 @@ std::vector<MappedFile *> read_fat_archive_members(Context &ctx, MappedFile *mf)
       data++;
 
     ArHdr &hdr = *(ArHdr *)data;
+    u8 *hdr_begin = data;
     u8 *body = data + sizeof(hdr);
     u64 size = atol(hdr.ar_size);
     data = body + size;
@@ -171,18 +180,88 @@ std::vector<MappedFile *> read_fat_archive_members(Context &ctx, MappedFile *mf)
       continue;
 
     vec.push_back(mf->slice(ctx, name, body - begin, data - body));
+    if (hdr_offsets)
+      hdr_offsets->push_back(hdr_begin - begin);
   }
   return vec;
 }
 
 // read the contents of an archive file
 template <typename Context>
-std::vector<MappedFile *> read_archive_members(Context &ctx, MappedFile *mf) {
+std::vector<MappedFile *>
+read_archive_members(Context &ctx, MappedFile *mf,
+                     std::vector<u64> *hdr_offsets = nullptr) {
   std::string_view str = mf->get_contents();
   if (str.starts_with("!<arch>\n"))
-    return read_fat_archive_members(ctx, mf);
+    return read_fat_archive_members(ctx, mf, hdr_offsets);
   assert(str.starts_with("!<thin>\n"));
-  return read_thin_archive_members(ctx, mf);
+  return read_thin_archive_members(ctx, mf, hdr_offsets);
+}
+
+// An entry of the archive symbol table. `offset` is the offset of the
+// header of the member defining `name`.
+struct ArSymbol {
+  std::string_view name;
+  u64 offset;
+};
+
+// Read the archive symbol table (also known as the armap), which is
+// created by `ar s` or `ranlib` and is always the first member of an
+// archive. The 32-bit format consists of a big-endian 32-bit symbol
+// count, an array of 32-bit member offsets and then NUL-terminated
+// symbol names. The 64-bit format is the same except that the count
+// and offsets are 64 bits.
+//
+// Returns an empty vector if the archive doesn't have a symbol table
+// or the table is in a format we don't understand, e.g. BSD's
+// `__.SYMDEF`.
+inline std::vector<ArSymbol> read_archive_symtab(MappedFile *mf) {
+  u8 *begin = mf->data;
+  u8 *end = begin + mf->size;
+
+  if (mf->size < 8 + sizeof(ArHdr))
+    return {};
+
+  ArHdr &hdr = *(ArHdr *)(begin + 8);
+  if (!hdr.is_symtab())
+    return {};
+
+  u8 *body = begin + 8 + sizeof(hdr);
+  u64 size = atol(hdr.ar_size);
+  if (end - body < size)
+    return {};
+
+  bool is64 = hdr.starts_with("/SYM64/ ");
+  u64 word_size = is64 ? 8 : 4;
+
+  auto read_word = [&](u8 *p) -> u64 {
+    return is64 ? *(ub64 *)p : *(ub32 *)p;
+  };
+
+  if (size < word_size)
+    return {};
+
+  u64 num = read_word(body);
+  if ((size / word_size) - 1 < num)
+    return {};
+
+  char *str = (char *)body + (num + 1) * word_size;
+  char *str_end = (char *)body + size;
+
+  std::vector<ArSymbol> vec;
+  vec.reserve(num);
+
+  for (i64 i = 0; i < num; i++) {
+    if (str == str_end)
+      return {};
+
+    size_t len = strnlen(str, str_end - str);
+    vec.push_back({{str, len}, read_word(body + (i + 1) * word_size)});
+    str += len;
+    if (str != str_end)
+      str++;
+  }
+  return vec;
 }
 
 } // namespace mold
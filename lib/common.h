@@ -318,7 +318,8 @@ private:
 // Timer and TimeRecord records elapsed time (wall clock time)
 // used by each pass of the linker.
 struct TimerRecord {
-  TimerRecord(std::string name, TimerRecord *parent = nullptr);
+  TimerRecord(std::string name, TimerRecord *parent = nullptr,
+              bool is_task = false);
   void stop();
 
   std::string name;
@@ -326,14 +327,23 @@ struct TimerRecord {
   tbb::concurrent_vector<TimerRecord *> children;
   i64 start;
   i64 end;
-  i64 user;
-  i64 sys;
+  i64 tid;
+  i64 user = 0;
+  i64 sys = 0;
+  i64 rss = 0;
+  i64 peak_rss = 0;
+  i64 minflt = 0;
+  i64 majflt = 0;
+  bool is_task;
   bool stopped = false;
 };
 
 void
 print_timer_records(tbb::concurrent_vector<std::unique_ptr<TimerRecord>> &);
 
+void write_chrome_trace(tbb::concurrent_vector<std::unique_ptr<TimerRecord>> &,
+                        std::ostream &out);
+
 template <typename Context>
 class Timer {
 public:
@@ -356,6 +366,30 @@ private:
   TimerRecord *record;
 };
 
+// TaskTimer records the time spent by a single task of a parallel
+// loop, e.g. parsing one input file. There are too many of them to
+// print with --perf, so they are recorded only for --perf-trace.
+template <typename Context>
+class TaskTimer {
+public:
+  TaskTimer(Context &ctx, std::string_view name) {
+    if (ctx.arg.perf_trace.empty())
+      return;
+    record = new TimerRecord(std::string(name), nullptr, true);
+    ctx.timer_records.push_back(std::unique_ptr<TimerRecord>(record));
+  }
+
+  TaskTimer(const TaskTimer &) = delete;
+
+  ~TaskTimer() {
+    if (record)
+      record->stop();
+  }
+
+private:
+  TimerRecord *record = nullptr;
+};
+
 //
 // Bit vector
 //
@@ -517,6 +551,21 @@ inline u64 read_uleb(u8 **buf) {
   return val;
 }
 
+inline i64 read_sleb(u8 **buf) {
+  u64 val = 0;
+  u8 shift = 0;
+  u8 byte;
+  do {
+    byte = *(*buf)++;
+    val |= (u64)(byte & 0x7f) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+
+  if (shift < 64 && (byte & 0x40))
+    val |= -1ULL << shift;
+  return val;
+}
+
 inline u64 read_uleb(u8 *buf) {
   u8 *tmp = buf;
   return read_uleb(&tmp);
@@ -617,6 +666,16 @@ public:
   }
 
   std::pair<T *, bool> insert(std::string_view key, u32 hash, const T &val) {
+    std::pair<T *, bool> res = try_insert(key, hash, val);
+    assert(res.first && "ConcurrentMap is full");
+    return res;
+  }
+
+  // Same as insert() except that this function returns {nullptr, false}
+  // if there's no room for a given key. Since entries are never removed,
+  // a key that doesn't fit once never fits, so callers can safely store
+  // such keys somewhere else.
+  std::pair<T *, bool> try_insert(std::string_view key, u32 hash, const T &val) {
     assert(has_single_bit(nbuckets));
 
     i64 begin = hash & (nbuckets - 1);
@@ -660,8 +719,6 @@ public:
       if (key == std::string_view(ptr, ent.keylen))
         return {&ent.value, false};
     }
-
-    assert(false && "ConcurrentMap is full");
     return {nullptr, false};
   }
 
@@ -741,7 +798,17 @@ void get_random_bytes(u8 *buf, i64 size);
 class HyperLogLog {
 public:
   void insert(u64 hash) {
-    update_maximum(buckets[hash & (NBUCKETS - 1)], std::countl_zero(hash) + 1);
+    insert(hash & (NBUCKETS - 1), get_rank(hash));
+  }
+
+  // `bucket` is the lowest bits of a hash value and `rank` is the return
+  // value of get_rank() for the same hash.
+  void insert(i64 bucket, u8 rank) {
+    update_maximum(buckets[bucket & (NBUCKETS - 1)], rank);
+  }
+
+  static u8 get_rank(u64 hash) {
+    return std::countl_zero(hash) + 1;
   }
 
   i64 get_cardinality() const;
@@ -854,34 +921,79 @@ void release_global_lock();
 u32 compute_crc32(u32 crc, u8 *buf, i64 len);
 std::vector<u8> crc32_solve(u32 current, u32 desired);
 
+//
+// split-strings.cc
+//
+
+typedef bool SplitStringsFn(std::string_view, i64, std::vector<u32> &);
+
+struct SplitStringsImpl {
+  std::string_view name;
+  SplitStringsFn *fn;
+};
+
+bool split_strings(std::string_view data, i64 entsize, std::vector<u32> &vec);
+bool split_strings_scalar(std::string_view data, i64 entsize,
+                          std::vector<u32> &vec);
+std::vector<SplitStringsImpl> get_split_strings_impls();
+void hash_strings(std::string_view data, std::span<const u32> offsets,
+                  i64 begin, i64 end, u64 *out);
+
 //
 // compress.cc
 //
 
+// A compressor splits input into shards and compresses them
+// individually. Shards can be added in any order from multiple
+// threads, so a caller can compress each piece of data as soon as
+// it becomes available instead of materializing the entire input.
 class Compressor {
 public:
-  virtual void write_to(u8 *buf) = 0;
+  static constexpr i64 SHARD_SIZE = 1024 * 1024;
+
+  Compressor(i64 num_shards, i64 level)
+    : shards(num_shards), level(level) {}
+
   virtual ~Compressor() {}
+
+  // Compresses the i'th shard. This function is thread-safe as long
+  // as each thread passes a different `i`.
+  virtual void add_shard(i64 i, std::string_view data) = 0;
+
+  // Computes `compressed_size`. Must be called after all shards are added.
+  virtual void finish() = 0;
+
+  virtual void write_to(u8 *buf) = 0;
+
   i64 compressed_size = 0;
+
+protected:
+  std::vector<std::vector<u8>> shards;
+  i64 level;
 };
 
 class ZlibCompressor : public Compressor {
 public:
-  ZlibCompressor(u8 *buf, i64 size);
+  ZlibCompressor(i64 num_shards, i64 level);
+  void add_shard(i64 i, std::string_view data) override;
+  void finish() override;
   void write_to(u8 *buf) override;
 
 private:
-  std::vector<std::vector<u8>> shards;
-  u64 checksum = 0;
+  std::vector<u64> adlers;
+  std::vector<i64> sizes;
+  u64 checksum = 1;
 };
 
 class ZstdCompressor : public Compressor {
 public:
-  ZstdCompressor(u8 *buf, i64 size);
-  void write_to(u8 *buf) override;
+  ZstdCompressor(i64 num_shards, i64 level) : Compressor(num_shards, level) {}
+  void add_shard(i64 i, std::string_view data) override;
 
-private:
-  std::vector<std::vector<u8>> shards;
+  // Sets already-compressed zstd frames to the i'th shard.
+  void add_compressed_shard(i64 i, std::string_view data);
+  void finish() override;
+  void write_to(u8 *buf) override;
 };
 
 //
@@ -961,6 +1073,7 @@ public:
   std::string name; // path
   u8 *data = nullptr;
   i64 size = 0;
+  i64 mtime = 0; // in nanoseconds, or 0 if unknown
   bool given_fullpath = true;
   MappedFile *parent = nullptr; // for fat archive
   MappedFile *thin_parent = nullptr; // for thin archive
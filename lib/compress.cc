@@ -13,6 +13,10 @@
 // is reset on boundaries of shards, compression ratio is sacrificed
 // a little bit. However, if a shard size is large enough, that loss
 // is negligible in practice.
+//
+// Shards don't have to be compressed all at once. A caller can pass
+// each shard to a compressor as soon as its contents are ready, so
+// that it doesn't have to keep the entire uncompressed data in memory.
 
 #include "common.h"
 
@@ -28,30 +32,15 @@
 
 namespace mold {
 
-static constexpr i64 SHARD_SIZE = 1024 * 1024;
-
-static std::vector<std::string_view> split(std::string_view input) {
-  std::vector<std::string_view> shards;
-
-  while (input.size() >= SHARD_SIZE) {
-    shards.push_back(input.substr(0, SHARD_SIZE));
-    input = input.substr(SHARD_SIZE);
-  }
-  if (!input.empty())
-    shards.push_back(input);
-  return shards;
-}
-
-static std::vector<u8> zlib_compress(std::string_view input) {
+static std::vector<u8> zlib_compress(std::string_view input, i64 level) {
   // Initialize zlib stream. Since debug info is generally compressed
-  // pretty well with lower compression levels, we chose compression
-  // level 1.
+  // pretty well with lower compression levels, the default level is 1.
   z_stream strm;
   strm.zalloc = Z_NULL;
   strm.zfree = Z_NULL;
   strm.opaque = Z_NULL;
 
-  CHECK(deflateInit2(&strm, 1, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY));
+  CHECK(deflateInit2(&strm, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY));
 
   // Set an input buffer
   strm.avail_in = input.size();
@@ -97,22 +86,20 @@ static std::vector<u8> zlib_compress(std::string_view input) {
   return buf;
 }
 
-ZlibCompressor::ZlibCompressor(u8 *buf, i64 size) {
-  std::string_view input{(char *)buf, (size_t)size};
-  std::vector<std::string_view> inputs = split(input);
-  std::vector<u64> adlers(inputs.size());
-  shards.resize(inputs.size());
+ZlibCompressor::ZlibCompressor(i64 num_shards, i64 level)
+  : Compressor(num_shards, level), adlers(num_shards), sizes(num_shards) {}
 
-  // Compress each shard
-  tbb::parallel_for((i64)0, (i64)inputs.size(), [&](i64 i) {
-    adlers[i] = adler32(1, (u8 *)inputs[i].data(), inputs[i].size());
-    shards[i] = zlib_compress(inputs[i]);
-  });
+void ZlibCompressor::add_shard(i64 i, std::string_view data) {
+  adlers[i] = adler32(1, (u8 *)data.data(), data.size());
+  sizes[i] = data.size();
+  shards[i] = zlib_compress(data, level);
+}
 
+void ZlibCompressor::finish() {
   // Combine checksums
-  checksum = adlers[0];
-  for (i64 i = 1; i < inputs.size(); i++)
-    checksum = adler32_combine(checksum, adlers[i], inputs[i].size());
+  checksum = 1;
+  for (i64 i = 0; i < shards.size(); i++)
+    checksum = adler32_combine(checksum, adlers[i], sizes[i]);
 
   // Comput the total size
   compressed_size = 8; // the header and the trailer
@@ -144,28 +131,27 @@ void ZlibCompressor::write_to(u8 *buf) {
   *(ub32 *)(end - 4) = checksum;
 }
 
-static std::vector<u8> zstd_compress(std::string_view input) {
+static std::vector<u8> zstd_compress(std::string_view input, i64 level) {
   std::vector<u8> buf(ZSTD_COMPRESSBOUND(input.size()));
-  constexpr int LEVEL = 3; // compression level; must be between 1 to 22
-
   size_t sz = ZSTD_compress(buf.data(), buf.size(), input.data(), input.size(),
-                            LEVEL);
+                            level);
   assert(!ZSTD_isError(sz));
   buf.resize(sz);
   buf.shrink_to_fit();
   return buf;
 }
 
-ZstdCompressor::ZstdCompressor(u8 *buf, i64 size) {
-  std::string_view input{(char *)buf, (size_t)size};
-  std::vector<std::string_view> inputs = split(input);
-  shards.resize(inputs.size());
+void ZstdCompressor::add_shard(i64 i, std::string_view data) {
+  shards[i] = zstd_compress(data, level);
+}
 
-  // Compress each shard
-  tbb::parallel_for((i64)0, (i64)inputs.size(), [&](i64 i) {
-    shards[i] = zstd_compress(inputs[i]);
-  });
+// Concatenated zstd frames are valid zstd data, so we can copy
+// compressed input data to the output as-is.
+void ZstdCompressor::add_compressed_shard(i64 i, std::string_view data) {
+  shards[i].assign(data.begin(), data.end());
+}
 
+void ZstdCompressor::finish() {
   compressed_size = 0;
   for (std::vector<u8> &shard : shards)
     compressed_size += shard.size();
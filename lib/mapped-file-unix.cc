@@ -33,6 +33,12 @@ MappedFile *open_file_impl(const std::string &path, std::string &error) {
   mf->name = path;
   mf->size = st.st_size;
 
+#ifdef __APPLE__
+  mf->mtime = st.st_mtimespec.tv_sec * 1000000000LL + st.st_mtimespec.tv_nsec;
+#else
+  mf->mtime = st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+
   if (st.st_size > 0) {
     // mmap
     //   https://man7.org/linux/man-pages/man2/mmap.2.html
@@ -28,12 +28,58 @@ void Counter::print() {
               << "=" << c->get_value() << "\n";
 }
 
+// Returns a small integer identifying the calling thread. Threads are
+// numbered in the order they first call this function.
+static i64 get_thread_id() {
+  static std::atomic<i64> counter;
+  thread_local i64 id = counter++;
+  return id;
+}
+
 static i64 now_nsec() {
   // https://en.cppreference.com/w/cpp/chrono/steady_clock
   return (i64)std::chrono::steady_clock::now().time_since_epoch().count();
 }
 
-static std::pair<i64, i64> get_usage() {
+struct Usage {
+  i64 user = 0;
+  i64 sys = 0;
+  i64 rss = 0;
+  i64 peak_rss = 0;
+  i64 minflt = 0;
+  i64 majflt = 0;
+};
+
+// Returns the current resident set size in bytes, or 0 if unknown.
+static i64 get_rss() {
+#ifdef __linux__
+  // /proc/[pid]/statm
+  //   https://man7.org/linux/man-pages/man5/proc_pid_statm.5.html
+  //
+  // The second field is the number of resident pages.
+  int fd = ::open("/proc/self/statm", O_RDONLY);
+  if (fd == -1)
+    return 0;
+
+  char buf[128];
+  i64 len = read(fd, buf, sizeof(buf) - 1);
+  close(fd);
+  if (len <= 0)
+    return 0;
+  buf[len] = '\0';
+
+  unsigned long long size, resident;
+  if (sscanf(buf, "%llu %llu", &size, &resident) != 2)
+    return 0;
+  return (i64)resident * sysconf(_SC_PAGESIZE);
+#else
+  return 0;
+#endif
+}
+
+static Usage get_usage() {
+  Usage u;
+
 #ifdef _WIN32
   auto to_nsec = [](FILETIME t) -> i64 {
     return (((u64)t.dwHighDateTime << 32) + (u64)t.dwLowDateTime) * 100;
@@ -41,7 +87,8 @@ static std::pair<i64, i64> get_usage() {
 
   FILETIME creation, exit, kernel, user;
   GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
-  return {to_nsec(user), to_nsec(kernel)};
+  u.user = to_nsec(user);
+  u.sys = to_nsec(kernel);
 #else
   // timeval
   //   https://man7.org/linux/man-pages/man3/timeval.3type.html
@@ -70,16 +117,52 @@ static std::pair<i64, i64> get_usage() {
   //   This is the total amount of time spent executing in kernel
   //   mode, expressed in a timeval structure (seconds plus
   //   microseconds).
+  //
+  // ru_maxrss
+  //   This is the maximum resident set size used (in kilobytes).
+  //
+  // ru_minflt
+  //   The number of page faults serviced without any I/O
+  //   activity.
+  //
+  // ru_majflt
+  //   The number of page faults serviced that required I/O
+  //   activity.
   struct rusage ru;
   getrusage(RUSAGE_SELF, &ru);
-  return {to_nsec(ru.ru_utime), to_nsec(ru.ru_stime)};
+  u.user = to_nsec(ru.ru_utime);
+  u.sys = to_nsec(ru.ru_stime);
+  u.minflt = ru.ru_minflt;
+  u.majflt = ru.ru_majflt;
+
+#ifdef __APPLE__
+  u.peak_rss = ru.ru_maxrss;
+#else
+  u.peak_rss = (i64)ru.ru_maxrss * 1024;
 #endif
+
+  u.rss = get_rss();
+#endif
+
+  return u;
 }
 
-TimerRecord::TimerRecord(std::string name, TimerRecord *parent)
-  : name(name), parent(parent) {
+TimerRecord::TimerRecord(std::string name, TimerRecord *parent, bool is_task)
+  : name(name), parent(parent), is_task(is_task) {
   start = now_nsec();
-  std::tie(user, sys) = get_usage();
+  tid = get_thread_id();
+
+  // Resource usage is process-wide and relatively expensive to obtain,
+  // so we don't record it for fine-grained task spans.
+  if (!is_task) {
+    Usage u = get_usage();
+    user = u.user;
+    sys = u.sys;
+    rss = u.rss;
+    minflt = u.minflt;
+    majflt = u.majflt;
+  }
+
   if (parent)
     parent->children.push_back(this);
 }
@@ -89,20 +172,28 @@ void TimerRecord::stop() {
     return;
   stopped = true;
 
-  i64 user2;
-  i64 sys2;
-  std::tie(user2, sys2) = get_usage();
-
   end = now_nsec();
-  user = user2 - user;
-  sys = sys2 - sys;
+  if (is_task)
+    return;
+
+  Usage u = get_usage();
+  user = u.user - user;
+  sys = u.sys - sys;
+  rss = u.rss - rss;
+  peak_rss = u.peak_rss;
+  minflt = u.minflt - minflt;
+  majflt = u.majflt - majflt;
 }
 
 static void print_rec(TimerRecord &rec, i64 indent) {
-  printf(" % 8.3f % 8.3f % 8.3f  %s%s\n",
+  printf(" % 8.3f % 8.3f % 8.3f % 8.1f % 8.1f %8lld %8lld  %s%s\n",
          ((double)rec.user / 1'000'000'000),
          ((double)rec.sys / 1'000'000'000),
          (((double)rec.end - rec.start) / 1'000'000'000),
+         ((double)rec.rss / (1024 * 1024)),
+         ((double)rec.peak_rss / (1024 * 1024)),
+         (long long)rec.minflt,
+         (long long)rec.majflt,
          std::string(indent * 2, ' ').c_str(),
          rec.name.c_str());
 
@@ -121,11 +212,13 @@ void print_timer_records(
 
   for (i64 i = 0; i < records.size(); i++) {
     TimerRecord &inner = *records[i];
-    if (inner.parent)
+    if (inner.parent || inner.is_task)
       continue;
 
     for (i64 j = i - 1; j >= 0; j--) {
       TimerRecord &outer = *records[j];
+      if (outer.is_task)
+        continue;
       if (outer.start <= inner.start && inner.end <= outer.end) {
         inner.parent = &outer;
         outer.children.push_back(&inner);
@@ -134,13 +227,82 @@ void print_timer_records(
     }
   }
 
-  std::cout << "     User   System     Real  Name\n";
+  // RSS is the amount by which the resident set size grew during a
+  // phase, and Peak is the process's peak RSS at the end of the phase.
+  // Both are in MiB. MinFlt and MajFlt are the numbers of minor and
+  // major page faults that occurred during the phase.
+  std::cout << "     User   System     Real      RSS     Peak"
+            << "   MinFlt   MajFlt  Name\n";
 
   for (std::unique_ptr<TimerRecord> &rec : records)
-    if (!rec->parent)
+    if (!rec->parent && !rec->is_task)
       print_rec(*rec, 0);
 
   std::cout << std::flush;
 }
 
+static std::string json_escape(std::string_view str) {
+  std::string out;
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if ((u8)c < 0x20) {
+      char buf[7];
+      snprintf(buf, sizeof(buf), "\\u%04x", (int)(u8)c);
+      out += buf;
+    } else {
+      out += c;
+    }
+  }
+  return out;
+}
+
+// Write timer records in the Chrome Trace Event format, which can be
+// viewed with chrome://tracing or https://ui.perfetto.dev.
+//
+// https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU
+//
+// Each record becomes a "complete" event (ph: "X") whose timestamp and
+// duration are in microseconds. Unlike --perf, which nests records by
+// their time ranges, a trace shows which thread ran each record, so
+// load imbalance between threads becomes visible.
+void write_chrome_trace(
+    tbb::concurrent_vector<std::unique_ptr<TimerRecord>> &records,
+    std::ostream &out) {
+  for (i64 i = records.size() - 1; i >= 0; i--)
+    records[i]->stop();
+
+  i64 base = INT64_MAX;
+  for (std::unique_ptr<TimerRecord> &rec : records)
+    base = std::min(base, rec->start);
+
+  out << "{\"traceEvents\":[\n";
+
+  for (i64 i = 0; i < records.size(); i++) {
+    TimerRecord &rec = *records[i];
+    char buf[100];
+    snprintf(buf, sizeof(buf),
+             "\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%lld",
+             (double)(rec.start - base) / 1000,
+             (double)(rec.end - rec.start) / 1000,
+             (long long)rec.tid);
+
+    out << "{\"name\":\"" << json_escape(rec.name) << "\",\"cat\":\""
+        << (rec.is_task ? "task" : "phase") << "\",\"ph\":\"X\"," << buf;
+
+    if (!rec.is_task)
+      out << ",\"args\":{\"user_ms\":" << rec.user / 1'000'000
+          << ",\"sys_ms\":" << rec.sys / 1'000'000
+          << ",\"rss_kb\":" << rec.rss / 1024
+          << ",\"peak_rss_kb\":" << rec.peak_rss / 1024
+          << ",\"minflt\":" << rec.minflt
+          << ",\"majflt\":" << rec.majflt << "}";
+
+    out << (i + 1 == records.size() ? "}\n" : "},\n");
+  }
+
+  out << "],\"displayTimeUnit\":\"ms\"}\n";
+}
+
 } // namespace mold
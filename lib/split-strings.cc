@@ -0,0 +1,295 @@
+// This file contains functions to split the contents of mergeable
+// string sections (e.g. .rodata.str1.1 or .debug_str) into null-
+// terminated strings. In debug builds, .debug_str can be gigabytes
+// long, so the speed of this code matters.
+//
+// A naive implementation calls memchr() for each string. That's slow
+// because most strings are short and the per-call overhead dominates.
+// Instead, we compare a whole vector register worth of bytes against
+// zero at once, convert the result to a bitmask and then iterate over
+// its set bits. We have SSE2, AVX2 and AVX-512 versions for x86-64 and
+// a NEON version for ARM64. The best one is selected at runtime.
+//
+// All versions return the same result as split_strings_scalar().
+
+#include "common.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+# define HAVE_X86_SIMD 1
+# include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+# define HAVE_NEON 1
+# include <arm_neon.h>
+#endif
+
+namespace mold {
+
+// Each null element ends a string, and the next string starts right
+// after it unless it's the end of the section. `end` is the offset of
+// a null element.
+static inline void add_offset(std::vector<u32> &vec, i64 end, i64 entsize,
+                              i64 size) {
+  if (end + entsize < size)
+    vec.push_back(end + entsize);
+}
+
+static inline bool is_null(const u8 *p, i64 entsize) {
+  switch (entsize) {
+  case 1: return p[0] == 0;
+  case 2: return *(u16 *)p == 0;
+  case 4: return *(u32 *)p == 0;
+  }
+
+  for (i64 i = 0; i < entsize; i++)
+    if (p[i])
+      return false;
+  return true;
+}
+
+// Scans [begin, size) one element at a time. Used for the remainder that
+// doesn't fill a vector register.
+static void scan_scalar(std::vector<u32> &vec, const u8 *p, i64 begin,
+                        i64 size, i64 entsize) {
+  for (i64 i = begin; i + entsize <= size; i += entsize)
+    if (is_null(p + i, entsize))
+      add_offset(vec, i, entsize, size);
+}
+
+static bool is_terminated(std::string_view data, i64 entsize) {
+  return data.size() % entsize == 0 &&
+         is_null((u8 *)data.data() + data.size() - entsize, entsize);
+}
+
+bool split_strings_scalar(std::string_view data, i64 entsize,
+                          std::vector<u32> &vec) {
+  if (data.empty())
+    return true;
+  vec.push_back(0);
+
+  // glibc's memchr() is vectorized, so this is not too bad for long
+  // strings.
+  if (entsize == 1) {
+    for (i64 pos = 0;;) {
+      const u8 *p = (u8 *)memchr(data.data() + pos, 0, data.size() - pos);
+      if (!p)
+        break;
+      add_offset(vec, p - (u8 *)data.data(), 1, data.size());
+      pos = p - (u8 *)data.data() + 1;
+    }
+  } else {
+    scan_scalar(vec, (u8 *)data.data(), 0, data.size(), entsize);
+  }
+  return is_terminated(data, entsize);
+}
+
+#ifdef HAVE_X86_SIMD
+// For entsize 2 and 4, we compare 16-bit or 32-bit lanes and use only
+// the bit corresponding to the first byte of each lane.
+static constexpr u64 lane_mask(i64 entsize) {
+  switch (entsize) {
+  case 2: return 0x5555'5555'5555'5555;
+  case 4: return 0x1111'1111'1111'1111;
+  }
+  return -1;
+}
+
+static bool split_strings_sse2(std::string_view data, i64 entsize,
+                               std::vector<u32> &vec) {
+  if (data.empty())
+    return true;
+  vec.push_back(0);
+
+  const u8 *p = (u8 *)data.data();
+  i64 size = data.size();
+  u64 mask = lane_mask(entsize);
+  __m128i zero = _mm_setzero_si128();
+  i64 i = 0;
+
+  auto cmp = [&](i64 off) -> u64 {
+    __m128i v = _mm_loadu_si128((__m128i *)(p + off));
+    __m128i eq;
+    if (entsize == 1)
+      eq = _mm_cmpeq_epi8(v, zero);
+    else if (entsize == 2)
+      eq = _mm_cmpeq_epi16(v, zero);
+    else
+      eq = _mm_cmpeq_epi32(v, zero);
+    return (u32)_mm_movemask_epi8(eq);
+  };
+
+  // Process 64 bytes per iteration to amortize the loop overhead.
+  for (; i + 64 <= size; i += 64) {
+    u64 m = cmp(i) | (cmp(i + 16) << 16) | (cmp(i + 32) << 32) |
+            (cmp(i + 48) << 48);
+
+    for (m &= mask; m; m &= m - 1)
+      add_offset(vec, i + std::countr_zero(m), entsize, size);
+  }
+
+  scan_scalar(vec, p, i, size, entsize);
+  return is_terminated(data, entsize);
+}
+
+__attribute__((target("avx2")))
+static bool split_strings_avx2(std::string_view data, i64 entsize,
+                               std::vector<u32> &vec) {
+  if (data.empty())
+    return true;
+  vec.push_back(0);
+
+  const u8 *p = (u8 *)data.data();
+  i64 size = data.size();
+  u64 mask = lane_mask(entsize);
+  __m256i zero = _mm256_setzero_si256();
+  i64 i = 0;
+
+  // Process 64 bytes per iteration to amortize the loop overhead.
+  for (; i + 64 <= size; i += 64) {
+    __m256i v1 = _mm256_loadu_si256((__m256i *)(p + i));
+    __m256i v2 = _mm256_loadu_si256((__m256i *)(p + i + 32));
+    __m256i eq1, eq2;
+
+    if (entsize == 1) {
+      eq1 = _mm256_cmpeq_epi8(v1, zero);
+      eq2 = _mm256_cmpeq_epi8(v2, zero);
+    } else if (entsize == 2) {
+      eq1 = _mm256_cmpeq_epi16(v1, zero);
+      eq2 = _mm256_cmpeq_epi16(v2, zero);
+    } else {
+      eq1 = _mm256_cmpeq_epi32(v1, zero);
+      eq2 = _mm256_cmpeq_epi32(v2, zero);
+    }
+
+    u64 m = (u32)_mm256_movemask_epi8(eq1) |
+            ((u64)(u32)_mm256_movemask_epi8(eq2) << 32);
+
+    for (m &= mask; m; m &= m - 1)
+      add_offset(vec, i + std::countr_zero(m), entsize, size);
+  }
+
+  scan_scalar(vec, p, i, size, entsize);
+  return is_terminated(data, entsize);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static bool split_strings_avx512(std::string_view data, i64 entsize,
+                                 std::vector<u32> &vec) {
+  if (data.empty())
+    return true;
+  vec.push_back(0);
+
+  const u8 *p = (u8 *)data.data();
+  i64 size = data.size();
+  __m512i zero = _mm512_setzero_si512();
+  i64 i = 0;
+
+  // AVX-512 comparisons yield one bit per lane rather than per byte,
+  // so bit N corresponds to byte offset N * entsize.
+  for (; i + 64 <= size; i += 64) {
+    __m512i v = _mm512_loadu_si512(p + i);
+    u64 m;
+    if (entsize == 1)
+      m = _mm512_cmpeq_epi8_mask(v, zero);
+    else if (entsize == 2)
+      m = _mm512_cmpeq_epi16_mask(v, zero);
+    else
+      m = _mm512_cmpeq_epi32_mask(v, zero);
+
+    for (; m; m &= m - 1)
+      add_offset(vec, i + std::countr_zero(m) * entsize, entsize, size);
+  }
+
+  scan_scalar(vec, p, i, size, entsize);
+  return is_terminated(data, entsize);
+}
+#endif
+
+#ifdef HAVE_NEON
+// NEON doesn't have an equivalent of movemask. We narrow each 8-bit
+// comparison result to 4 bits with vshrn, so that a 16-byte vector
+// becomes a 64-bit mask in which byte N corresponds to bits [4N, 4N+4).
+//   https://community.arm.com/arm-community-blogs/b/infrastructure-solutions-blog/posts/porting-x86-vector-bitmask-optimizations-to-arm-neon
+static bool split_strings_neon(std::string_view data, i64 entsize,
+                               std::vector<u32> &vec) {
+  if (data.empty())
+    return true;
+  vec.push_back(0);
+
+  const u8 *p = (u8 *)data.data();
+  i64 size = data.size();
+  i64 i = 0;
+
+  u64 mask = 0x1111'1111'1111'1111;
+  if (entsize == 2)
+    mask = 0x0101'0101'0101'0101;
+  else if (entsize == 4)
+    mask = 0x0001'0001'0001'0001;
+
+  for (; i + 16 <= size; i += 16) {
+    uint8x16_t eq;
+    if (entsize == 1)
+      eq = vceqzq_u8(vld1q_u8(p + i));
+    else if (entsize == 2)
+      eq = vreinterpretq_u8_u16(vceqzq_u16(vld1q_u16((u16 *)(p + i))));
+    else
+      eq = vreinterpretq_u8_u32(vceqzq_u32(vld1q_u32((u32 *)(p + i))));
+
+    uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(eq), 4);
+    u64 m = vget_lane_u64(vreinterpret_u64_u8(narrowed), 0) & mask;
+
+    for (; m; m &= m - 1)
+      add_offset(vec, i + std::countr_zero(m) / 4, entsize, size);
+  }
+
+  scan_scalar(vec, p, i, size, entsize);
+  return is_terminated(data, entsize);
+}
+#endif
+
+std::vector<SplitStringsImpl> get_split_strings_impls() {
+  std::vector<SplitStringsImpl> vec;
+  vec.push_back({"scalar", split_strings_scalar});
+
+#ifdef HAVE_X86_SIMD
+  vec.push_back({"sse2", split_strings_sse2});
+  if (__builtin_cpu_supports("avx2"))
+    vec.push_back({"avx2", split_strings_avx2});
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+    vec.push_back({"avx512", split_strings_avx512});
+#endif
+
+#ifdef HAVE_NEON
+  vec.push_back({"neon", split_strings_neon});
+#endif
+  return vec;
+}
+
+// Splits `data` into strings each of which ends with a null element of
+// `entsize` bytes and appends their start offsets to `vec`. Returns false
+// if the last string is not null-terminated.
+bool split_strings(std::string_view data, i64 entsize, std::vector<u32> &vec) {
+  static SplitStringsFn *fn = get_split_strings_impls().back().fn;
+  if (entsize == 1 || entsize == 2 || entsize == 4)
+    return fn(data, entsize, vec);
+  return split_strings_scalar(data, entsize, vec);
+}
+
+// Computes hashes of the `begin`-th to `end`-th (exclusive) strings
+// whose start offsets are given by `offsets`. Hashing fragments in a
+// tight loop separately from splitting keeps both loops small and lets
+// the CPU overlap the hash computations of consecutive fragments.
+void hash_strings(std::string_view data, std::span<const u32> offsets,
+                  i64 begin, i64 end, u64 *out) {
+  const char *p = data.data();
+  i64 last = offsets.size() - 1;
+  i64 i = begin;
+
+  for (; i < end && i < last; i++)
+    *out++ = hash_string({p + offsets[i], (size_t)(offsets[i + 1] - offsets[i])});
+  if (i < end)
+    *out = hash_string(data.substr(offsets[i]));
+}
+
+} // namespace mold
@@ -368,7 +368,24 @@ template <>
 void InputSection<E>::apply_reloc_alloc(Context<E> &ctx, u8 *base) {
   std::span<const ElfRel<E>> rels = get_rels(ctx);
 
-  for (i64 i = 0; i < rels.size(); i++) {
+  // If scan_relocations() compiled a relocation program for this
+  // section, run it first and then visit only the relocations it
+  // couldn't handle. If the program finds an out-of-range value, we
+  // fall back to the generic loop so that we report a proper error.
+  RelocProgram *prog = extra.reloc_program.get();
+  if (prog && !apply_reloc_program(ctx, base))
+    prog = nullptr;
+
+  // Relocations that consume the following one (TLSGD and TLSLD) are
+  // never compiled, so the loop body never advances `i` by itself.
+  i64 j = 0;
+  auto next = [&](i64 i) -> i64 {
+    if (!prog)
+      return i + 1;
+    return (j < prog->generic.size()) ? prog->generic[j++] : rels.size();
+  };
+
+  for (i64 i = next(-1); i < rels.size(); i = next(i)) {
     const ElfRel<E> &rel = rels[i];
     if (rel.r_type == R_NONE)
       continue;
@@ -695,6 +712,32 @@ void InputSection<E>::apply_reloc_nonalloc(Context<E> &ctx, u8 *base) {
   }
 }
 
+// Returns how a relocation is compiled into a relocation program.
+// Only the most common relocations whose value depends on nothing but
+// S, A and P are handled by the program; the rest are left to the
+// generic loop in apply_reloc_alloc().
+static RelocOpKind get_reloc_op_kind(u32 r_type) {
+  switch (r_type) {
+  case R_NONE:
+  case R_X86_64_64:
+    return RELOC_OP_SKIP;
+  case R_X86_64_32:
+    return RELOC_OP_ABS32;
+  case R_X86_64_32S:
+    return RELOC_OP_ABS32S;
+  case R_X86_64_PC32:
+  case R_X86_64_PLT32:
+    return RELOC_OP_PC32;
+  case R_X86_64_PC64:
+    return RELOC_OP_PC64;
+  case R_X86_64_TLSGD:
+  case R_X86_64_TLSLD:
+    return RELOC_OP_UNSUPPORTED;
+  default:
+    return RELOC_OP_GENERIC;
+  }
+}
+
 // Linker has to create data structures in an output file to apply
 // some type of relocations. For example, if a relocation refers a GOT
 // or a PLT entry of a symbol, linker has to create an entry in .got
@@ -705,12 +748,16 @@ void InputSection<E>::scan_relocations(Context<E> &ctx) {
   assert(shdr().sh_flags & SHF_ALLOC);
   std::span<const ElfRel<E>> rels = get_rels(ctx);
 
+  RelocProgramBuilder<E> builder(*this, rels.size());
+
   // Scan relocations
   for (i64 i = 0; i < rels.size(); i++) {
     const ElfRel<E> &rel = rels[i];
     if (rel.r_type == R_NONE || record_undef_error(ctx, rel))
       continue;
 
+    builder.add(get_reloc_op_kind(rel.r_type), i, rel);
+
     Symbol<E> &sym = *file.symbols[rel.r_sym];
     u8 *loc = (u8 *)(contents.data() + rel.r_offset);
 
@@ -805,6 +852,8 @@ void InputSection<E>::scan_relocations(Context<E> &ctx) {
       Error(ctx) << *this << ": unknown relocation: " << rel;
     }
   }
+
+  builder.finish();
 }
 
 // Intel CET is a relatively new CPU feature to enhance security by
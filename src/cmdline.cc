@@ -1,5 +1,6 @@
 #include "mold.h"
 
+#include <charconv>
 #include <random>
 #include <regex>
 #include <sstream>
@@ -40,7 +41,7 @@ Options:
   -M, --print-map             Write map file to stdout
   -N, --omagic                Do not page align data; do not make text readonly
     --no-omagic
-  -O NUMBER                   Ignored
+  -O NUMBER                   Set optimization level; -O2 or higher enables --tail-merge-strings
   -S, --strip-debug           Strip .debug_* sections
   -T FILE, --script FILE      Read linker script
   -X, --discard-locals        Discard temporary local symbols
@@ -79,14 +80,21 @@ Options:
   --build-id [none,md5,sha1,sha256,fast,uuid,HEXSTRING]
                               Generate build ID
     --no-build-id
+  --call-graph-ordering-file FILE
+                              Sort sections using call graph edges in FILE
+  --call-graph-profile-sort   Sort sections using call graph profile (default)
+    --no-call-graph-profile-sort
   --chroot DIR                Set a given path to the root directory
   --color-diagnostics=[auto,always,never]
                               Use colors in diagnostics
   --color-diagnostics         Alias for --color-diagnostics=always
-  --compress-debug-sections [none,zlib,zlib-gabi,zstd]
+  --compress-debug-sections [none,zlib,zlib-gabi,zstd][:LEVEL]
                               Compress .debug_* sections
+  --data-access-trace FILE    Place data sections touched in FILE first
   --dc                        Ignored
   --dependency-file=FILE      Write Makefile-style dependency rules to FILE
+  --debug-names               Create .debug_names for faster debugger startup
+    --no-debug-names
   --defsym=SYMBOL=VALUE       Define a symbol alias
   --demangle                  Demangle C++ symbols in log messages (default)
     --no-demangle
@@ -109,6 +117,8 @@ Options:
   --fini SYMBOL               Call SYMBOL at unload-time
   --fork                      Spawn a child process (default)
     --no-fork
+  --gc-debug-info             Remove debug info for removed functions
+    --no-gc-debug-info
   --gc-sections               Remove unreferenced sections
     --no-gc-sections
   --gdb-index                 Create .gdb_index for faster gdb startup
@@ -116,19 +126,28 @@ Options:
                               Set hash style
   --icf=[all,safe,none]       Fold identical code
     --no-icf
+  --icf-algorithm=[hash,refine]
+                              Set the algorithm to find identical sections
   --ignore-data-address-equality
                               Allow merging non-executable sections with --icf
   --image-base ADDR           Set the base address to a given value
+  --incremental               Reuse the previous output file if the layout is unchanged
+    --no-incremental
   --init SYMBOL               Call SYMBOL at load-time
+  --input-cache=DIR           Cache the result of splitting mergeable sections in DIR
+    --no-input-cache
   --nmagic                    Do not page align sections
     --no-nmagic
   --no-undefined              Report undefined symbols (even with --shared)
   --noinhibit-exec            Create an output file even if errors occur
   --oformat=binary            Omit ELF, section, and program headers
+  --output-io=[mmap,pwrite,uring]
+                              Choose how to write the output file (default: mmap)
   --pack-dyn-relocs=[relr,none]
                               Pack dynamic relocations
   --package-metadata=STRING   Set a given string to .note.package
   --perf                      Print performance statistics
+  --perf-trace=FILE           Write a timeline of the link in Chrome Trace Event format
   --pie, --pic-executable     Create a position-independent executable
     --no-pie, --no-pic-executable
   --pop-state                 Restore the state of flags governing input file handling
@@ -143,6 +162,9 @@ Options:
     --no-relax
   --repro                     Embed input files in .repro section
   --require-defined SYMBOL    Require SYMBOL be defined in the final output
+  --reuse-compressed-debug-sections
+                              Copy zstd-compressed input debug sections as-is
+    --no-reuse-compressed-debug-sections
   --retain-symbols-file FILE  Keep only symbols listed in FILE
   --reverse-sections          Reverse input sections in the output file
   --rosegment                 Put read-only non-executable sections in their own segment (default)
@@ -163,7 +185,10 @@ Options:
   --start-lib                 Give following object files in-archive-file semantics
     --end-lib                 End the effect of --start-lib
   --stats                     Print input statistics
+  --symbol-ordering-file FILE Place sections defining symbols in FILE first
   --sysroot DIR               Set the target system root directory
+  --tail-merge-strings        Merge strings that are suffixes of other strings
+    --no-tail-merge-strings
   --thread-count COUNT, --threads=COUNT
                               Use COUNT number of threads
   --threads                   Use multiple threads (default)
@@ -179,6 +204,8 @@ Options:
   --warn-common               Warn about common symbols
     --no-warn-common
   --warn-once                 Only warn once for each undefined symbol
+  --warn-symbol-ordering      Warn about symbols in --symbol-ordering-file that cannot be ordered (default)
+    --no-warn-symbol-ordering
   --warn-shared-textrel       Warn if the output .so needs text relocations
   --warn-textrel              Warn if the output file needs text relocations
   --warn-unresolved-symbols   Report unresolved symbols as warnings
@@ -505,6 +532,125 @@ static void read_retain_symbols_file(Context<E> &ctx, std::string_view path) {
   ctx.arg.retain_symbols_file = std::move(vec);
 }
 
+// A symbol ordering file contains one symbol name per line. Text after
+// '#' is a comment.
+template <typename E>
+static void read_symbol_ordering_file(Context<E> &ctx, std::string_view path) {
+  MappedFile *mf = must_open_file(ctx, std::string(path));
+  std::string_view data((char *)mf->data, mf->size);
+  std::vector<Symbol<E> *> vec;
+
+  while (!data.empty()) {
+    size_t pos = data.find('\n');
+    std::string_view name;
+
+    if (pos == data.npos) {
+      name = data;
+      data = "";
+    } else {
+      name = data.substr(0, pos);
+      data = data.substr(pos + 1);
+    }
+
+    name = string_trim(name.substr(0, name.find('#')));
+    if (name.empty())
+      continue;
+
+    vec.push_back(get_symbol(ctx, name));
+  }
+
+  ctx.arg.symbol_ordering_file = std::move(vec);
+}
+
+// Each line of a call graph ordering file has the form
+// "<caller> <callee> <weight>".
+template <typename E>
+static void read_call_graph_ordering_file(Context<E> &ctx, std::string_view path) {
+  MappedFile *mf = must_open_file(ctx, std::string(path));
+  std::string_view data((char *)mf->data, mf->size);
+  std::vector<std::tuple<Symbol<E> *, Symbol<E> *, u64>> vec;
+
+  while (!data.empty()) {
+    size_t pos = data.find('\n');
+    std::string_view line;
+
+    if (pos == data.npos) {
+      line = data;
+      data = "";
+    } else {
+      line = data.substr(0, pos);
+      data = data.substr(pos + 1);
+    }
+
+    line = string_trim(line);
+    if (line.empty())
+      continue;
+
+    // Symbol names refer to the mapped file, so we don't copy them.
+    std::vector<std::string_view> fields;
+    for (std::string_view s = line; !s.empty();) {
+      size_t pos = s.find_first_of(" \t");
+      fields.push_back(s.substr(0, pos));
+      s = (pos == s.npos) ? "" : string_trim(s.substr(pos));
+    }
+
+    u64 weight;
+    if (fields.size() != 3 ||
+        std::from_chars(fields[2].data(), fields[2].data() + fields[2].size(),
+                        weight).ptr != fields[2].data() + fields[2].size())
+      Fatal(ctx) << path << ": parse error: " << line;
+
+    vec.push_back({get_symbol(ctx, fields[0]), get_symbol(ctx, fields[1]),
+                   weight});
+  }
+
+  ctx.arg.call_graph_ordering = std::move(vec);
+}
+
+// Each line of a data access trace has the form "<name> <timestamp>",
+// where <name> is a symbol or an input section name. Text after '#' is
+// a comment.
+template <typename E>
+static void read_data_access_trace(Context<E> &ctx, std::string_view path) {
+  MappedFile *mf = must_open_file(ctx, std::string(path));
+  std::string_view data((char *)mf->data, mf->size);
+  std::vector<std::pair<std::string_view, u64>> vec;
+
+  while (!data.empty()) {
+    size_t pos = data.find('\n');
+    std::string_view line;
+
+    if (pos == data.npos) {
+      line = data;
+      data = "";
+    } else {
+      line = data.substr(0, pos);
+      data = data.substr(pos + 1);
+    }
+
+    line = string_trim(line.substr(0, line.find('#')));
+    if (line.empty())
+      continue;
+
+    pos = line.find_first_of(" \t");
+    if (pos == line.npos)
+      Fatal(ctx) << path << ": parse error: " << line;
+
+    std::string_view name = line.substr(0, pos);
+    std::string_view time = string_trim(line.substr(pos));
+
+    u64 val;
+    if (std::from_chars(time.data(), time.data() + time.size(), val).ptr !=
+        time.data() + time.size())
+      Fatal(ctx) << path << ": parse error: " << line;
+
+    // Names refer to the mapped file, so we don't copy them.
+    vec.push_back({name, val});
+  }
+
+  ctx.arg.data_access_trace = std::move(vec);
+}
+
 static bool is_file(std::string_view path) {
   struct stat st;
   return stat(std::string(path).c_str(), &st) == 0 &&
@@ -1074,10 +1220,18 @@ std::vector<std::string> parse_nonpositional_args(Context<E> &ctx) {
       ctx.arg.relax = true;
     } else if (read_flag("no-relax")) {
       ctx.arg.relax = false;
+    } else if (read_flag("reuse-compressed-debug-sections")) {
+      ctx.arg.reuse_compressed_debug_sections = true;
+    } else if (read_flag("no-reuse-compressed-debug-sections")) {
+      ctx.arg.reuse_compressed_debug_sections = false;
     } else if (read_flag("gdb-index")) {
       ctx.arg.gdb_index = true;
     } else if (read_flag("no-gdb-index")) {
       ctx.arg.gdb_index = false;
+    } else if (read_flag("debug-names")) {
+      ctx.arg.debug_names = true;
+    } else if (read_flag("no-debug-names")) {
+      ctx.arg.debug_names = false;
     } else if (read_flag("r") || read_flag("relocatable")) {
       // -r, --relocatable:
       // Instead of generating an executable or a shared object file, combine input object files to
@@ -1104,6 +1258,8 @@ std::vector<std::string> parse_nonpositional_args(Context<E> &ctx) {
       ctx.arg.relocatable_merge_sections = true;
     } else if (read_flag("perf")) {
       ctx.arg.perf = true;
+    } else if (read_arg("perf-trace")) {
+      ctx.arg.perf_trace = arg;
     } else if (read_flag("pack-dyn-relocs=relr") ||
                read_z_flag("pack-relative-relocs")) {
       ctx.arg.pack_dyn_relocs_relr = true;
@@ -1146,14 +1302,31 @@ std::vector<std::string> parse_nonpositional_args(Context<E> &ctx) {
     } else if (read_flag("execute-only")) {
       ctx.arg.execute_only = true;
     } else if (read_arg("compress-debug-sections")) {
-      if (arg == "zlib" || arg == "zlib-gabi")
+      std::string_view kind = arg.substr(0, arg.find(':'));
+      i64 max_level = 0;
+
+      if (kind == "zlib" || kind == "zlib-gabi") {
         ctx.arg.compress_debug_sections = COMPRESS_ZLIB;
-      else if (arg == "zstd")
+        ctx.arg.compress_debug_level = 1;
+        max_level = 9;
+      } else if (kind == "zstd") {
         ctx.arg.compress_debug_sections = COMPRESS_ZSTD;
-      else if (arg == "none")
+        ctx.arg.compress_debug_level = 3;
+        max_level = 22;
+      } else if (arg == "none") {
         ctx.arg.compress_debug_sections = COMPRESS_NONE;
-      else
+      } else {
         Fatal(ctx) << "invalid --compress-debug-sections argument: " << arg;
+      }
+
+      if (kind.size() < arg.size()) {
+        i64 level = parse_number(ctx, "compress-debug-sections",
+                                 arg.substr(kind.size() + 1));
+        if (level < 1 || max_level < level)
+          Fatal(ctx) << "--compress-debug-sections: invalid compression level: "
+                     << arg;
+        ctx.arg.compress_debug_level = level;
+      }
     } else if (read_arg("wrap")) {
       ctx.arg.wrap.insert(arg);
     } else if (read_flag("omagic") || read_flag("N")) {
@@ -1174,8 +1347,23 @@ std::vector<std::string> parse_nonpositional_args(Context<E> &ctx) {
       if (arg != "binary")
         Fatal(ctx) << "-oformat: " << arg << " is not supported";
       ctx.arg.oformat_binary = true;
+    } else if (read_arg("output-io")) {
+      if (arg == "mmap")
+        ctx.arg.output_io = OUTPUT_IO_MMAP;
+      else if (arg == "pwrite")
+        ctx.arg.output_io = OUTPUT_IO_PWRITE;
+      else if (arg == "uring")
+        ctx.arg.output_io = OUTPUT_IO_URING;
+      else
+        Fatal(ctx) << "unknown --output-io argument: " << arg;
     } else if (read_arg("retain-symbols-file")) {
       read_retain_symbols_file(ctx, arg);
+    } else if (read_arg("symbol-ordering-file")) {
+      read_symbol_ordering_file(ctx, arg);
+    } else if (read_flag("warn-symbol-ordering")) {
+      ctx.arg.warn_symbol_ordering = true;
+    } else if (read_flag("no-warn-symbol-ordering")) {
+      ctx.arg.warn_symbol_ordering = false;
     } else if (read_arg("section-align")) {
       size_t pos = arg.find('=');
       if (pos == arg.npos || pos == arg.size() - 1)
@@ -1318,6 +1506,18 @@ std::vector<std::string> parse_nonpositional_args(Context<E> &ctx) {
       ctx.arg.fork = true;
     } else if (read_flag("no-fork")) {
       ctx.arg.fork = false;
+    } else if (read_flag("call-graph-profile-sort")) {
+      ctx.arg.call_graph_profile_sort = true;
+    } else if (read_flag("no-call-graph-profile-sort")) {
+      ctx.arg.call_graph_profile_sort = false;
+    } else if (read_arg("call-graph-ordering-file")) {
+      read_call_graph_ordering_file(ctx, arg);
+    } else if (read_arg("data-access-trace")) {
+      read_data_access_trace(ctx, arg);
+    } else if (read_flag("gc-debug-info")) {
+      ctx.arg.gc_debug_info = true;
+    } else if (read_flag("no-gc-debug-info")) {
+      ctx.arg.gc_debug_info = false;
     } else if (read_flag("gc-sections")) {
       ctx.arg.gc_sections = true;
     } else if (read_flag("no-gc-sections")) {
@@ -1339,10 +1539,25 @@ std::vector<std::string> parse_nonpositional_args(Context<E> &ctx) {
       }
     } else if (read_flag("no-icf")) {
       ctx.arg.icf = false;
+    } else if (read_arg("icf-algorithm")) {
+      if (arg == "hash")
+        ctx.arg.icf_algorithm = ICF_HASH;
+      else if (arg == "refine")
+        ctx.arg.icf_algorithm = ICF_REFINE;
+      else
+        Fatal(ctx) << "unknown --icf-algorithm argument: " << arg;
     } else if (read_flag("ignore-data-address-equality")) {
       ctx.arg.ignore_data_address_equality = true;
     } else if (read_arg("image-base")) {
       ctx.arg.image_base = parse_number(ctx, "image-base", arg);
+    } else if (read_flag("incremental")) {
+      ctx.arg.incremental = true;
+    } else if (read_flag("no-incremental")) {
+      ctx.arg.incremental = false;
+    } else if (read_arg("input-cache")) {
+      ctx.arg.input_cache = arg;
+    } else if (read_flag("no-input-cache")) {
+      ctx.arg.input_cache = "";
     } else if (read_arg("physical-image-base")) {
       ctx.arg.physical_image_base = parse_number(ctx, "physical-image-base", arg);
     } else if (read_flag("print-icf-sections")) {
@@ -1500,11 +1715,22 @@ std::vector<std::string> parse_nonpositional_args(Context<E> &ctx) {
     } else if (read_flag("no-allow-shlib-undefined")) {
       ctx.arg.allow_shlib_undefined = false;
     } else if (read_arg("O")) {
+      // -O2 or higher enables tail merging as is the case with lld.
+      // Other values are ignored.
+      i64 level;
+      if (std::from_chars(arg.data(), arg.data() + arg.size(), level).ptr ==
+          arg.data() + arg.size())
+        ctx.arg.tail_merge_strings = (level >= 2);
     } else if (read_flag("EB")) {
     } else if (read_flag("EL")) {
-    } else if (read_flag("O0")) {
-    } else if (read_flag("O1")) {
+    } else if (read_flag("O0") || read_flag("O1")) {
+      ctx.arg.tail_merge_strings = false;
     } else if (read_flag("O2")) {
+      ctx.arg.tail_merge_strings = true;
+    } else if (read_flag("tail-merge-strings")) {
+      ctx.arg.tail_merge_strings = true;
+    } else if (read_flag("no-tail-merge-strings")) {
+      ctx.arg.tail_merge_strings = false;
     } else if (read_flag("verbose")) {
     } else if (read_flag("color-diagnostics")) {
     } else if (read_flag("eh-frame-hdr")) {
@@ -1517,7 +1743,6 @@ std::vector<std::string> parse_nonpositional_args(Context<E> &ctx) {
     } else if (read_flag("disable-new-dtags")) {
     } else if (read_flag("nostdlib")) {
     } else if (read_flag("no-add-needed")) {
-    } else if (read_flag("no-call-graph-profile-sort")) {
     } else if (read_flag("no-copy-dt-needed-entries")) {
     } else if (read_arg("sort-section")) {
     } else if (read_flag("sort-common")) {
@@ -1625,6 +1850,10 @@ std::vector<std::string> parse_nonpositional_args(Context<E> &ctx) {
     ctx.arg.discard_all = false;
   }
 
+  if (ctx.arg.symbol_ordering_file && !ctx.arg.call_graph_ordering.empty())
+    Fatal(ctx) << "--symbol-ordering-file and --call-graph-ordering-file "
+               << "may not be used together";
+
   if (ctx.arg.relocatable)
     ctx.arg.static_ = true;
 
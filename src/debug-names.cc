@@ -0,0 +1,768 @@
+// This file contains code to create a .debug_names section.
+//
+// .debug_names is an accelerator table defined by DWARF 5. It maps
+// names of functions, variables, types and namespaces to debug info
+// entries (DIEs) in .debug_info, so that a debugger can find the DIE
+// for a given name without scanning the whole .debug_info. lldb and
+// gdb use it if exists. Unlike .gdb_index, it's a standard section.
+//
+// A compiler may create a .debug_names for each compunit (e.g. Clang
+// with -gpubnames), and a linker can simply concatenate them because a
+// .debug_names section may contain more than one name index. However,
+// a debugger would then have to look up a name in each of the name
+// indices, which defeats the purpose of having an index for a large
+// program. Besides, GCC doesn't create .debug_names at all.
+//
+// So, if --debug-names is given, we discard input .debug_names sections
+// and create a single name index covering all compunits by reading the
+// output .debug_info. Just like .gdb_index, we need post-relocated
+// debug info sections to do that, and the section size is hard to
+// estimate beforehand. Therefore, this section is created after all the
+// other sections are written and placed at the end of the output file.
+//
+// Names in .debug_names are represented as offsets in .debug_str, so
+// we can't index names that are directly embedded to .debug_info as
+// DW_FORM_string. GCC uses that form only for names up to three bytes
+// long, and Clang always uses .debug_str.
+//
+// The format of .debug_names is described in Section 6.1.1 of the DWARF
+// 5 specification: https://dwarfstd.org/doc/DWARF5.pdf
+
+#include "mold.h"
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_for_each.h>
+#include <tbb/parallel_sort.h>
+
+namespace mold {
+
+// We create one abbreviation for each tag. Abbreviation codes are
+// indices in this array plus one.
+static constexpr u32 indexed_tags[] = {
+  DW_TAG_class_type, DW_TAG_enumeration_type, DW_TAG_structure_type,
+  DW_TAG_typedef, DW_TAG_union_type, DW_TAG_inlined_subroutine,
+  DW_TAG_base_type, DW_TAG_subprogram, DW_TAG_variable, DW_TAG_namespace,
+  DW_TAG_unspecified_type,
+};
+
+static u32 get_abbrev_code(u32 tag) {
+  for (i64 i = 0; i < std::size(indexed_tags); i++)
+    if (indexed_tags[i] == tag)
+      return i + 1;
+  return 0;
+}
+
+// The hash function for .debug_names. It's the DJB hash of a name
+// with uppercase ASCII letters converted to lowercase.
+static u32 djb_hash(std::string_view name) {
+  u32 h = 5381;
+  for (u8 c : name) {
+    if ('A' <= c && c <= 'Z')
+      c = 'a' + c - 'A';
+    h = h * 33 + c;
+  }
+  return h;
+}
+
+struct NameEntry {
+  u64 str_offset;
+  u64 hash;
+  u32 die_offset;
+  u32 abbrev_code;
+};
+
+struct MapValue {
+  u32 djb_hash = 0;
+  Atomic<u32> count;
+  Atomic<u32> cursor;
+  Atomic<u64> str_offset = -1;
+  u64 entry_offset = 0;
+  u64 record_idx = 0;
+};
+
+struct Unit {
+  i64 offset;
+  i64 size;
+  i64 header_size;
+  i64 version;
+  i64 offset_size;
+  i64 addr_size;
+  u64 abbrev_offset;
+  i64 idx = -1;
+  std::vector<NameEntry> names;
+  std::vector<MapValue *> entries;
+};
+
+// An entry in the entry pool. The CU index and the DIE offset are
+// written in a fixed size, so all entries have the same size.
+struct Record {
+  bool operator<(const Record &x) const {
+    return std::tuple(cu_idx, die_offset, abbrev_code) <
+           std::tuple(x.cu_idx, x.die_offset, x.abbrev_code);
+  }
+
+  u32 cu_idx;
+  u32 die_offset;
+  u32 abbrev_code;
+};
+
+struct AbbrevAttr {
+  u64 name;
+  u64 form;
+  i64 implicit_const;
+};
+
+struct Abbrev {
+  u64 tag = 0;
+  bool has_children = false;
+  std::vector<AbbrevAttr> attrs;
+};
+
+// Attributes of a DIE that we are interested in. String attributes
+// are offsets in .debug_str, and the reference is an offset from the
+// beginning of the compunit. -1 means the attribute doesn't exist.
+struct DieInfo {
+  u64 offset = 0;
+  i64 name = -1;
+  i64 linkage_name = -1;
+  i64 ref = -1;
+};
+
+template <typename E>
+static i64 read_offset(u8 *p, i64 offset_size) {
+  if (offset_size == 8)
+    return *(U64<E> *)p;
+  return *(U32<E> *)p;
+}
+
+// Reads one attribute value from a given location. Block values are
+// skipped and 0 is returned for them.
+template <typename E>
+static u64 read_form(Context<E> &ctx, u8 **p, u64 form, const Unit &unit,
+                     i64 implicit_const) {
+  auto read = [&](i64 size) -> u64 {
+    u8 *loc = *p;
+    *p += size;
+    switch (size) {
+    case 1: return *loc;
+    case 2: return *(U16<E> *)loc;
+    case 3: return *(U24<E> *)loc;
+    case 4: return *(U32<E> *)loc;
+    default: return *(U64<E> *)loc;
+    }
+  };
+
+  switch (form) {
+  case DW_FORM_flag_present:
+    return 1;
+  case DW_FORM_implicit_const:
+    return implicit_const;
+  case DW_FORM_data1:
+  case DW_FORM_flag:
+  case DW_FORM_ref1:
+  case DW_FORM_strx1:
+  case DW_FORM_addrx1:
+    return read(1);
+  case DW_FORM_data2:
+  case DW_FORM_ref2:
+  case DW_FORM_strx2:
+  case DW_FORM_addrx2:
+    return read(2);
+  case DW_FORM_strx3:
+  case DW_FORM_addrx3:
+    return read(3);
+  case DW_FORM_data4:
+  case DW_FORM_ref4:
+  case DW_FORM_ref_sup4:
+  case DW_FORM_strx4:
+  case DW_FORM_addrx4:
+    return read(4);
+  case DW_FORM_data8:
+  case DW_FORM_ref8:
+  case DW_FORM_ref_sig8:
+  case DW_FORM_ref_sup8:
+    return read(8);
+  case DW_FORM_data16:
+    *p += 16;
+    return 0;
+  case DW_FORM_addr:
+    return read(unit.addr_size);
+  case DW_FORM_ref_addr:
+    return read(unit.version == 2 ? unit.addr_size : unit.offset_size);
+  case DW_FORM_strp:
+  case DW_FORM_line_strp:
+  case DW_FORM_sec_offset:
+  case DW_FORM_strp_sup:
+  case DW_FORM_GNU_ref_alt:
+  case DW_FORM_GNU_strp_alt:
+    return read(unit.offset_size);
+  case DW_FORM_udata:
+  case DW_FORM_ref_udata:
+  case DW_FORM_strx:
+  case DW_FORM_addrx:
+  case DW_FORM_loclistx:
+  case DW_FORM_rnglistx:
+  case DW_FORM_GNU_addr_index:
+  case DW_FORM_GNU_str_index:
+    return read_uleb(p);
+  case DW_FORM_sdata:
+    return read_sleb(p);
+  case DW_FORM_string:
+    *p += strlen((char *)*p) + 1;
+    return 0;
+  case DW_FORM_block1:
+    *p += read(1);
+    return 0;
+  case DW_FORM_block2:
+    *p += read(2);
+    return 0;
+  case DW_FORM_block4:
+    *p += read(4);
+    return 0;
+  case DW_FORM_block:
+  case DW_FORM_exprloc:
+    *p += read_uleb(p);
+    return 0;
+  case DW_FORM_indirect:
+    return read_form(ctx, p, read_uleb(p), unit, implicit_const);
+  default:
+    Fatal(ctx) << "--debug-names: unhandled debug info form: 0x"
+               << std::hex << form;
+  }
+}
+
+template <typename E>
+static std::vector<Abbrev> read_abbrevs(Context<E> &ctx, const Unit &unit) {
+  if (ctx.debug_abbrev.size() <= unit.abbrev_offset)
+    Fatal(ctx) << "--debug-names: corrupted abbrev offset";
+
+  std::vector<Abbrev> vec;
+  u8 *p = &ctx.debug_abbrev[0] + unit.abbrev_offset;
+
+  for (;;) {
+    u64 code = read_uleb(&p);
+    if (code == 0)
+      break;
+
+    // Abbreviation codes are usually consecutive numbers starting at 1.
+    if (code >= vec.size())
+      vec.resize(code + 1);
+
+    Abbrev &abbrev = vec[code];
+    abbrev.tag = read_uleb(&p);
+    abbrev.has_children = *p++;
+
+    for (;;) {
+      u64 name = read_uleb(&p);
+      u64 form = read_uleb(&p);
+      if (name == 0 && form == 0)
+        break;
+
+      i64 val = 0;
+      if (form == DW_FORM_implicit_const)
+        val = read_sleb(&p);
+      abbrev.attrs.push_back({name, form, val});
+    }
+  }
+  return vec;
+}
+
+// Walks all DIEs in a given compunit to find names to be indexed.
+//
+// Following the DWARF specification, we index named types and
+// namespaces, concrete functions (i.e. the ones with addresses) and
+// global variables (i.e. the ones with locations). Concrete function
+// DIEs often don't have names and instead refer other DIEs with
+// DW_AT_specification or DW_AT_abstract_origin. We follow such
+// references to find names.
+template <typename E>
+static void read_unit(Context<E> &ctx, Unit &unit) {
+  std::vector<Abbrev> abbrevs = read_abbrevs(ctx, unit);
+
+  u8 *begin = &ctx.debug_info[0] + unit.offset;
+  u8 *p = begin + unit.header_size;
+  u8 *end = begin + unit.size;
+
+  i64 str_offsets_base = -1;
+  i64 addr_base = -1;
+
+  std::vector<DieInfo> infos;
+  std::vector<std::pair<u32, u32>> candidates;
+  std::vector<u32> stack;
+
+  auto get_str = [&](u64 form, u64 val) -> i64 {
+    switch (form) {
+    case DW_FORM_strp:
+      return val;
+    case DW_FORM_strx:
+    case DW_FORM_strx1:
+    case DW_FORM_strx2:
+    case DW_FORM_strx3:
+    case DW_FORM_strx4: {
+      if (str_offsets_base == -1)
+        return -1;
+      u64 off = str_offsets_base + val * unit.offset_size;
+      if (ctx.debug_str_offsets.size() < off + unit.offset_size)
+        return -1;
+      return read_offset<E>(&ctx.debug_str_offsets[off], unit.offset_size);
+    }
+    }
+    return -1;
+  };
+
+  // Returns true if an address is not a tombstone value for an
+  // eliminated section.
+  auto is_live_addr = [&](u64 form, u64 val) {
+    if (form == DW_FORM_addr)
+      return val != 0;
+    if (addr_base == -1)
+      return false;
+    u64 off = addr_base + val * unit.addr_size;
+    if (ctx.debug_addr.size() < off + unit.addr_size)
+      return false;
+    return read_offset<E>(&ctx.debug_addr[off], unit.addr_size) != 0;
+  };
+
+  while (p < end) {
+    u64 die_offset = p - begin;
+    u64 code = read_uleb(&p);
+
+    if (code == 0) {
+      if (!stack.empty())
+        stack.pop_back();
+      continue;
+    }
+
+    if (abbrevs.size() <= code || abbrevs[code].tag == 0)
+      Fatal(ctx) << "--debug-names: unknown abbrev code: " << code;
+
+    Abbrev &abbrev = abbrevs[code];
+    DieInfo info{die_offset};
+    std::pair<u64, u64> name;
+    std::pair<u64, u64> linkage_name;
+    std::pair<u64, u64> low_pc;
+    bool has_ranges = false;
+    bool has_location = false;
+    bool is_declaration = false;
+
+    for (AbbrevAttr &attr : abbrev.attrs) {
+      u64 form = attr.form;
+      if (form == DW_FORM_indirect) {
+        u8 *q = p;
+        form = read_uleb(&q);
+      }
+
+      u64 val = read_form(ctx, &p, attr.form, unit, attr.implicit_const);
+
+      switch (attr.name) {
+      case DW_AT_name:
+        name = {form, val};
+        break;
+      case DW_AT_linkage_name:
+      case DW_AT_MIPS_linkage_name:
+        linkage_name = {form, val};
+        break;
+      case DW_AT_specification:
+      case DW_AT_abstract_origin:
+        if (form == DW_FORM_ref_addr) {
+          if (unit.offset <= val && val < unit.offset + unit.size)
+            info.ref = val - unit.offset;
+        } else if (form != DW_FORM_ref_sig8 && form != DW_FORM_GNU_ref_alt &&
+                   form != DW_FORM_ref_sup4 && form != DW_FORM_ref_sup8) {
+          info.ref = val;
+        }
+        break;
+      case DW_AT_low_pc:
+        low_pc = {form, val};
+        break;
+      case DW_AT_ranges:
+        has_ranges = true;
+        break;
+      case DW_AT_location:
+      case DW_AT_const_value:
+        has_location = true;
+        break;
+      case DW_AT_declaration:
+        is_declaration = val;
+        break;
+      case DW_AT_str_offsets_base:
+        str_offsets_base = val;
+        break;
+      case DW_AT_addr_base:
+        addr_base = val;
+        break;
+      }
+    }
+
+    if (name.first)
+      info.name = get_str(name.first, name.second);
+    if (linkage_name.first)
+      info.linkage_name = get_str(linkage_name.first, linkage_name.second);
+
+    // Decide whether or not to index this DIE.
+    bool is_indexed = false;
+    if (!is_declaration) {
+      switch (abbrev.tag) {
+      case DW_TAG_subprogram:
+      case DW_TAG_inlined_subroutine:
+        is_indexed = has_ranges ||
+                     (low_pc.first && is_live_addr(low_pc.first, low_pc.second));
+        break;
+      case DW_TAG_variable:
+        is_indexed = has_location &&
+          std::none_of(stack.begin(), stack.end(), [](u32 tag) {
+            return tag == DW_TAG_subprogram || tag == DW_TAG_lexical_block ||
+                   tag == DW_TAG_inlined_subroutine;
+          });
+        break;
+      default:
+        is_indexed = get_abbrev_code(abbrev.tag);
+      }
+    }
+
+    if (info.name != -1 || info.linkage_name != -1 || info.ref != -1) {
+      if (is_indexed)
+        candidates.push_back({infos.size(), get_abbrev_code(abbrev.tag)});
+      infos.push_back(info);
+    }
+
+    if (abbrev.has_children)
+      stack.push_back(abbrev.tag);
+  }
+
+  // Resolve DW_AT_specification and DW_AT_abstract_origin references.
+  // `infos` is sorted by DIE offset because we visited DIEs in order.
+  auto find = [&](i64 offset) -> DieInfo * {
+    auto it = std::lower_bound(infos.begin(), infos.end(), offset,
+                               [](const DieInfo &info, u64 offset) {
+      return info.offset < offset;
+    });
+    if (it == infos.end() || it->offset != offset)
+      return nullptr;
+    return &*it;
+  };
+
+  for (std::pair<u32, u32> cand : candidates) {
+    DieInfo info = infos[cand.first];
+    i64 ref = info.ref;
+
+    for (i64 i = 0; i < 4 && ref != -1; i++) {
+      if (info.name != -1 && info.linkage_name != -1)
+        break;
+
+      DieInfo *target = find(ref);
+      if (!target)
+        break;
+      if (info.name == -1)
+        info.name = target->name;
+      if (info.linkage_name == -1)
+        info.linkage_name = target->linkage_name;
+      ref = target->ref;
+    }
+
+    for (i64 off : {info.name, info.linkage_name}) {
+      if (off == -1 || ctx.debug_str.size() <= off)
+        continue;
+      if (off == info.linkage_name && off == info.name)
+        continue;
+
+      std::string_view str = (char *)&ctx.debug_str[off];
+      if (str.empty())
+        continue;
+      unit.names.push_back({(u64)off, hash_string(str),
+                            (u32)infos[cand.first].offset, cand.second});
+    }
+  }
+}
+
+// Returns a list of units in the output .debug_info. Only compile and
+// partial units are indexed.
+template <typename E>
+static std::vector<Unit> get_units(Context<E> &ctx) {
+  std::vector<Unit> units;
+  u8 *begin = &ctx.debug_info[0];
+  u8 *end = begin + ctx.debug_info.size();
+  i64 num_cus = 0;
+
+  for (u8 *p = begin; p < end;) {
+    Unit unit;
+    unit.offset = p - begin;
+
+    u8 *q = p;
+    u64 len = *(U32<E> *)q;
+    q += 4;
+
+    if (len == 0xffff'ffff) {
+      len = *(U64<E> *)q;
+      q += 8;
+      unit.offset_size = 8;
+    } else {
+      unit.offset_size = 4;
+    }
+
+    unit.size = q - p + len;
+    if (end < p + unit.size)
+      Fatal(ctx) << "--debug-names: corrupted .debug_info";
+    p += unit.size;
+
+    unit.version = *(U16<E> *)q;
+    q += 2;
+
+    if (unit.version < 2 || 5 < unit.version)
+      Fatal(ctx) << "--debug-names: DWARF version " << unit.version
+                 << " is not supported";
+
+    if (unit.version == 5) {
+      u8 unit_type = *q++;
+      unit.addr_size = *q++;
+      unit.abbrev_offset = read_offset<E>(q, unit.offset_size);
+      q += unit.offset_size;
+
+      // Type units and skeleton units are not indexed.
+      if (unit_type != DW_UT_compile && unit_type != DW_UT_partial)
+        continue;
+    } else {
+      unit.abbrev_offset = read_offset<E>(q, unit.offset_size);
+      q += unit.offset_size;
+      unit.addr_size = *q++;
+    }
+
+    unit.header_size = q - (begin + unit.offset);
+    unit.idx = num_cus++;
+    units.push_back(std::move(unit));
+  }
+  return units;
+}
+
+template <typename E>
+void write_debug_names(Context<E> &ctx) {
+  Timer t(ctx, "write_debug_names");
+
+  // Find debug info sections
+  ctx.debug_info = {};
+  ctx.debug_abbrev = {};
+  ctx.debug_addr = {};
+  ctx.debug_str = {};
+  ctx.debug_str_offsets = {};
+
+  for (Chunk<E> *chunk : ctx.chunks) {
+    std::string_view name = chunk->name;
+    if (name == ".debug_info")
+      ctx.debug_info = get_buffer(ctx, chunk);
+    if (name == ".debug_abbrev")
+      ctx.debug_abbrev = get_buffer(ctx, chunk);
+    if (name == ".debug_addr")
+      ctx.debug_addr = get_buffer(ctx, chunk);
+    if (name == ".debug_str")
+      ctx.debug_str = get_buffer(ctx, chunk);
+    if (name == ".debug_str_offsets")
+      ctx.debug_str_offsets = get_buffer(ctx, chunk);
+  }
+
+  if (ctx.debug_info.empty())
+    return;
+
+  // Read debug info
+  std::vector<Unit> units = get_units(ctx);
+
+  tbb::parallel_for_each(units, [&](Unit &unit) {
+    read_unit(ctx, unit);
+  });
+
+  // Uniquify names
+  HyperLogLog estimator;
+
+  tbb::parallel_for_each(units, [&](Unit &unit) {
+    HyperLogLog e;
+    for (NameEntry &ent : unit.names)
+      e.insert(ent.hash);
+    estimator.merge(e);
+  });
+
+  ConcurrentMap<MapValue> map(estimator.get_cardinality() * 3 / 2);
+
+  tbb::parallel_for_each(units, [&](Unit &unit) {
+    unit.entries.reserve(unit.names.size());
+    for (NameEntry &ent : unit.names) {
+      std::string_view name = (char *)&ctx.debug_str[ent.str_offset];
+      MapValue *val = map.insert(name, ent.hash, {djb_hash(name)}).first;
+      val->count++;
+      update_minimum(val->str_offset, ent.str_offset);
+      unit.entries.push_back(val);
+    }
+  });
+
+  // Names in the same hash bucket have to be contiguous. We also sort
+  // names by hash value and name for build reproducibility.
+  using Entry = typename decltype(map)::Entry;
+  std::vector<Entry *> entries = map.get_sorted_entries_all();
+
+  i64 num_names = entries.size();
+  i64 num_buckets = num_names;
+  if (num_names > 1024)
+    num_buckets = num_names / 4;
+  else if (num_names > 16)
+    num_buckets = num_names / 2;
+  num_buckets = std::max<i64>(num_buckets, 1);
+
+  tbb::parallel_sort(entries, [&](Entry *a, Entry *b) {
+    u32 x = a->value.djb_hash;
+    u32 y = b->value.djb_hash;
+    return std::tuple(x % num_buckets, x, std::string_view(a->key, a->keylen)) <
+           std::tuple(y % num_buckets, y, std::string_view(b->key, b->keylen));
+  });
+
+  // Use the 64-bit DWARF format only if necessary.
+  i64 num_cus = units.empty() ? 0 : units.back().idx + 1;
+  bool is_64 = ctx.debug_info.size() > UINT32_MAX ||
+               ctx.debug_str.size() > UINT32_MAX;
+  i64 offset_size = is_64 ? 8 : 4;
+
+  u64 cu_form = DW_FORM_data4;
+  i64 cu_size = 4;
+  if (num_cus <= UINT8_MAX + 1) {
+    cu_form = DW_FORM_data1;
+    cu_size = 1;
+  } else if (num_cus <= UINT16_MAX + 1) {
+    cu_form = DW_FORM_data2;
+    cu_size = 2;
+  }
+
+  // Create an abbreviation table. Each entry in the entry pool consists
+  // of an abbreviation code, a CU index and a CU-relative DIE offset.
+  std::vector<u8> abbrev_table;
+  for (i64 i = 0; i < std::size(indexed_tags); i++) {
+    for (u64 val : {(u64)i + 1, (u64)indexed_tags[i],
+                    (u64)DW_IDX_compile_unit, cu_form,
+                    (u64)DW_IDX_die_offset, (u64)DW_FORM_ref4, (u64)0, (u64)0}) {
+      u8 buf[10];
+      abbrev_table.insert(abbrev_table.end(), buf, buf + write_uleb(buf, val));
+    }
+  }
+  abbrev_table.push_back(0);
+
+  i64 record_size = 1 + cu_size + 4;
+
+  // Compute the location of each name's entries in the entry pool.
+  i64 num_records = 0;
+  i64 pool_size = 0;
+
+  for (Entry *ent : entries) {
+    ent->value.record_idx = num_records;
+    ent->value.entry_offset = pool_size;
+    num_records += ent->value.count;
+    pool_size += ent->value.count * record_size + 1;
+  }
+
+  // Compute sizes of each components
+  i64 hdr_size = (is_64 ? 12 : 4) + 32;
+  i64 cu_list_offset = hdr_size;
+  i64 buckets_offset = cu_list_offset + num_cus * offset_size;
+  i64 hashes_offset = buckets_offset + num_buckets * 4;
+  i64 str_offsets_offset = hashes_offset + num_names * 4;
+  i64 entry_offsets_offset = str_offsets_offset + num_names * offset_size;
+  i64 abbrev_offset = entry_offsets_offset + num_names * offset_size;
+  i64 pool_offset = abbrev_offset + abbrev_table.size();
+  i64 size = pool_offset + pool_size;
+
+  // Allocate an output buffer. This section follows .gdb_index if exists.
+  std::vector<u8> &buf2 = ctx.output_file->buf2;
+  i64 start = align_to(ctx.output_file->filesize + buf2.size(), 4) -
+              ctx.output_file->filesize;
+  buf2.resize(start + size);
+  u8 *buf = buf2.data() + start;
+
+  auto write_offset = [&](u8 *p, u64 val) {
+    if (is_64)
+      *(U64<E> *)p = val;
+    else
+      *(U32<E> *)p = val;
+  };
+
+  // Write a section header
+  u8 *p = buf;
+  if (is_64) {
+    *(U32<E> *)p = 0xffff'ffff;
+    *(U64<E> *)(p + 4) = size - 12;
+    p += 12;
+  } else {
+    *(U32<E> *)p = size - 4;
+    p += 4;
+  }
+
+  *(U16<E> *)p = 5;                         // version
+  *(U16<E> *)(p + 2) = 0;                   // padding
+  *(U32<E> *)(p + 4) = num_cus;             // comp_unit_count
+  *(U32<E> *)(p + 8) = 0;                   // local_type_unit_count
+  *(U32<E> *)(p + 12) = 0;                  // foreign_type_unit_count
+  *(U32<E> *)(p + 16) = num_buckets;        // bucket_count
+  *(U32<E> *)(p + 20) = num_names;          // name_count
+  *(U32<E> *)(p + 24) = abbrev_table.size(); // abbrev_table_size
+  *(U32<E> *)(p + 28) = 0;                  // augmentation_string_size
+
+  // Write a CU list
+  for (Unit &unit : units)
+    write_offset(buf + cu_list_offset + unit.idx * offset_size, unit.offset);
+
+  // Write a hash table
+  U32<E> *buckets = (U32<E> *)(buf + buckets_offset);
+  memset(buckets, 0, num_buckets * 4);
+
+  for (i64 i = num_names - 1; i >= 0; i--)
+    buckets[entries[i]->value.djb_hash % num_buckets] = i + 1;
+
+  tbb::parallel_for((i64)0, num_names, [&](i64 i) {
+    MapValue &val = entries[i]->value;
+    *(U32<E> *)(buf + hashes_offset + i * 4) = val.djb_hash;
+    write_offset(buf + str_offsets_offset + i * offset_size, val.str_offset);
+    write_offset(buf + entry_offsets_offset + i * offset_size, val.entry_offset);
+  });
+
+  // Write an abbreviation table
+  memcpy(buf + abbrev_offset, abbrev_table.data(), abbrev_table.size());
+
+  // Write an entry pool. We first collect entries for each name and
+  // sort them so that the output is deterministic.
+  std::vector<Record> records(num_records);
+
+  tbb::parallel_for_each(units, [&](Unit &unit) {
+    for (i64 i = 0; i < unit.names.size(); i++) {
+      MapValue *val = unit.entries[i];
+      records[val->record_idx + val->cursor++] =
+        {(u32)unit.idx, unit.names[i].die_offset, unit.names[i].abbrev_code};
+    }
+  });
+
+  tbb::parallel_for_each(entries, [&](Entry *ent) {
+    MapValue &val = ent->value;
+    Record *begin = records.data() + val.record_idx;
+    std::sort(begin, begin + val.count);
+
+    u8 *p = buf + pool_offset + val.entry_offset;
+    for (Record *rec = begin; rec < begin + val.count; rec++) {
+      *p++ = rec->abbrev_code;
+      if (cu_size == 1)
+        *p = rec->cu_idx;
+      else if (cu_size == 2)
+        *(U16<E> *)p = rec->cu_idx;
+      else
+        *(U32<E> *)p = rec->cu_idx;
+      p += cu_size;
+      *(U32<E> *)p = rec->die_offset;
+      p += 4;
+    }
+    *p = 0;
+  });
+
+  // Update the section size and rewrite the section header
+  if (ctx.shdr) {
+    ctx.debug_names->shdr.sh_offset = ctx.output_file->filesize + start;
+    ctx.debug_names->shdr.sh_size = size;
+    ctx.shdr->copy_buf(ctx);
+  }
+}
+
+using E = MOLD_TARGET;
+
+template void write_debug_names(Context<E> &);
+
+} // namespace mold
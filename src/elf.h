@@ -83,6 +83,7 @@ enum : u32 {
   SHT_RELR = 19,
   SHT_LOOS = 0x60000000,
   SHT_LLVM_ADDRSIG = 0x6fff4c03,
+  SHT_LLVM_CALL_GRAPH_PROFILE = 0x6fff4c09,
   SHT_GNU_HASH = 0x6ffffff6,
   SHT_GNU_VERDEF = 0x6ffffffd,
   SHT_GNU_VERNEED = 0x6ffffffe,
@@ -1403,16 +1404,38 @@ enum : u32 {
 };
 
 enum : u32 {
+  DW_AT_location = 0x02,
+  DW_AT_name = 0x03,
   DW_AT_low_pc = 0x11,
   DW_AT_high_pc = 0x12,
+  DW_AT_const_value = 0x1c,
   DW_AT_producer = 0x25,
+  DW_AT_abstract_origin = 0x31,
+  DW_AT_declaration = 0x3c,
+  DW_AT_specification = 0x47,
   DW_AT_ranges = 0x55,
+  DW_AT_linkage_name = 0x6e,
+  DW_AT_str_offsets_base = 0x72,
   DW_AT_addr_base = 0x73,
   DW_AT_rnglists_base = 0x74,
+  DW_AT_MIPS_linkage_name = 0x2007,
 };
 
 enum : u32 {
+  DW_TAG_class_type = 0x02,
+  DW_TAG_enumeration_type = 0x04,
+  DW_TAG_lexical_block = 0x0b,
   DW_TAG_compile_unit = 0x11,
+  DW_TAG_structure_type = 0x13,
+  DW_TAG_typedef = 0x16,
+  DW_TAG_union_type = 0x17,
+  DW_TAG_inlined_subroutine = 0x1d,
+  DW_TAG_base_type = 0x24,
+  DW_TAG_subprogram = 0x2e,
+  DW_TAG_variable = 0x34,
+  DW_TAG_namespace = 0x39,
+  DW_TAG_unspecified_type = 0x3b,
+  DW_TAG_partial_unit = 0x3c,
   DW_TAG_skeleton_unit = 0x4a,
 };
 
@@ -1467,6 +1490,15 @@ enum : u32 {
   DW_FORM_addrx2 = 0x2a,
   DW_FORM_addrx3 = 0x2b,
   DW_FORM_addrx4 = 0x2c,
+  DW_FORM_GNU_addr_index = 0x1f01,
+  DW_FORM_GNU_str_index = 0x1f02,
+  DW_FORM_GNU_ref_alt = 0x1f20,
+  DW_FORM_GNU_strp_alt = 0x1f21,
+};
+
+enum : u32 {
+  DW_IDX_compile_unit = 0x01,
+  DW_IDX_die_offset = 0x03,
 };
 
 enum : u32 {
@@ -1480,6 +1512,14 @@ enum : u32 {
   DW_RLE_start_length = 0x07,
 };
 
+enum : u32 {
+  DW_LNS_fixed_advance_pc = 0x09,
+};
+
+enum : u32 {
+  DW_LNE_end_sequence = 0x01,
+};
+
 //
 // ELF types
 //
@@ -0,0 +1,292 @@
+// This file implements --gc-debug-info.
+//
+// If a function is removed by --gc-sections or de-duplicated as a
+// COMDAT member, its debug info records remain in the output file, and
+// we merely write tombstone values to the relocated fields that refer
+// to the removed function (see InputSection::get_tombstone). For
+// programs compiled with -ffunction-sections, a large portion of debug
+// info may describe code that doesn't exist in the output file.
+//
+// With --gc-debug-info, we remove such records instead. We handle the
+// following two cases, each of which can be done without rewriting
+// .debug_info.
+//
+// 1. If no section of an object file survived, all DWARF compilation
+//    units in the file describe nothing, so we remove all debug
+//    sections of the file.
+//
+// 2. A .debug_line section consists of one or more line number
+//    programs, and each program consists of sequences, each of which
+//    describes a contiguous range of machine code and starts with a
+//    DW_LNE_set_address relocated against the function it describes.
+//    A sequence for a removed function can be removed from the program
+//    without affecting other sequences.
+//
+// .debug_ranges, .debug_rnglists, .debug_loc and .debug_loclists
+// entries are referred to by offsets from .debug_info, so we leave them
+// tombstoned unless the entire compilation unit is removed.
+//
+// Line number programs for functions removed by ICF are kept, just
+// like we don't write tombstones to them, so that users can still set
+// breakpoints in them.
+
+#include "mold.h"
+
+#include <tbb/parallel_for_each.h>
+
+namespace mold {
+
+// Returns true if a relocation refers to a function that doesn't exist
+// in the output file.
+template <typename E>
+static bool refers_dead_section(ObjectFile<E> &file, const ElfRel<E> &rel) {
+  Symbol<E> &sym = *file.symbols[rel.r_sym];
+  if (sym.get_frag())
+    return false;
+
+  InputSection<E> *isec = sym.get_input_section();
+  return isec && !isec->is_alive && !isec->icf_removed();
+}
+
+// Returns true if an object file has debug info but no section that
+// the debug info can describe.
+template <typename E>
+static bool is_dead_compunit(ObjectFile<E> &file) {
+  bool has_debug = false;
+
+  for (std::unique_ptr<InputSection<E>> &isec : file.sections) {
+    if (!isec)
+      continue;
+
+    const ElfShdr<E> &shdr = isec->shdr();
+    if (!(shdr.sh_flags & SHF_ALLOC)) {
+      if (isec->name().starts_with(".debug"))
+        has_debug = true;
+      continue;
+    }
+
+    // Sections merged by ICF are still described by the debug info.
+    if ((isec->is_alive || isec->icf_removed()) &&
+        shdr.sh_type != SHT_NOTE && isec->name() != ".eh_frame")
+      return false;
+  }
+  return has_debug;
+}
+
+// Type units in COMDAT groups may be referred to by other files'
+// compilation units, so we keep them.
+template <typename E>
+static void remove_compunit(ObjectFile<E> &file) {
+  for (std::unique_ptr<InputSection<E>> &isec : file.sections)
+    if (isec && !(isec->shdr().sh_flags & (SHF_ALLOC | SHF_GROUP)) &&
+        isec->name().starts_with(".debug"))
+      isec->kill();
+
+  file.debug_info = nullptr;
+  file.debug_pubnames = nullptr;
+  file.debug_pubtypes = nullptr;
+}
+
+// Finds sequences in a line number program starting at `begin` and
+// ending at `end`, and returns their start offsets. The last element is
+// the end of the last sequence. Returns an empty vector if the program
+// can't be parsed.
+template <typename E>
+static std::vector<i64>
+get_line_sequences(std::string_view contents, i64 begin, i64 end,
+                   i64 &program_offset) {
+  u8 *base = (u8 *)contents.data();
+  u8 *p = base + begin;
+
+  i64 dwarf64 = (*(U32<E> *)p == 0xffff'ffff);
+  p += dwarf64 ? 12 : 4;
+
+  i64 version = *(U16<E> *)p;
+  if (version < 2 || 5 < version)
+    return {};
+  p += 2;
+
+  if (version == 5)
+    p += 2; // address_size and segment_selector_size
+
+  i64 header_length = dwarf64 ? *(U64<E> *)p : *(U32<E> *)p;
+  p += dwarf64 ? 8 : 4;
+
+  u8 *program = p + header_length;
+  if (base + end < program)
+    return {};
+
+  p++; // minimum_instruction_length
+  if (version >= 4)
+    p++; // maximum_operations_per_instruction
+  p++; // default_is_stmt
+  p++; // line_base
+  p++; // line_range
+
+  i64 opcode_base = *p++;
+  if (opcode_base == 0)
+    return {};
+  u8 *opcode_lengths = p;
+
+  std::vector<i64> vec;
+  vec.push_back(program - base);
+  program_offset = program - base;
+
+  p = program;
+  while (p < base + end) {
+    u8 op = *p++;
+
+    if (op == 0) {
+      // Extended opcode
+      u64 len = read_uleb(&p);
+      if (len == 0 || base + end < p + len)
+        return {};
+      u8 sub = *p;
+      p += len;
+      if (sub == DW_LNE_end_sequence)
+        vec.push_back(p - base);
+    } else if (op == DW_LNS_fixed_advance_pc) {
+      p += 2;
+    } else if (op < opcode_base) {
+      for (i64 i = 0; i < opcode_lengths[op - 1]; i++)
+        read_uleb(&p);
+    }
+  }
+
+  if (p != base + end)
+    return {};
+
+  // Bytes after the last DW_LNE_end_sequence, if any, are kept as
+  // if they were a sequence.
+  if (vec.back() != end)
+    vec.push_back(end);
+  return vec;
+}
+
+// Removes sequences for dead functions from a .debug_line section.
+// We do this only if the section contains a single line number program
+// because .debug_info refers to programs by their offsets.
+template <typename E>
+static void prune_debug_line(Context<E> &ctx, InputSection<E> &isec) {
+  isec.uncompress(ctx);
+
+  std::string_view contents = isec.contents;
+  std::span<ElfRel<E>> rels = isec.get_rels(ctx);
+  if (contents.size() < 4 || rels.empty())
+    return;
+
+  i64 dwarf64 = (*(U32<E> *)contents.data() == 0xffff'ffff);
+  i64 hdr_size = dwarf64 ? 12 : 4;
+  if (contents.size() < hdr_size + 4)
+    return;
+
+  u64 unit_length = dwarf64 ? *(U64<E> *)(contents.data() + 4)
+                            : *(U32<E> *)contents.data();
+  if (unit_length + hdr_size != contents.size())
+    return;
+
+  for (i64 i = 1; i < rels.size(); i++)
+    if (rels[i - 1].r_offset > rels[i].r_offset)
+      return;
+
+  i64 program_offset;
+  std::vector<i64> seqs =
+    get_line_sequences<E>(contents, 0, contents.size(), program_offset);
+  if (seqs.size() < 2)
+    return;
+
+  // Relocations before the program refer to strings and such.
+  auto it = std::partition_point(rels.begin(), rels.end(), [&](ElfRel<E> &r) {
+    return r.r_offset < program_offset;
+  });
+
+  // Determine which sequences are dead.
+  std::vector<bool> is_dead(seqs.size() - 1);
+  bool has_dead = false;
+
+  for (i64 i = 0; i < seqs.size() - 1; i++) {
+    for (; it != rels.end() && it->r_offset < seqs[i + 1]; it++) {
+      if (refers_dead_section(isec.file, *it)) {
+        is_dead[i] = true;
+        has_dead = true;
+      }
+    }
+  }
+
+  if (!has_dead)
+    return;
+
+  // Copy live sequences and relocations.
+  u8 *buf = new u8[contents.size()];
+  ctx.string_pool.emplace_back(buf);
+  memcpy(buf, contents.data(), seqs[0]);
+
+  i64 size = seqs[0];
+  i64 num_rels = 0;
+  it = rels.begin();
+
+  for (; it != rels.end() && it->r_offset < seqs[0]; it++)
+    rels[num_rels++] = *it;
+
+  for (i64 i = 0; i < seqs.size() - 1; i++) {
+    i64 delta = seqs[i] - size;
+
+    if (is_dead[i]) {
+      for (; it != rels.end() && it->r_offset < seqs[i + 1]; it++);
+      continue;
+    }
+
+    memcpy(buf + size, contents.data() + seqs[i], seqs[i + 1] - seqs[i]);
+    size += seqs[i + 1] - seqs[i];
+
+    for (; it != rels.end() && it->r_offset < seqs[i + 1]; it++) {
+      ElfRel<E> r = *it;
+      r.r_offset = r.r_offset - delta;
+      rels[num_rels++] = r;
+    }
+  }
+
+  if (dwarf64)
+    *(U64<E> *)(buf + 4) = size - hdr_size;
+  else
+    *(U32<E> *)buf = size - hdr_size;
+
+  // Input files are mapped privately, so we can shrink the relocation
+  // section in place.
+  isec.file.elf_sections[isec.relsec_idx].sh_size =
+    num_rels * sizeof(ElfRel<E>);
+
+  static Counter removed("gc_debug_info_line_bytes");
+  removed += contents.size() - size;
+
+  isec.contents = {(char *)buf, (size_t)size};
+  isec.sh_size = size;
+}
+
+template <typename E>
+void gc_debug_info(Context<E> &ctx) {
+  Timer t(ctx, "gc_debug_info");
+
+  tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
+    if (!file->is_alive)
+      return;
+
+    if (is_dead_compunit(*file)) {
+      static Counter counter("gc_debug_info_compunits");
+      counter++;
+      remove_compunit(*file);
+      return;
+    }
+
+    for (std::unique_ptr<InputSection<E>> &isec : file->sections)
+      if (isec && isec->is_alive && isec->name() == ".debug_line" &&
+          isec->relsec_idx != -1)
+        prune_debug_line(ctx, *isec);
+  });
+}
+
+using E = MOLD_TARGET;
+
+template void gc_debug_info(Context<E> &);
+
+} // namespace mold
@@ -17,10 +17,14 @@
 //
 // Post-relocated debug section contents are needed to create a
 // .gdb_index. Therefore, we create it after relocating all the other
-// sections. The size of the section is also hard to estimate before
-// applying relocations to debug info sections, so a .gdb_index is
-// placed at the very end of the output file, even after the section
-// header.
+// sections. However, names don't need relocation, so we read them and
+// compute the sizes of the symbol table and the constant pool before
+// fixing the file layout. The number of address ranges can't be
+// computed without relocation, so we reserve space for an upper bound
+// of it. The section is written in place to the output file after
+// relocation. It is placed at the very end of the output file, even
+// after the section header, so that the file can be truncated if the
+// reserved space turns out to be larger than needed.
 //
 // The mapping from names to compunits is 1:n while the mapping from
 // address ranges to compunits is 1:1. That is, two object files may
@@ -57,7 +61,9 @@
 // https://sourceware.org/gdb/onlinedocs/gdb/Index-Section-Format.html
 
 #include "mold.h"
+#include <tbb/parallel_for.h>
 #include <tbb/parallel_for_each.h>
+#include <tbb/parallel_scan.h>
 #include <tbb/parallel_sort.h>
 
 namespace mold {
@@ -126,33 +132,11 @@ struct SectionHeader {
   ul32 const_pool_offset = 0;
 };
 
-struct NameType {
-  bool operator==(const NameType &) const = default;
-
-  bool operator<(const NameType &other) const {
-    return std::tuple(hash, type, name) <
-           std::tuple(other.hash, other.type, other.name);
-  }
-
-  std::string_view name;
-  u64 hash;
-  u8 type;
-};
-
-struct MapValue {
-  u32 gdb_hash = 0;
-  Atomic<u32> count;
-  u32 name_offset = 0;
-  u32 type_offset = 0;
-};
-
 struct Compunit {
   DwarfKind kind;
   i64 offset;
   i64 size;
   std::vector<std::pair<u64, u64>> ranges;
-  std::vector<NameType> nametypes;
-  std::vector<MapValue *> entries;
 };
 
 // The hash function for .gdb_index.
@@ -515,18 +499,23 @@ read_address_ranges(Context<E> &ctx, const Compunit &cu) {
 }
 
 template <typename E, typename PubnamesHdr>
-static i64 read_pubnames_cu(Context<E> &ctx, const PubnamesHdr &hdr,
-                            std::vector<Compunit> &cus, ObjectFile<E> &file) {
+static i64
+read_pubnames_cu(Context<E> &ctx, const PubnamesHdr &hdr,
+                 std::vector<typename GdbIndexSection<E>::Pubnames> &vec,
+                 ObjectFile<E> &file) {
   using Offset = decltype(hdr.size);
 
-  auto get_cu = [&](i64 offset) {
-    for (i64 i = 0; i < cus.size(); i++)
-      if (cus[i].offset == offset)
-        return &cus[i];
-    Fatal(ctx) << file << ": corrupted debug_info_offset";
+  auto get_pubnames = [&](u64 offset) {
+    for (typename GdbIndexSection<E>::Pubnames &pub : vec)
+      if (pub.debug_info_offset == offset)
+        return &pub;
+    vec.push_back({&file, offset});
+    return &vec.back();
   };
 
-  Compunit *cu = get_cu(file.debug_info->offset + hdr.debug_info_offset);
+  typename GdbIndexSection<E>::Pubnames *pub =
+    get_pubnames(hdr.debug_info_offset);
+
   i64 size = hdr.size + offsetof(PubnamesHdr, size) + sizeof(hdr.size);
   u8 *p = (u8 *)&hdr + sizeof(hdr);
   u8 *end = (u8 *)&hdr + size;
@@ -539,7 +528,7 @@ static i64 read_pubnames_cu(Context<E> &ctx, const PubnamesHdr &hdr,
     u8 type = *p++;
     std::string_view name = (char *)p;
     p += name.size() + 1;
-    cu->nametypes.push_back({name, hash_string(name), type});
+    pub->nametypes.push_back({name, hash_string(name), type});
   }
 
   return size;
@@ -554,8 +543,10 @@ static i64 read_pubnames_cu(Context<E> &ctx, const PubnamesHdr &hdr,
 // (e.g. function, variable or datatype). The string is a name of a
 // function, a variable or a type.
 template <typename E>
-static void read_pubnames(Context<E> &ctx, std::vector<Compunit> &cus,
-                          ObjectFile<E> &file) {
+static std::vector<typename GdbIndexSection<E>::Pubnames>
+read_pubnames(Context<E> &ctx, ObjectFile<E> &file) {
+  std::vector<typename GdbIndexSection<E>::Pubnames> vec;
+
   for (InputSection<E> *isec : { file.debug_pubnames, file.debug_pubtypes }) {
     if (!isec)
       continue;
@@ -569,11 +560,182 @@ static void read_pubnames(Context<E> &ctx, std::vector<Compunit> &cus,
 
     while (p < end) {
       if (*(U32<E> *)p == 0xffff'ffff)
-        p += read_pubnames_cu(ctx, *(PubnamesHdr64<E> *)p, cus, file);
+        p += read_pubnames_cu(ctx, *(PubnamesHdr64<E> *)p, vec, file);
       else
-        p += read_pubnames_cu(ctx, *(PubnamesHdr32<E> *)p, cus, file);
+        p += read_pubnames_cu(ctx, *(PubnamesHdr32<E> *)p, vec, file);
+    }
+  }
+  return vec;
+}
+
+// Returns the size of a compunit at a given location.
+template <typename E>
+static i64 get_compunit_size(Context<E> &ctx, u8 *p) {
+  DwarfKind kind = get_dwarf_kind(ctx, p);
+  if (kind == DWARF2_32 || kind == DWARF5_32)
+    return ((CuHdrDwarf2_32<E> *)p)->size + 4;
+  return ((CuHdrDwarf2_64<E> *)p)->size + 12;
+}
+
+template <typename E>
+static OutputSection<E> *find_debug_info(Context<E> &ctx) {
+  for (std::vector<Chunk<E> *> *vec : { &ctx.chunks, &ctx.debug_chunks })
+    for (Chunk<E> *chunk : *vec)
+      if (chunk->name == ".debug_info")
+        if (OutputSection<E> *osec = chunk->to_osec())
+          return osec;
+  return nullptr;
+}
+
+// Reads names from input files and computes the sizes of the symbol
+// table and the constant pool. Also computes the number of compunits
+// and an upper bound of the number of address ranges, so that we can
+// reserve space for the section before fixing the file layout.
+template <typename E>
+void GdbIndexSection<E>::construct(Context<E> &ctx) {
+  Timer t(ctx, "construct_gdb_index");
+
+  // Count compunits in each file. An input .debug_info usually
+  // contains one compunit, but it may contain more than one if it's
+  // created by LTO or `ld -r`.
+  std::unordered_map<ObjectFile<E> *, i64> cus_per_file;
+
+  if (OutputSection<E> *osec = find_debug_info(ctx)) {
+    std::vector<i64> counts(osec->members.size());
+
+    tbb::parallel_for((i64)0, (i64)osec->members.size(), [&](i64 i) {
+      InputSection<E> &isec = *osec->members[i];
+      isec.uncompress(ctx);
+      u8 *begin = (u8 *)isec.contents.data();
+      u8 *end = begin + isec.contents.size();
+      for (u8 *p = begin; p < end; p += get_compunit_size(ctx, p))
+        counts[i]++;
+    });
+
+    for (i64 i = 0; i < osec->members.size(); i++) {
+      num_cus += counts[i];
+      cus_per_file[&osec->members[i]->file] += counts[i];
+    }
+  }
+
+  // A compunit typically has one address range for each executable
+  // section. If an object file contains more than one compunit,
+  // sections may be shared by compunits, and a compunit may have as
+  // many ranges as the number of functions in the worst case. If the
+  // actual number of ranges exceeds the estimate, write_gdb_index()
+  // falls back to appending the section to the end of the file.
+  std::vector<i64> ranges(ctx.objs.size());
+
+  tbb::parallel_for((i64)0, (i64)ctx.objs.size(), [&](i64 i) {
+    ObjectFile<E> *file = ctx.objs[i];
+    auto it = cus_per_file.find(file);
+    if (it == cus_per_file.end())
+      return;
+
+    for (std::unique_ptr<InputSection<E>> &isec : file->sections)
+      if (isec && (isec->shdr().sh_flags & SHF_EXECINSTR) &&
+          (isec->is_alive || isec->icf_removed()))
+        ranges[i]++;
+
+    if (it->second > 1)
+      for (const ElfSym<E> &esym : file->elf_syms)
+        if (esym.st_type == STT_FUNC && !esym.is_undef())
+          ranges[i]++;
+  });
+
+  for (i64 n : ranges)
+    max_ranges += n;
+
+  // Read symbols from .debug_gnu_pubnames and .debug_gnu_pubtypes.
+  std::vector<std::vector<Pubnames>> vec(ctx.objs.size());
+
+  tbb::parallel_for((i64)0, (i64)ctx.objs.size(), [&](i64 i) {
+    if (ctx.objs[i]->debug_info)
+      vec[i] = read_pubnames(ctx, *ctx.objs[i]);
+  });
+
+  for (std::vector<Pubnames> &v : vec)
+    append(pubnames, std::move(v));
+
+  // Uniquify elements because GCC 11 seems to emit one record for each
+  // comdat group which results in having a lot of duplicate records.
+  tbb::parallel_for_each(pubnames, [&](Pubnames &pub) {
+    sort(pub.nametypes);
+    remove_duplicates(pub.nametypes);
+  });
+
+  // Uniquify symbols
+  HyperLogLog estimator;
+
+  tbb::parallel_for_each(pubnames, [&](Pubnames &pub) {
+    HyperLogLog e;
+    for (NameType &nt : pub.nametypes)
+      e.insert(nt.hash);
+    estimator.merge(e);
+  });
+
+  map.resize(estimator.get_cardinality() * 3 / 2);
+
+  tbb::parallel_for_each(pubnames, [&](Pubnames &pub) {
+    pub.entries.reserve(pub.nametypes.size());
+    for (NameType &nt : pub.nametypes) {
+      MapValue *ent;
+      bool inserted;
+      std::tie(ent, inserted) = map.insert(nt.name, nt.hash,
+                                           MapValue{gdb_hash(nt.name)});
+      ent->count++;
+      pub.entries.push_back(ent);
     }
+  });
+
+  // Sort symbols for build reproducibility
+  entries = map.get_sorted_entries_all();
+
+  // Assign offsets in the constant pool. The pool consists of CU
+  // vectors followed by names.
+  auto scan_types = [&](const tbb::blocked_range<i64> &r, i64 sum,
+                        bool is_final) {
+    for (i64 i = r.begin(); i < r.end(); i++) {
+      if (is_final)
+        entries[i]->value.type_offset = sum;
+      sum += entries[i]->value.count * 4 + 4;
+    }
+    return sum;
   };
+
+  i64 types_size = tbb::parallel_scan(
+    tbb::blocked_range<i64>(0, entries.size()), (i64)0, scan_types,
+    std::plus());
+
+  auto scan_names = [&](const tbb::blocked_range<i64> &r, i64 sum,
+                        bool is_final) {
+    for (i64 i = r.begin(); i < r.end(); i++) {
+      if (is_final)
+        entries[i]->value.name_offset = sum;
+      sum += entries[i]->keylen + 1;
+    }
+    return sum;
+  };
+
+  const_pool_size = tbb::parallel_scan(
+    tbb::blocked_range<i64>(0, entries.size()), types_size, scan_names,
+    std::plus());
+
+  symtab_size = bit_ceil(entries.size() * 5 / 4 + 1) * 8;
+}
+
+template <typename E>
+void GdbIndexSection<E>::update_shdr(Context<E> &ctx) {
+  this->shdr.sh_size = sizeof(SectionHeader) + num_cus * 16 +
+                       max_ranges * 20 + symtab_size + const_pool_size;
+}
+
+// The contents are written by write_gdb_index() after other sections
+// are relocated. We zero-clear the reserved space here so that the
+// output, including the build-id, is deterministic.
+template <typename E>
+void GdbIndexSection<E>::copy_buf(Context<E> &ctx) {
+  memset(ctx.buf + this->shdr.sh_offset, 0, this->shdr.sh_size);
 }
 
 template <typename E>
@@ -585,14 +747,8 @@ static std::vector<Compunit> read_compunits(Context<E> &ctx) {
   u8 *end = begin + ctx.debug_info.size();
 
   for (u8 *p = begin; p < end;) {
-    DwarfKind kind = get_dwarf_kind(ctx, p);
-    i64 size;
-    if (kind == DWARF2_32 || kind == DWARF5_32)
-      size = ((CuHdrDwarf2_32<E> *)p)->size + 4;
-    else
-      size = ((CuHdrDwarf2_64<E> *)p)->size + 12;
-
-    cus.push_back(Compunit{kind, p - begin, size});
+    i64 size = get_compunit_size(ctx, p);
+    cus.push_back(Compunit{get_dwarf_kind(ctx, p), p - begin, size});
     p += size;
   }
 
@@ -619,18 +775,6 @@ static std::vector<Compunit> read_compunits(Context<E> &ctx) {
     });
   });
 
-  // Read symbols from .debug_gnu_pubnames and .debug_gnu_pubtypes.
-  tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
-    read_pubnames(ctx, cus, *file);
-  });
-
-  // Uniquify elements because GCC 11 seems to emit one record for each
-  // comdat group which results in having a lot of duplicate records.
-  tbb::parallel_for_each(cus, [&](Compunit &cu) {
-    sort(cu.nametypes);
-    remove_duplicates(cu.nametypes);
-  });
-
   return cus;
 }
 
@@ -644,6 +788,7 @@ std::span<u8> get_buffer(Context<E> &ctx, Chunk<E> *chunk) {
 template <typename E>
 void write_gdb_index(Context<E> &ctx) {
   Timer t(ctx, "write_gdb_index");
+  GdbIndexSection<E> &sec = *ctx.gdb_index;
 
   // Find debug info sections
   for (Chunk<E> *chunk : ctx.chunks) {
@@ -666,91 +811,82 @@ void write_gdb_index(Context<E> &ctx) {
   // Read debug info
   std::vector<Compunit> cus = read_compunits(ctx);
 
-  // Uniquify symbols
-  HyperLogLog estimator;
+  // Find a compunit for each set of names.
+  std::vector<i64> cu_indices(sec.pubnames.size());
 
-  tbb::parallel_for_each(cus, [&](Compunit &cu) {
-    HyperLogLog e;
-    for (NameType &nt : cu.nametypes)
-      e.insert(nt.hash);
-    estimator.merge(e);
-  });
+  tbb::parallel_for((i64)0, (i64)sec.pubnames.size(), [&](i64 i) {
+    typename GdbIndexSection<E>::Pubnames &pub = sec.pubnames[i];
+    i64 offset = pub.file->debug_info->offset + pub.debug_info_offset;
 
-  ConcurrentMap<MapValue> map(estimator.get_cardinality() * 3 / 2);
+    auto it = std::lower_bound(cus.begin(), cus.end(), offset,
+                               [](const Compunit &cu, i64 offset) {
+      return cu.offset < offset;
+    });
 
-  tbb::parallel_for_each(cus, [&](Compunit &cu) {
-    cu.entries.reserve(cu.nametypes.size());
-    for (NameType &nt : cu.nametypes) {
-      MapValue *ent;
-      bool inserted;
-      std::tie(ent, inserted) = map.insert(nt.name, nt.hash,
-                                           MapValue{gdb_hash(nt.name)});
-      ent->count++;
-      cu.entries.push_back(ent);
-    }
+    if (it == cus.end() || it->offset != offset)
+      Fatal(ctx) << *pub.file << ": corrupted debug_info_offset";
+    cu_indices[i] = it - cus.begin();
   });
 
-  // Sort symbols for build reproducibility
-  using Entry = typename decltype(map)::Entry;
-  std::vector<Entry *> entries = map.get_sorted_entries_all();
-
   // Compute sizes of each components
+  std::vector<i64> range_offsets(cus.size() + 1);
+  for (i64 i = 0; i < cus.size(); i++)
+    range_offsets[i + 1] = range_offsets[i] + cus[i].ranges.size() * 20;
+
   SectionHeader hdr;
   hdr.cu_list_offset = sizeof(hdr);
   hdr.cu_types_offset = hdr.cu_list_offset + cus.size() * 16;
   hdr.ranges_offset = hdr.cu_types_offset;
-
-  hdr.symtab_offset = hdr.ranges_offset;
-  for (Compunit &cu : cus)
-    hdr.symtab_offset += cu.ranges.size() * 20;
-
-  i64 ht_size = bit_ceil(entries.size() * 5 / 4 + 1);
-  hdr.const_pool_offset = hdr.symtab_offset + ht_size * 8;
-
-  i64 offset = 0;
-  for (Entry *ent : entries) {
-    ent->value.type_offset = offset;
-    offset += ent->value.count * 4 + 4;
+  hdr.symtab_offset = hdr.ranges_offset + range_offsets.back();
+  hdr.const_pool_offset = hdr.symtab_offset + sec.symtab_size;
+
+  i64 bufsize = hdr.const_pool_offset + sec.const_pool_size;
+
+  // We usually write the section to the space reserved in the output
+  // file. If it's too small, which shouldn't happen with usual input
+  // files, we append the section to the end of the file instead.
+  OutputFile<E> &file = *ctx.output_file;
+  i64 offset = sec.shdr.sh_offset;
+  bool is_last = (offset + sec.shdr.sh_size == file.filesize);
+  u8 *buf;
+
+  if (bufsize <= sec.shdr.sh_size) {
+    buf = ctx.buf + offset;
+    if (is_last)
+      file.filesize = offset + bufsize;
+  } else {
+    if (is_last)
+      file.filesize = offset;
+    offset = file.filesize;
+    file.buf2.resize(bufsize);
+    buf = file.buf2.data();
   }
 
-  for (Entry *ent : entries) {
-    ent->value.name_offset = offset;
-    offset += ent->keylen + 1;
-  }
-
-  i64 bufsize = hdr.const_pool_offset + offset;
-
-  // Allocate an output buffer
-  ctx.output_file->buf2.resize(bufsize);
-  u8 *buf = ctx.output_file->buf2.data();
-
   // Write a section header
   memcpy(buf, &hdr, sizeof(hdr));
 
-  // Write a CU list
-  u8 *p = buf + sizeof(hdr);
-
-  for (Compunit &cu : cus) {
+  // Write a CU list and address areas
+  tbb::parallel_for((i64)0, (i64)cus.size(), [&](i64 i) {
+    Compunit &cu = cus[i];
+    u8 *p = buf + hdr.cu_list_offset + i * 16;
     *(ul64 *)p = cu.offset;
     *(ul64 *)(p + 8) = cu.size;
-    p += 16;
-  }
 
-  // Write address areas
-  for (i64 i = 0; i < cus.size(); i++) {
-    for (std::pair<u64, u64> range : cus[i].ranges) {
+    p = buf + hdr.ranges_offset + range_offsets[i];
+    for (std::pair<u64, u64> range : cu.ranges) {
       *(ul64 *)p = range.first;
       *(ul64 *)(p + 8) = range.second;
       *(ul32 *)(p + 16) = i;
       p += 20;
     }
-  }
+  });
 
   // Write a symbol table
-  u32 mask = ht_size - 1;
+  using Entry = typename GdbIndexSection<E>::Entry;
+  u32 mask = sec.symtab_size / 8 - 1;
   ul32 *ht = (ul32 *)(buf + hdr.symtab_offset);
 
-  for (Entry *ent : entries) {
+  for (Entry *ent : sec.entries) {
     u32 hash = ent->value.gdb_hash;
     u32 step = ((hash * 17) & mask) | 1;
     u32 j = hash & mask;
@@ -762,33 +898,49 @@ void write_gdb_index(Context<E> &ctx) {
     ht[j * 2 + 1] = ent->value.type_offset;
   }
 
-  // Write types
-  for (i64 i = 0; i < cus.size(); i++) {
-    Compunit &cu = cus[i];
-    u8 *base = buf + hdr.const_pool_offset;
+  // Write CU vectors. Each vector is a count followed by (type, CU
+  // index) pairs. We fill them in parallel and then sort each vector
+  // by CU index for build reproducibility.
+  u8 *pool = buf + hdr.const_pool_offset;
 
-    for (i64 j = 0; j < cu.nametypes.size(); j++) {
-      ul32 *p = (ul32 *)(base + cu.entries[j]->type_offset);
-      i64 idx = ++p[0];
-      p[idx] = (cu.nametypes[j].type << 24) | i;
+  tbb::parallel_for((i64)0, (i64)sec.pubnames.size(), [&](i64 i) {
+    typename GdbIndexSection<E>::Pubnames &pub = sec.pubnames[i];
+
+    for (i64 j = 0; j < pub.nametypes.size(); j++) {
+      typename GdbIndexSection<E>::MapValue &val = *pub.entries[j];
+      ul32 *p = (ul32 *)(pool + val.type_offset);
+      p[val.cursor++ + 1] = (pub.nametypes[j].type << 24) | cu_indices[i];
     }
-  }
+  });
+
+  tbb::parallel_for_each(sec.entries, [&](Entry *ent) {
+    ul32 *p = (ul32 *)(pool + ent->value.type_offset);
+    p[0] = ent->value.count;
+
+    std::sort(p + 1, p + 1 + ent->value.count, [](u32 a, u32 b) {
+      return std::tuple(a & 0xff'ffff, a >> 24) <
+             std::tuple(b & 0xff'ffff, b >> 24);
+    });
+  });
 
   // Write names
-  tbb::parallel_for_each(entries, [&](Entry *ent) {
-    memcpy(buf + hdr.const_pool_offset + ent->value.name_offset,
-           ent->key, ent->keylen);
+  tbb::parallel_for_each(sec.entries, [&](Entry *ent) {
+    memcpy(pool + ent->value.name_offset, ent->key, ent->keylen);
+    pool[ent->value.name_offset + ent->keylen] = '\0';
   });
 
   // Update the section size and rewrite the section header
   if (ctx.shdr) {
-    ctx.gdb_index->shdr.sh_size = bufsize;
+    sec.shdr.sh_offset = offset;
+    sec.shdr.sh_size = bufsize;
     ctx.shdr->copy_buf(ctx);
   }
 }
 
 using E = MOLD_TARGET;
 
+template class GdbIndexSection<E>;
 template void write_gdb_index(Context<E> &);
+template std::span<u8> get_buffer(Context<E> &, Chunk<E> *);
 
 } // namespace mold
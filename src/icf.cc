@@ -63,12 +63,29 @@
 // For Chromium, mold's ICF finishes in less than 1 second with 20 threads,
 // whereas lld takes 5 seconds and gold takes 50 seconds under the same
 // conditions.
+//
+// With --icf-algorithm=refine, mold uses partition refinement instead of
+// rehashing. We start with classes of sections having the same initial
+// hash and split a class only when its members refer to sections in
+// different classes. Only classes that refer to sections whose class
+// has changed are revisited, so the cost of each round is proportional
+// to the number of changed sections rather than to the total number of
+// sections. Both algorithms compute the coarsest partition that is
+// consistent with the edges, so they fold the same sections.
+//
+// The initial hash of a section consists of two parts: the digest of
+// its contents and relocation offsets, types and addends, which depends
+// only on the input file, and the identities of the relocation targets,
+// which depend on the link. Hashing the contents is the expensive part.
+// If --input-cache is given, we save the former to the cache directory
+// so that only modified files are hashed again in subsequent links.
 
 #include "mold.h"
 #include "../lib/siphash.h"
 
 #include <array>
 #include <cstdio>
+#include <memory>
 #include <tbb/concurrent_unordered_map.h>
 #include <tbb/concurrent_vector.h>
 #include <tbb/enumerable_thread_specific.h>
@@ -95,6 +112,10 @@ namespace mold {
 
 static u8 hmac_key[16];
 
+// The key for content digests. This is zero if --input-cache is
+// given, so that the digests are stable across links.
+static u8 content_key[16];
+
 template <typename E>
 static void uniquify_cies(Context<E> &ctx) {
   Timer t(ctx, "uniquify_cies");
@@ -150,10 +171,16 @@ static bool is_leaf(Context<E> &ctx, InputSection<E> &isec) {
   return true;
 }
 
+// Leaf sections are compared not only by their contents but also by
+// their flags and alignments. Otherwise, a function could be merged
+// with a read-only data section happening to have the same bytes, or
+// a data section could be merged with one having a weaker alignment.
 template <typename E>
 struct LeafHasher {
   size_t operator()(InputSection<E> *isec) const {
     u64 h = hash_string(isec->contents);
+    h = combine_hash(h, isec->shdr().sh_flags);
+    h = combine_hash(h, isec->p2align);
     for (FdeRecord<E> &fde : isec->get_fdes()) {
       u64 h2 = hash_string(fde.get_contents(isec->file).substr(8));
       h = combine_hash(h, h2);
@@ -165,7 +192,9 @@ struct LeafHasher {
 template <typename E>
 struct LeafEq {
   bool operator()(InputSection<E> *a, InputSection<E> *b) const {
-    if (a->contents != b->contents)
+    if (a->contents != b->contents ||
+        a->shdr().sh_flags != b->shdr().sh_flags ||
+        a->p2align != b->p2align)
       return false;
 
     std::span<FdeRecord<E>> x = a->get_fdes();
@@ -229,9 +258,11 @@ static void merge_leaf_nodes(Context<E> &ctx) {
   });
 }
 
+// Computes a digest of the parts of a section that depend only on the
+// input file.
 template <typename E>
-static Digest compute_digest(Context<E> &ctx, InputSection<E> &isec) {
-  SipHash13_128 hasher(hmac_key);
+static Digest compute_content_digest(Context<E> &ctx, InputSection<E> &isec) {
+  SipHash13_128 hasher(content_key);
 
   auto hash = [&](auto val) {
     hasher.update((u8 *)&val, sizeof(val));
@@ -242,6 +273,48 @@ static Digest compute_digest(Context<E> &ctx, InputSection<E> &isec) {
     hasher.update((u8 *)str.data(), str.size());
   };
 
+  hash_string(isec.contents);
+  hash(isec.shdr().sh_flags);
+  hash(isec.p2align);
+  hash(isec.get_fdes().size());
+  hash(isec.get_rels(ctx).size());
+
+  for (FdeRecord<E> &fde : isec.get_fdes()) {
+    // Bytes 0 to 4 contain the length of this record, and
+    // bytes 4 to 8 contain an offset to CIE.
+    hash_string(fde.get_contents(isec.file).substr(8));
+
+    hash(fde.get_rels(isec.file).size());
+
+    for (const ElfRel<E> &rel : fde.get_rels(isec.file).subspan(1)) {
+      hash(rel.r_type);
+      hash(rel.r_offset - fde.input_offset);
+      hash(get_addend(isec.file.cies[fde.cie_idx].input_section, rel));
+    }
+  }
+
+  for (const ElfRel<E> &rel : isec.get_rels(ctx)) {
+    hash(rel.r_offset);
+    hash(rel.r_type);
+    hash(get_addend(isec, rel));
+  }
+
+  Digest digest;
+  hasher.finish(digest.data());
+  return digest;
+}
+
+// Combines a content digest with the identities of CIEs and
+// relocation targets to compute the initial hash of a section.
+template <typename E>
+static Digest compute_digest(Context<E> &ctx, InputSection<E> &isec,
+                             const Digest &content) {
+  SipHash13_128 hasher(hmac_key);
+
+  auto hash = [&](auto val) {
+    hasher.update((u8 *)&val, sizeof(val));
+  };
+
   auto hash_symbol = [&](Symbol<E> &sym) {
     InputSection<E> *isec = sym.get_input_section();
 
@@ -252,7 +325,10 @@ static Digest compute_digest(Context<E> &ctx, InputSection<E> &isec) {
       hash('2');
       hash((u64)frag);
     } else if (!isec) {
+      // Imported, absolute or undefined weak symbols. Two relocations
+      // refer to the same address only if they refer to the same symbol.
       hash('3');
+      hash((u64)&sym);
     } else if (isec->leader) {
       hash('4');
       hash((u64)isec->leader);
@@ -265,35 +341,16 @@ static Digest compute_digest(Context<E> &ctx, InputSection<E> &isec) {
     hash(sym.value);
   };
 
-  hash_string(isec.contents);
-  hash(isec.shdr().sh_flags);
-  hash(isec.get_fdes().size());
-  hash(isec.get_rels(ctx).size());
+  hasher.update((u8 *)content.data(), HASH_SIZE);
 
   for (FdeRecord<E> &fde : isec.get_fdes()) {
     hash(isec.file.cies[fde.cie_idx].icf_idx);
-
-    // Bytes 0 to 4 contain the length of this record, and
-    // bytes 4 to 8 contain an offset to CIE.
-    hash_string(fde.get_contents(isec.file).substr(8));
-
-    hash(fde.get_rels(isec.file).size());
-
-    for (const ElfRel<E> &rel : fde.get_rels(isec.file).subspan(1)) {
+    for (const ElfRel<E> &rel : fde.get_rels(isec.file).subspan(1))
       hash_symbol(*isec.file.symbols[rel.r_sym]);
-      hash(rel.r_type);
-      hash(rel.r_offset - fde.input_offset);
-      hash(get_addend(isec.file.cies[fde.cie_idx].input_section, rel));
-    }
   }
 
-  for (i64 i = 0; i < isec.get_rels(ctx).size(); i++) {
-    const ElfRel<E> &rel = isec.get_rels(ctx)[i];
-    hash(rel.r_offset);
-    hash(rel.r_type);
-    hash(get_addend(isec, rel));
+  for (const ElfRel<E> &rel : isec.get_rels(ctx))
     hash_symbol(*isec.file.symbols[rel.r_sym]);
-  }
 
   Digest digest;
   hasher.finish(digest.data());
@@ -335,14 +392,114 @@ static std::vector<InputSection<E> *> gather_sections(Context<E> &ctx) {
   return sections;
 }
 
+struct IcfCacheHeader {
+  char magic[8];
+  u64 key;
+  u32 num_sections;
+  u32 padding;
+};
+
+struct IcfCacheEntry {
+  u32 shndx;
+  Digest digest;
+};
+
+static constexpr char ICF_CACHE_MAGIC[8] = {'M', 'O', 'L', 'D', 'I', 'C', 'F', '1'};
+
+// Computes content digests of a given file's sections using the
+// cache file if possible. `sections` must be sorted by section index.
+template <typename E>
+static void
+compute_cached_content_digests(Context<E> &ctx, ObjectFile<E> &file,
+                               std::span<InputSection<E> *> sections,
+                               std::span<Digest> digests) {
+  u64 key = get_input_cache_key(file);
+  if (key == 0) {
+    for (i64 i = 0; i < sections.size(); i++)
+      digests[i] = compute_content_digest(ctx, *sections[i]);
+    return;
+  }
+
+  std::string path = get_input_cache_path(ctx.arg.input_cache, key, ".icf");
+  std::string error;
+  std::unique_ptr<MappedFile> mf(open_file_impl(path, error));
+
+  // The cache file consists of the header followed by entries sorted
+  // by section index. Look up each section by merging the two lists.
+  std::span<IcfCacheEntry> entries;
+
+  if (mf && mf->size >= sizeof(IcfCacheHeader)) {
+    IcfCacheHeader &hdr = *(IcfCacheHeader *)mf->data;
+    if (memcmp(hdr.magic, ICF_CACHE_MAGIC, sizeof(hdr.magic)) == 0 &&
+        hdr.key == key &&
+        mf->size == sizeof(hdr) + hdr.num_sections * sizeof(IcfCacheEntry))
+      entries = {(IcfCacheEntry *)(mf->data + sizeof(hdr)), hdr.num_sections};
+  }
+
+  bool updated = false;
+  i64 j = 0;
+
+  for (i64 i = 0; i < sections.size(); i++) {
+    while (j < entries.size() && entries[j].shndx < sections[i]->shndx)
+      j++;
+
+    if (j < entries.size() && entries[j].shndx == sections[i]->shndx) {
+      digests[i] = entries[j].digest;
+    } else {
+      digests[i] = compute_content_digest(ctx, *sections[i]);
+      updated = true;
+    }
+  }
+
+  if (!updated)
+    return;
+
+  IcfCacheHeader hdr = {};
+  memcpy(hdr.magic, ICF_CACHE_MAGIC, sizeof(hdr.magic));
+  hdr.key = key;
+  hdr.num_sections = sections.size();
+
+  std::vector<u8> buf(sizeof(hdr) + sections.size() * sizeof(IcfCacheEntry));
+  memcpy(buf.data(), &hdr, sizeof(hdr));
+
+  IcfCacheEntry *ent = (IcfCacheEntry *)(buf.data() + sizeof(hdr));
+  for (i64 i = 0; i < sections.size(); i++)
+    ent[i] = {(u32)sections[i]->shndx, digests[i]};
+
+  mf.reset();
+  write_input_cache_file(path, buf);
+}
+
 template <typename E>
 static std::vector<Digest>
 compute_digests(Context<E> &ctx, std::span<InputSection<E> *> sections) {
   Timer t(ctx, "compute_digests");
 
   std::vector<Digest> digests(sections.size());
+
+  if (ctx.arg.input_cache.empty()) {
+    tbb::parallel_for((i64)0, (i64)sections.size(), [&](i64 i) {
+      digests[i] = compute_content_digest(ctx, *sections[i]);
+    });
+  } else {
+    // `sections` are grouped by file and sorted by section index
+    // within each file. Find the range for each file.
+    std::vector<i64> begin;
+    for (i64 i = 0; i < sections.size(); i++)
+      if (i == 0 || &sections[i]->file != &sections[i - 1]->file)
+        begin.push_back(i);
+    begin.push_back(sections.size());
+
+    tbb::parallel_for((i64)0, (i64)begin.size() - 1, [&](i64 i) {
+      i64 n = begin[i + 1] - begin[i];
+      compute_cached_content_digests(ctx, sections[begin[i]]->file,
+                                     sections.subspan(begin[i], n),
+                                     std::span(digests).subspan(begin[i], n));
+    });
+  }
+
   tbb::parallel_for((i64)0, (i64)sections.size(), [&](i64 i) {
-    digests[i] = compute_digest(ctx, *sections[i]);
+    digests[i] = compute_digest(ctx, *sections[i], digests[i]);
   });
   return digests;
 }
@@ -448,6 +605,243 @@ static i64 count_num_classes(std::span<Digest> digests,
   return num_classes.combine(std::plus());
 }
 
+// Runs the propagation rounds described at the top of this file and
+// assigns a leader to each section.
+template <typename E>
+static void propagate_digests(Context<E> &ctx,
+                              std::span<InputSection<E> *> sections,
+                              std::vector<std::vector<Digest>> &digests,
+                              std::span<u32> edges,
+                              std::span<u32> edge_indices) {
+  std::vector<u8> converged(digests[0].size());
+  bool slot = 0;
+
+  // Execute the propagation rounds until convergence is obtained.
+  {
+    Timer t(ctx, "propagate");
+    tbb::affinity_partitioner ap;
+
+    // A cheap test that the graph hasn't converged yet.
+    // The loop after this one uses a strict condition, but it's expensive
+    // as it requires sorting the entire hash collection.
+    //
+    // For nodes that have a cycle in downstream (i.e. recursive
+    // functions and functions that calls recursive functions) will always
+    // change with the iterations. Nodes that doesn't (i.e. non-recursive
+    // functions) will stop changing as soon as the propagation depth reaches
+    // the call tree depth.
+    // Here, we test whether we have reached sufficient depth for the latter,
+    // which is a necessary (but not sufficient) condition for convergence.
+    i64 num_changed = -1;
+    for (;;) {
+      i64 n = propagate<E>(digests, edges, edge_indices, slot, converged, ap);
+      if (n == num_changed)
+        break;
+      num_changed = n;
+    }
+
+    // Run the pass until the unique number of hashes stop increasing, at which
+    // point we have achieved convergence (proof omitted for brevity).
+    i64 num_classes = -1;
+    for (;;) {
+      // count_num_classes requires sorting which is O(n log n), so do a little
+      // more work beforehand to amortize that log factor.
+      for (i64 i = 0; i < 10; i++)
+        propagate<E>(digests, edges, edge_indices, slot, converged, ap);
+
+      i64 n = count_num_classes<E>(digests[slot], ap);
+      if (n == num_classes)
+        break;
+      num_classes = n;
+    }
+  }
+
+  // Group sections by hash values.
+  {
+    Timer t(ctx, "group");
+
+    auto *map = new tbb::concurrent_unordered_map<Digest, InputSection<E> *>;
+    std::span<Digest> digest = digests[slot];
+
+    tbb::parallel_for((i64)0, (i64)sections.size(), [&](i64 i) {
+      InputSection<E> *isec = sections[i];
+      auto [it, inserted] = map->insert({digest[i], isec});
+      if (!inserted && isec->get_priority() < it->second->get_priority())
+        it->second = isec;
+    });
+
+    tbb::parallel_for((i64)0, (i64)sections.size(), [&](i64 i) {
+      auto it = map->find(digest[i]);
+      assert(it != map->end());
+      sections[i]->leader = it->second;
+    });
+
+    // Since free'ing the map is slow, postpone it.
+    ctx.on_exit.push_back([=] { delete map; });
+  }
+}
+
+// Computes the coarsest partition of sections such that sections in
+// the same class have the same initial digest and refer to sections in
+// the same classes, and assigns a leader to each section.
+//
+// Members of each class are stored contiguously in `order`, and a class
+// is identified by the index of its first member in `order`. When we
+// split a class, the first subclass inherits the original class ID,
+// and the sections in the other subclasses get new class IDs. Only
+// classes containing a section that refers to such section can be
+// split in the next round, so we keep them in a worklist.
+template <typename E>
+static void refine_classes(Context<E> &ctx,
+                           std::span<InputSection<E> *> sections,
+                           std::span<Digest> digests,
+                           std::span<u32> edges,
+                           std::span<u32> edge_indices) {
+  Timer t(ctx, "refine_classes");
+
+  i64 num = sections.size();
+  if (num == 0)
+    return;
+
+  auto get_edges = [&](i64 i) {
+    i64 begin = edge_indices[i];
+    i64 end = (i + 1 == num) ? edges.size() : edge_indices[i + 1];
+    return edges.subspan(begin, end - begin);
+  };
+
+  // Create the initial partition from the digests.
+  std::vector<u32> order(num);
+  std::vector<u32> classes(num);
+  std::vector<u32> ends(num);
+
+  tbb::parallel_for((i64)0, num, [&](i64 i) { order[i] = i; });
+  tbb::parallel_sort(order.begin(), order.end(), [&](u32 a, u32 b) {
+    return digests[a] < digests[b];
+  });
+
+  for (i64 i = 0, begin = 0; i < num; i++) {
+    if (i > 0 && digests[order[i - 1]] != digests[order[i]]) {
+      ends[begin] = i;
+      begin = i;
+    }
+    classes[order[i]] = begin;
+    if (i + 1 == num)
+      ends[begin] = num;
+  }
+
+  // Create reverse edges so that we can find sections referring to a
+  // given section.
+  std::vector<Atomic<u32>> num_preds(num);
+  tbb::parallel_for((i64)0, num, [&](i64 i) {
+    for (u32 j : get_edges(i))
+      num_preds[j]++;
+  });
+
+  std::vector<u32> pred_indices(num + 1);
+  for (i64 i = 0; i < num; i++)
+    pred_indices[i + 1] = pred_indices[i] + num_preds[i];
+
+  std::vector<u32> preds(pred_indices[num]);
+  tbb::parallel_for((i64)0, num, [&](i64 i) {
+    for (u32 j : get_edges(i))
+      preds[pred_indices[j] + --num_preds[j]] = i;
+  });
+
+  // Initially, all classes with two or more members need to be examined.
+  std::vector<u32> worklist;
+  for (i64 i = 0; i < num; i = ends[i])
+    if (ends[i] - i > 1)
+      worklist.push_back(i);
+
+  std::vector<Atomic<bool>> queued(num);
+  std::vector<u32> next_classes = classes;
+
+  // Returns true if a given pair of sections refer to sections in
+  // different classes. Used to sort members of a class.
+  auto less = [&](u32 a, u32 b) {
+    std::span<u32> x = get_edges(a);
+    std::span<u32> y = get_edges(b);
+    if (x.size() != y.size())
+      return x.size() < y.size();
+
+    for (i64 i = 0; i < x.size(); i++)
+      if (classes[x[i]] != classes[y[i]])
+        return classes[x[i]] < classes[y[i]];
+    return false;
+  };
+
+  static Counter round("icf_refine_round");
+
+  while (!worklist.empty()) {
+    round++;
+    tbb::enumerable_thread_specific<std::vector<u32>> changed;
+
+    // Split classes in the worklist. We read only `classes` and write
+    // only `next_classes`, so that the classes can be processed in
+    // parallel.
+    tbb::parallel_for_each(worklist, [&](u32 begin) {
+      u32 end = ends[begin];
+      std::sort(order.begin() + begin, order.begin() + end, less);
+
+      for (u32 i = begin + 1, start = begin; i <= end; i++) {
+        if (i < end && !less(order[i - 1], order[i]))
+          continue;
+
+        ends[start] = i;
+        if (start != begin) {
+          std::vector<u32> &vec = changed.local();
+          for (u32 j = start; j < i; j++) {
+            next_classes[order[j]] = start;
+            vec.push_back(order[j]);
+          }
+        }
+        start = i;
+      }
+    });
+
+    for (u32 begin : worklist)
+      queued[begin] = false;
+
+    // Commit the new class IDs.
+    tbb::parallel_for_each(changed, [&](std::vector<u32> &vec) {
+      for (u32 i : vec)
+        classes[i] = next_classes[i];
+    });
+
+    // Classes containing sections that refer to the sections whose
+    // class has changed may need to be split in the next round.
+    tbb::enumerable_thread_specific<std::vector<u32>> next_worklist;
+
+    tbb::parallel_for_each(changed, [&](std::vector<u32> &vec) {
+      for (u32 i : vec) {
+        for (u32 j = pred_indices[i]; j < pred_indices[i + 1]; j++) {
+          u32 c = classes[preds[j]];
+          if (ends[c] - c > 1 && !queued[c].exchange(true))
+            next_worklist.local().push_back(c);
+        }
+      }
+    });
+
+    worklist.clear();
+    for (std::vector<u32> &vec : next_worklist)
+      append(worklist, vec);
+  }
+
+  // Use the section with the highest priority in each class as its leader.
+  tbb::parallel_for((i64)0, num, [&](i64 begin) {
+    if (classes[order[begin]] != begin)
+      return;
+
+    InputSection<E> *leader = sections[order[begin]];
+    for (i64 i = begin + 1; i < ends[begin]; i++)
+      if (sections[order[i]]->get_priority() < leader->get_priority())
+        leader = sections[order[i]];
+
+    for (i64 i = begin; i < ends[begin]; i++)
+      sections[order[i]]->leader = leader;
+  });
+}
+
 template <typename E>
 static void print_icf_sections(Context<E> &ctx) {
   tbb::concurrent_vector<InputSection<E> *> leaders;
@@ -496,6 +890,10 @@ void icf_sections(Context<E> &ctx) {
     return;
 
   get_random_bytes(hmac_key, sizeof(hmac_key));
+  if (ctx.arg.input_cache.empty())
+    get_random_bytes(content_key, sizeof(content_key));
+  else
+    memset(content_key, 0, sizeof(content_key));
 
   uniquify_cies(ctx);
   merge_leaf_nodes(ctx);
@@ -521,72 +919,10 @@ void icf_sections(Context<E> &ctx) {
   std::vector<u32> edge_indices;
   gather_edges<E>(ctx, sections, edges, edge_indices);
 
-  std::vector<u8> converged(digests[0].size());
-  bool slot = 0;
-
-  // Execute the propagation rounds until convergence is obtained.
-  {
-    Timer t(ctx, "propagate");
-    tbb::affinity_partitioner ap;
-
-    // A cheap test that the graph hasn't converged yet.
-    // The loop after this one uses a strict condition, but it's expensive
-    // as it requires sorting the entire hash collection.
-    //
-    // For nodes that have a cycle in downstream (i.e. recursive
-    // functions and functions that calls recursive functions) will always
-    // change with the iterations. Nodes that doesn't (i.e. non-recursive
-    // functions) will stop changing as soon as the propagation depth reaches
-    // the call tree depth.
-    // Here, we test whether we have reached sufficient depth for the latter,
-    // which is a necessary (but not sufficient) condition for convergence.
-    i64 num_changed = -1;
-    for (;;) {
-      i64 n = propagate<E>(digests, edges, edge_indices, slot, converged, ap);
-      if (n == num_changed)
-        break;
-      num_changed = n;
-    }
-
-    // Run the pass until the unique number of hashes stop increasing, at which
-    // point we have achieved convergence (proof omitted for brevity).
-    i64 num_classes = -1;
-    for (;;) {
-      // count_num_classes requires sorting which is O(n log n), so do a little
-      // more work beforehand to amortize that log factor.
-      for (i64 i = 0; i < 10; i++)
-        propagate<E>(digests, edges, edge_indices, slot, converged, ap);
-
-      i64 n = count_num_classes<E>(digests[slot], ap);
-      if (n == num_classes)
-        break;
-      num_classes = n;
-    }
-  }
-
-  // Group sections by hash values.
-  {
-    Timer t(ctx, "group");
-
-    auto *map = new tbb::concurrent_unordered_map<Digest, InputSection<E> *>;
-    std::span<Digest> digest = digests[slot];
-
-    tbb::parallel_for((i64)0, (i64)sections.size(), [&](i64 i) {
-      InputSection<E> *isec = sections[i];
-      auto [it, inserted] = map->insert({digest[i], isec});
-      if (!inserted && isec->get_priority() < it->second->get_priority())
-        it->second = isec;
-    });
-
-    tbb::parallel_for((i64)0, (i64)sections.size(), [&](i64 i) {
-      auto it = map->find(digest[i]);
-      assert(it != map->end());
-      sections[i]->leader = it->second;
-    });
-
-    // Since free'ing the map is slow, postpone it.
-    ctx.on_exit.push_back([=] { delete map; });
-  }
+  if (ctx.arg.icf_algorithm == ICF_REFINE)
+    refine_classes<E>(ctx, sections, digests[0], edges, edge_indices);
+  else
+    propagate_digests<E>(ctx, sections, digests, edges, edge_indices);
 
   if (ctx.arg.print_icf_sections)
     print_icf_sections(ctx);
@@ -0,0 +1,484 @@
+// This file implements --incremental.
+//
+// When we are linking a large program with debug info, most of the
+// linker's time is spent in copy_chunks(), which copies input sections
+// to the output file and applies relocations to them. In a typical
+// edit-compile-link cycle, however, only a few object files have
+// changed since the previous link. As long as the memory and file
+// layouts stay the same, the bytes that unchanged object files
+// contribute to the output are exactly the same as before.
+//
+// With --incremental, we compute digests of the layout right before
+// creating an output file. A global digest covers output section
+// headers and the command line. A per-file digest covers everything
+// else that the result of a relocation in the file may depend on: the
+// offsets of its input sections and section fragments, and the
+// addresses and GOT/PLT/TLS indices of the symbols it defines or
+// refers to. We save them along with an identifier of each input
+// object file to `<output>.incremental` after each link.
+//
+// On the next link, if the global digest matches the saved one and the
+// output file hasn't been touched since, we reuse the existing output
+// file in place and skip writing input sections of object files that
+// haven't changed and whose per-file digests are the same as before.
+// Synthetic sections such as .got, .dynsym, .symtab, .eh_frame or
+// merged string sections are always rewritten.
+//
+// To allow code and data to grow without changing the layout, we
+// reserve slack after each input section on the first link and record
+// the reserved sizes in the state file. On subsequent links, an input
+// section that still fits in its slack keeps its address. If it grows,
+// the symbols after it in the same section move, so the per-file
+// digests of files referring to these symbols change. Such files are
+// rewritten, which re-applies their relocations. If an input section
+// outgrows its slack, or if a synthetic section changes its size, the
+// global digest changes and we fall back to a regular full link.
+
+#include "mold.h"
+
+#include <fstream>
+#include <sys/stat.h>
+#include <tbb/parallel_for.h>
+
+#ifndef _WIN32
+# include <unistd.h>
+#endif
+
+namespace mold {
+
+// The state file consists of this header followed by an array of
+// `num_files` IncrementalFile records and an array of `num_capacities`
+// u32 values. The latter contains the reserved sizes of the input
+// sections of each file, indexed by section index.
+struct IncrementalHeader {
+  char magic[8];
+  u64 layout_hash;
+  u64 output_size;
+  i64 output_mtime;
+  u64 output_ino;
+  u64 num_files;
+  u64 num_capacities;
+};
+
+struct IncrementalFile {
+  u64 id;
+  u64 name_hash;
+  u64 layout_hash;
+  u64 num_sections;
+};
+
+static constexpr char INCREMENTAL_MAGIC[8] = {'M', 'O', 'L', 'D', 'I', 'N', 'C', '2'};
+
+// The contents of a state file written by the previous link
+struct IncrementalState {
+  std::unique_ptr<MappedFile> mf;
+  IncrementalHeader *hdr = nullptr;
+  std::span<IncrementalFile> files;
+  std::vector<std::span<u32>> capacities;
+};
+
+template <typename E>
+static bool can_update_in_place(Context<E> &ctx) {
+#ifdef _WIN32
+  return false;
+#else
+  // We don't overwrite shared objects because they may be mmap'ed by
+  // running processes. See the comment for `overwrite_output_file`.
+  return ctx.overwrite_output_file && ctx.arg.output != "-" &&
+         ctx.arg.compress_debug_sections == COMPRESS_NONE &&
+         ctx.arg.separate_debug_file.empty() && ctx.arg.filler == -1;
+#endif
+}
+
+template <typename E>
+static std::string get_output_path(Context<E> &ctx) {
+  std::string path = ctx.arg.output;
+  if (path.starts_with('/') && !ctx.arg.chroot.empty())
+    path = ctx.arg.chroot + "/" + path_clean(path);
+  return path;
+}
+
+static i64 get_mtime(const struct stat &st) {
+#if defined(__APPLE__)
+  return st.st_mtimespec.tv_sec * 1000000000LL + st.st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+  return st.st_mtime * 1000000000LL;
+#else
+  return st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+}
+
+// Returns a value that changes if a given file is updated, or 0 if we
+// cannot tell. An archive member is considered updated if the archive
+// file is updated.
+template <typename E>
+static u64 get_file_id(ObjectFile<E> &file) {
+  if (!file.mf)
+    return 0;
+
+  MappedFile *root = file.mf;
+  while (root->parent)
+    root = root->parent;
+
+  if (root->mtime == 0)
+    return 0;
+
+  std::string key = file.mf->get_identifier() + "\0"s +
+                    std::to_string(root->size) + "\0"s +
+                    std::to_string(root->mtime);
+  return std::max<u64>(hash_string(key), 1);
+}
+
+// Returns a value that identifies a given file by its name. Unlike
+// get_file_id(), it doesn't change if the file is updated.
+template <typename E>
+static u64 get_file_name_hash(ObjectFile<E> &file) {
+  if (!file.mf)
+    return 0;
+  return std::max<u64>(hash_string(file.mf->get_identifier()), 1);
+}
+
+template <typename E>
+static bool read_state(Context<E> &ctx, IncrementalState &state) {
+  std::string error;
+  state.mf.reset(open_file_impl(get_output_path(ctx) + ".incremental", error));
+  if (!state.mf || state.mf->size < sizeof(IncrementalHeader))
+    return false;
+
+  IncrementalHeader &hdr = *(IncrementalHeader *)state.mf->data;
+  if (memcmp(hdr.magic, INCREMENTAL_MAGIC, sizeof(hdr.magic)) ||
+      state.mf->size != sizeof(hdr) + hdr.num_files * sizeof(IncrementalFile) +
+                        hdr.num_capacities * sizeof(u32))
+    return false;
+
+  state.hdr = &hdr;
+  state.files = {(IncrementalFile *)(state.mf->data + sizeof(hdr)),
+                 (size_t)hdr.num_files};
+
+  u32 *cap = (u32 *)(state.files.data() + state.files.size());
+  u32 *end = cap + hdr.num_capacities;
+
+  for (IncrementalFile &file : state.files) {
+    if ((u64)(end - cap) < file.num_sections)
+      return false;
+    state.capacities.push_back({cap, (size_t)file.num_sections});
+    cap += file.num_sections;
+  }
+  return cap == end;
+}
+
+// Returns true if we can reserve slack after a given input section.
+//
+// We don't pad sections whose contents are interpreted as arrays, such
+// as .init_array, .tm_clone_table or sections accessed via __start_ and
+// __stop_ symbols, nor .init or .fini, whose input sections are concatenated
+// to form a single function. On targets that create range extension
+// thunks or shrink sections, section offsets are computed in a
+// different way, so we don't pad sections at all.
+template <typename E>
+static bool can_have_slack(InputSection<E> &isec) {
+  if constexpr (needs_thunk<E> || is_riscv<E> || is_loongarch<E>)
+    return false;
+
+  const ElfShdr<E> &shdr = isec.shdr();
+  if (!(shdr.sh_flags & SHF_ALLOC) ||
+      (shdr.sh_type != SHT_PROGBITS && shdr.sh_type != SHT_NOBITS))
+    return false;
+
+  std::string_view name = isec.output_section->name;
+  return name != ".init" && name != ".fini" && name != ".ctors" &&
+         name != ".dtors" && name != ".init_array" && name != ".fini_array" &&
+         name != ".preinit_array" && name != ".tm_clone_table" &&
+         !is_c_identifier(name);
+}
+
+// Assign reserved sizes to input sections. This function has to be
+// called before input section offsets are computed.
+//
+// If an input section of the same file existed in the previous link and
+// the new contents still fit in the reserved space, we keep the same
+// size so that the layout doesn't change. Otherwise, we reserve 1/8 of
+// the section size plus a few bytes, which is usually enough for small
+// edits to a function or a variable.
+template <typename E>
+void reserve_incremental_slack(Context<E> &ctx) {
+  Timer t(ctx, "reserve_incremental_slack");
+
+  if (!can_update_in_place(ctx))
+    return;
+
+  IncrementalState state;
+  if (!read_state(ctx, state) || state.files.size() != ctx.objs.size())
+    state.files = {};
+
+  tbb::parallel_for((i64)0, (i64)ctx.objs.size(), [&](i64 i) {
+    ObjectFile<E> &file = *ctx.objs[i];
+
+    std::span<u32> prev;
+    if (!state.files.empty() &&
+        state.files[i].name_hash == get_file_name_hash(file) &&
+        state.files[i].num_sections == file.sections.size())
+      prev = state.capacities[i];
+
+    file.section_capacities.resize(file.sections.size());
+
+    for (std::unique_ptr<InputSection<E>> &isec : file.sections) {
+      if (!isec || !isec->is_alive || !isec->output_section ||
+          isec->shndx >= file.sections.size() || !can_have_slack(*isec))
+        continue;
+
+      i64 size = isec->sh_size;
+      i64 cap = size + size / 8 + 16;
+      if (!prev.empty() && size <= prev[isec->shndx])
+        cap = prev[isec->shndx];
+      if (cap <= UINT32_MAX)
+        file.section_capacities[isec->shndx] = cap;
+    }
+  });
+}
+
+// Returns true if a given file has a relocation that refers to a
+// symbol size, e.g. R_X86_64_SIZE64. Such relocations are rare.
+template <typename E>
+static bool has_size_relocs(Context<E> &ctx, ObjectFile<E> &file) {
+  auto is_size_reloc = [](u32 r_type) {
+    if constexpr (is_x86_64<E>)
+      return r_type == R_X86_64_SIZE32 || r_type == R_X86_64_SIZE64;
+    else if constexpr (is_i386<E>)
+      return r_type == R_386_SIZE32;
+    else if constexpr (is_sparc64<E>)
+      return r_type == R_SPARC_SIZE32;
+    return false;
+  };
+
+  for (std::unique_ptr<InputSection<E>> &isec : file.sections)
+    if (isec && isec->is_alive)
+      for (const ElfRel<E> &rel : isec->get_rels(ctx))
+        if (is_size_reloc(rel.r_type))
+          return true;
+  return false;
+}
+
+template <typename E>
+static u64 get_file_layout_hash(Context<E> &ctx, ObjectFile<E> &file) {
+  std::vector<u64> vec;
+  bool refers_to_sizes = has_size_relocs(ctx, file);
+
+  for (std::unique_ptr<InputSection<E>> &isec : file.sections) {
+    if (isec && isec->is_alive && isec->output_section) {
+      vec.push_back(isec->output_section->shndx);
+      vec.push_back(isec->output_section->shdr.sh_offset);
+      vec.push_back(isec->offset);
+      vec.push_back(isec->sh_size);
+      vec.push_back(isec->reldyn_offset);
+    } else {
+      vec.push_back(-1);
+    }
+  }
+
+  for (std::unique_ptr<MergeableSection<E>> &m : file.mergeable_sections) {
+    if (m) {
+      for (SectionFragment<E> *frag : m->fragments) {
+        if (frag->is_alive) {
+          vec.push_back(frag->output_section.shndx);
+          vec.push_back(frag->offset);
+        } else {
+          vec.push_back(-1);
+        }
+      }
+    }
+  }
+
+  // Relocations refer to symbols through `file.symbols`, which contains
+  // not only symbols defined by this file but also ones it refers to.
+  // If any of them has moved, the digest changes and the file's
+  // relocations are applied again.
+  for (Symbol<E> *sym : file.symbols) {
+    InputSection<E> *isec = sym->get_input_section();
+    if (isec && !isec->is_alive && !isec->icf_removed()) {
+      vec.push_back(-1);
+      continue;
+    }
+
+    vec.push_back(sym->get_addr(ctx, NO_PLT | NO_OPD));
+    vec.push_back(sym->is_imported | (sym->is_exported << 1) |
+                  (sym->has_copyrel << 2));
+
+    // Symbol sizes matter only to size relocations. We don't want a
+    // function that grows in place to invalidate all files calling it.
+    if (sym->file) {
+      vec.push_back(sym->esym().st_type);
+      if (refers_to_sizes)
+        vec.push_back(sym->esym().st_size);
+    }
+
+    if (sym->aux_idx != -1) {
+      vec.push_back(sym->get_got_idx(ctx));
+      vec.push_back(sym->get_gottp_idx(ctx));
+      vec.push_back(sym->get_tlsgd_idx(ctx));
+      vec.push_back(sym->get_tlsdesc_idx(ctx));
+      vec.push_back(sym->get_plt_idx(ctx));
+      vec.push_back(sym->get_pltgot_idx(ctx));
+      vec.push_back(sym->get_dynsym_idx(ctx));
+      if constexpr (is_ppc64v1<E>)
+        vec.push_back(sym->get_opd_idx(ctx));
+    }
+  }
+
+  return hash_string({(char *)vec.data(), vec.size() * sizeof(vec[0])});
+}
+
+template <typename E>
+static u64 compute_layout_hash(Context<E> &ctx) {
+  // Different versions of mold or different command line options may
+  // produce different contents for the same layout.
+  std::vector<u64> vec;
+  vec.push_back(hash_string(get_mold_version()));
+  //
+  // We ignore LTO plugin options because the GCC driver passes a
+  // temporary filename with -plugin-opt=-fresolution= on each
+  // invocation. They don't matter anyway because LTO-generated object
+  // files are new files and thus never reusable.
+  for (std::string_view arg : ctx.cmdline_args)
+    if (!arg.starts_with("-plugin") && !arg.starts_with("--plugin"))
+      vec.push_back(hash_string(arg));
+
+  // The location of a non-allocated section matters only to input
+  // sections in it, so it is covered by per-file digests.
+  for (Chunk<E> *chunk : ctx.chunks) {
+    vec.push_back(hash_string(chunk->name));
+    vec.push_back(chunk->shdr.sh_type);
+    vec.push_back(chunk->shdr.sh_flags);
+
+    if (chunk->shdr.sh_flags & SHF_ALLOC) {
+      vec.push_back(chunk->shdr.sh_addr);
+      vec.push_back(chunk->shdr.sh_offset);
+      vec.push_back(chunk->shdr.sh_size);
+      vec.push_back(chunk->shdr.sh_link);
+      vec.push_back(chunk->shdr.sh_info);
+    }
+
+    if constexpr (needs_thunk<E>) {
+      if (OutputSection<E> *osec = chunk->to_osec()) {
+        for (std::unique_ptr<Thunk<E>> &thunk : osec->thunks) {
+          vec.push_back(thunk->offset);
+          for (Symbol<E> *sym : thunk->symbols)
+            vec.push_back(hash_string(sym->name()));
+        }
+      }
+    }
+  }
+
+  vec.push_back(ctx.tls_begin);
+  vec.push_back(ctx.tp_addr);
+  vec.push_back(ctx.dtp_addr);
+  return hash_string({(char *)vec.data(), vec.size() * sizeof(vec[0])});
+}
+
+// Compare the current layout with the one recorded by the previous
+// link and mark object files whose contents in the existing output
+// file are up to date. This function has to be called after the layout
+// is fixed and before the output file is opened.
+template <typename E>
+void prepare_incremental_link(Context<E> &ctx) {
+  Timer t(ctx, "prepare_incremental_link");
+
+  if (!can_update_in_place(ctx))
+    return;
+
+  ctx.layout_hash = compute_layout_hash(ctx);
+
+  tbb::parallel_for((i64)0, (i64)ctx.objs.size(), [&](i64 i) {
+    ctx.objs[i]->layout_hash = get_file_layout_hash(ctx, *ctx.objs[i]);
+  });
+
+  IncrementalState state;
+  if (!read_state(ctx, state) || state.hdr->layout_hash != ctx.layout_hash ||
+      state.files.size() != ctx.objs.size())
+    return;
+
+  // The existing output file must be the one we created last time.
+  std::string path = get_output_path(ctx);
+  struct stat st;
+  if (stat(path.c_str(), &st) == -1 || !S_ISREG(st.st_mode) ||
+      st.st_size != state.hdr->output_size ||
+      get_mtime(st) != state.hdr->output_mtime ||
+      st.st_ino != state.hdr->output_ino)
+    return;
+
+  tbb::parallel_for((i64)0, (i64)ctx.objs.size(), [&](i64 i) {
+    ObjectFile<E> &file = *ctx.objs[i];
+    u64 id = get_file_id(file);
+    file.is_reusable = (id != 0 && id == state.files[i].id &&
+                        file.layout_hash == state.files[i].layout_hash);
+  });
+}
+
+// Record the layout of the output file we've just created for the
+// next link.
+template <typename E>
+void write_incremental_state(Context<E> &ctx) {
+  Timer t(ctx, "write_incremental_state");
+
+  if (!can_update_in_place(ctx))
+    return;
+
+  std::string path = get_output_path(ctx);
+  struct stat st;
+  if (stat(path.c_str(), &st) == -1 || !S_ISREG(st.st_mode))
+    return;
+
+  std::vector<IncrementalFile> files(ctx.objs.size());
+  tbb::parallel_for((i64)0, (i64)ctx.objs.size(), [&](i64 i) {
+    ObjectFile<E> &file = *ctx.objs[i];
+    files[i].id = get_file_id(file);
+    files[i].name_hash = get_file_name_hash(file);
+    files[i].layout_hash = file.layout_hash;
+    files[i].num_sections = file.section_capacities.size();
+  });
+
+  std::vector<u32> capacities;
+  for (ObjectFile<E> *file : ctx.objs)
+    append(capacities, file->section_capacities);
+
+  IncrementalHeader hdr = {};
+  memcpy(hdr.magic, INCREMENTAL_MAGIC, sizeof(hdr.magic));
+  hdr.layout_hash = ctx.layout_hash;
+  hdr.output_size = st.st_size;
+  hdr.output_mtime = get_mtime(st);
+  hdr.output_ino = st.st_ino;
+  hdr.num_files = files.size();
+  hdr.num_capacities = capacities.size();
+
+  // Write to a temporary file and then rename it, so that an
+  // interrupted link doesn't leave a truncated state file.
+  std::string tmpfile = path_dirname(path) /
+    ("." + path_filename(path) + ".incremental." + std::to_string(getpid()));
+
+  std::ofstream out(tmpfile, std::ios::binary);
+  if (!out.is_open())
+    Fatal(ctx) << "cannot open " << tmpfile << ": " << errno_string();
+
+  out.write((char *)&hdr, sizeof(hdr));
+  out.write((char *)files.data(), files.size() * sizeof(files[0]));
+  out.write((char *)capacities.data(), capacities.size() * sizeof(capacities[0]));
+  out.close();
+
+  if (out.fail()) {
+    unlink(tmpfile.c_str());
+    Fatal(ctx) << tmpfile << ": write failed: " << errno_string();
+  }
+
+  if (rename(tmpfile.c_str(), (path + ".incremental").c_str()) == -1) {
+    unlink(tmpfile.c_str());
+    Fatal(ctx) << path << ".incremental: rename failed: " << errno_string();
+  }
+}
+
+using E = MOLD_TARGET;
+
+template void reserve_incremental_slack(Context<E> &);
+template void prepare_incremental_link(Context<E> &);
+template void write_incremental_state(Context<E> &);
+
+} // namespace mold
@@ -0,0 +1,211 @@
+// This file implements --input-cache.
+//
+// Splitting mergeable sections into fragments and hashing them is one
+// of the most expensive parts of reading input files, because it has
+// to scan every byte of string sections such as .debug_str or
+// .rodata.str1.1. The result depends only on the input file, so for
+// files that don't change between links (e.g. system libraries and
+// third-party archives), we can do the work once and reuse the result.
+//
+// With --input-cache=DIR, we save the fragment offsets, hashes and
+// HyperLogLog ranks of each object file's mergeable sections to a file
+// in DIR. The cache file name is a hash of the object file's identity
+// (its path and its offset in an archive if any) and its contents. On
+// subsequent links, we read them back instead of splitting the sections
+// again. The result of a link is identical whether or not the cache is
+// used.
+//
+// We hash the entire contents of each input file rather than trusting
+// its mtime, because a stale ICF digest would make us merge sections
+// that are not identical. Hashing a file with XXH3 is much cheaper than
+// splitting or digesting its sections.
+//
+// If --icf is given, we also save the digests of the sections' contents
+// and relocations computed by ICF to a separate file in DIR (see
+// icf.cc), so that only modified files are hashed again.
+//
+// Cache files are written atomically, so multiple mold processes can
+// share the same cache directory. Stale entries are never read but are
+// not removed either. It is safe to remove the directory at any time.
+
+#include "mold.h"
+
+#include <fstream>
+#include <tbb/parallel_for_each.h>
+
+#ifndef _WIN32
+# include <unistd.h>
+#endif
+
+namespace mold {
+
+struct InputCacheHeader {
+  char magic[8];
+  u64 key;
+  u32 num_sections;
+  u32 padding;
+};
+
+static constexpr char INPUT_CACHE_MAGIC[8] = {'M', 'O', 'L', 'D', 'I', 'C', 'C', '1'};
+
+// see CMakeLists.txt:mold_instantiate_templates
+#ifdef MOLD_X86_64
+std::string get_input_cache_path(const std::string &dir, u64 key,
+                                 std::string_view suffix) {
+  char name[17];
+  snprintf(name, sizeof(name), "%016llx", (unsigned long long)key);
+  return (std::filesystem::path(dir) / (name + std::string(suffix))).string();
+}
+
+// Write to a temporary file and then rename it, so that other mold
+// processes never see a partially-written cache file. Failing to
+// write a cache file is not an error.
+void write_input_cache_file(const std::string &path, std::span<u8> buf) {
+  std::string tmpfile = path + "." + std::to_string(getpid()) + ".tmp";
+  std::ofstream out(tmpfile, std::ios::binary);
+  if (!out.is_open())
+    return;
+
+  out.write((char *)buf.data(), buf.size());
+  out.close();
+
+  if (out.fail() || rename(tmpfile.c_str(), path.c_str()) == -1)
+    unlink(tmpfile.c_str());
+}
+#endif
+
+// Returns a value identifying the contents of a given file, or 0 if
+// it's not cacheable.
+template <typename E>
+u64 get_input_cache_key(ObjectFile<E> &file) {
+  if (!file.mf)
+    return 0;
+
+  MappedFile *root = file.mf;
+  while (root->parent)
+    root = root->parent;
+
+  if (root->mtime == 0)
+    return 0;
+
+  std::error_code ec;
+  std::filesystem::path path = std::filesystem::absolute(root->name, ec);
+  if (ec)
+    return 0;
+
+  std::string key = get_mold_version() + "\0"s + std::string(E::name) + "\0"s +
+                    path.string() + "\0"s +
+                    std::to_string(file.mf->get_offset()) + "\0"s +
+                    std::to_string(file.mf->size) + "\0"s +
+                    std::to_string(hash_string(file.mf->get_contents()));
+  return std::max<u64>(hash_string(key), 1);
+}
+
+template <typename E>
+static bool read_cache_file(Context<E> &ctx, ObjectFile<E> &file,
+                            const std::string &path, u64 key) {
+  std::string error;
+  std::unique_ptr<MappedFile> mf(open_file_impl(path, error));
+  if (!mf || mf->size < sizeof(InputCacheHeader))
+    return false;
+
+  InputCacheHeader &hdr = *(InputCacheHeader *)mf->data;
+  if (memcmp(hdr.magic, INPUT_CACHE_MAGIC, sizeof(hdr.magic)) ||
+      hdr.key != key)
+    return false;
+
+  // The cache file consists of the header followed by pairs of a
+  // section index and a record written by write_split_contents().
+  // Records are sorted by section index.
+  std::string_view buf = mf->get_contents().substr(sizeof(hdr));
+  i64 last = -1;
+
+  for (i64 i = 0; i < hdr.num_sections; i++) {
+    if (buf.size() < 4)
+      return false;
+
+    u32 shndx = *(u32 *)buf.data();
+    buf = buf.substr(4);
+
+    if (shndx <= last || file.mergeable_sections.size() <= shndx ||
+        !file.mergeable_sections[shndx] ||
+        !file.mergeable_sections[shndx]->read_split_contents(buf))
+      return false;
+    last = shndx;
+  }
+
+  // If the cache file doesn't cover all mergeable sections, the caller
+  // splits the remaining ones and updates the cache file.
+  i64 num_sections = 0;
+  for (std::unique_ptr<MergeableSection<E>> &m : file.mergeable_sections)
+    if (m)
+      num_sections++;
+  return hdr.num_sections == num_sections;
+}
+
+template <typename E>
+static void write_cache_file(Context<E> &ctx, ObjectFile<E> &file,
+                             const std::string &path, u64 key) {
+  InputCacheHeader hdr = {};
+  memcpy(hdr.magic, INPUT_CACHE_MAGIC, sizeof(hdr.magic));
+  hdr.key = key;
+
+  std::vector<u8> buf(sizeof(hdr));
+
+  for (i64 i = 0; i < file.mergeable_sections.size(); i++) {
+    if (MergeableSection<E> *m = file.mergeable_sections[i].get()) {
+      u32 shndx = i;
+      buf.insert(buf.end(), (u8 *)&shndx, (u8 *)&shndx + 4);
+      m->write_split_contents(buf);
+      hdr.num_sections++;
+    }
+  }
+
+  memcpy(buf.data(), &hdr, sizeof(hdr));
+  write_input_cache_file(path, buf);
+}
+
+// Split mergeable sections into fragments using the input cache if
+// possible. This function must be called after mergeable sections are
+// created and before they are resolved.
+template <typename E>
+void apply_input_cache(Context<E> &ctx) {
+  Timer t(ctx, "apply_input_cache");
+
+  std::filesystem::path dir = ctx.arg.input_cache;
+  std::error_code ec;
+  std::filesystem::create_directories(dir, ec);
+  if (ec)
+    Fatal(ctx) << "--input-cache: cannot create directory " << dir.string()
+               << ": " << ec.message();
+
+  tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
+    bool has_mergeable = false;
+    for (std::unique_ptr<MergeableSection<E>> &m : file->mergeable_sections)
+      if (m)
+        has_mergeable = true;
+    if (!has_mergeable)
+      return;
+
+    u64 key = get_input_cache_key(*file);
+    if (key == 0)
+      return;
+
+    std::string path = get_input_cache_path(ctx.arg.input_cache, key, "");
+
+    if (read_cache_file(ctx, *file, path, key))
+      return;
+
+    for (std::unique_ptr<MergeableSection<E>> &m : file->mergeable_sections)
+      if (m)
+        m->split_contents(ctx);
+    write_cache_file(ctx, *file, path, key);
+  });
+}
+
+using E = MOLD_TARGET;
+
+template u64 get_input_cache_key(ObjectFile<E> &);
+template void apply_input_cache(Context<E> &);
+
+} // namespace mold
@@ -10,15 +10,47 @@
 
 namespace mold {
 
+template <typename E>
+Symbol<E> *SymbolMap<E>::insert(std::string_view key, u64 hash,
+                                std::string_view name, bool demangle) {
+  // A key is stored to `map2` if it may have been created before
+  // resize() or if it doesn't fit in `map`. Both conditions depend only
+  // on the key, so the same key always ends up in the same place.
+  if (map.nbuckets && !filter.get((hash >> 32) & (filter_size - 1)))
+    if (Symbol<E> *sym = map.try_insert(key, hash, Symbol<E>(name, demangle)).first)
+      return sym;
+
+  typename decltype(map2)::const_accessor acc;
+  map2.insert(acc, {key, Symbol<E>(name, demangle)});
+  return const_cast<Symbol<E> *>(&acc->second);
+}
+
+// This function must not be called while other threads may call
+// insert().
+template <typename E>
+void SymbolMap<E>::resize(i64 nbuckets) {
+  filter_size = bit_ceil(std::max<i64>(map2.size() * 16, 64));
+  filter.resize(filter_size);
+  for (auto &[key, sym] : map2)
+    filter.set((hash_string(key) >> 32) & (filter_size - 1));
+
+  map.resize(nbuckets);
+}
+
 // If we haven't seen the same `key` before, create a new instance
 // of Symbol and returns it. Otherwise, returns the previously-
-// instantiated object. `key` is usually the same as `name`.
+// instantiated object. `key` is usually the same as `name`, and `hash`
+// is the hash value of `key`.
+template <typename E>
+Symbol<E> *get_symbol(Context<E> &ctx, std::string_view key,
+                      std::string_view name, u64 hash) {
+  return ctx.symbol_map.insert(key, hash, name, ctx.arg.demangle);
+}
+
 template <typename E>
 Symbol<E> *get_symbol(Context<E> &ctx, std::string_view key,
                       std::string_view name) {
-  typename decltype(ctx.symbol_map)::const_accessor acc;
-  ctx.symbol_map.insert(acc, {key, Symbol<E>(name, ctx.arg.demangle)});
-  return const_cast<Symbol<E> *>(&acc->second);
+  return get_symbol(ctx, key, name, hash_string(key));
 }
 
 // https://sourceware.org/binutils/docs/ld/VERSION.html
@@ -277,7 +309,10 @@ void ObjectFile<E>::initialize_sections(Context<E> &ctx) {
     // SHT_LLVM_ADDRSIG Section (address-significance table)
     //    https://llvm.org/docs/Extensions.html
     if ((shdr.sh_flags & SHF_EXCLUDE) && !(shdr.sh_flags & SHF_ALLOC) &&
-        shdr.sh_type != SHT_LLVM_ADDRSIG && !ctx.arg.relocatable)
+        shdr.sh_type != SHT_LLVM_ADDRSIG &&
+        !(shdr.sh_type == SHT_LLVM_CALL_GRAPH_PROFILE &&
+          ctx.arg.call_graph_profile_sort) &&
+        !ctx.arg.relocatable)
       continue;
 
     if constexpr (is_arm<E>)
@@ -414,6 +449,13 @@ void ObjectFile<E>::initialize_sections(Context<E> &ctx) {
         continue;
       }
 
+      // Save .llvm.call-graph-profile for --call-graph-profile-sort.
+      if (shdr.sh_type == SHT_LLVM_CALL_GRAPH_PROFILE &&
+          ctx.arg.call_graph_profile_sort && !ctx.arg.relocatable) {
+        llvm_cg_profile = std::move(this->sections[i]);
+        continue;
+      }
+
       if (shdr.sh_type == SHT_INIT_ARRAY ||
           shdr.sh_type == SHT_FINI_ARRAY ||
           shdr.sh_type == SHT_PREINIT_ARRAY)
@@ -430,13 +472,18 @@ void ObjectFile<E>::initialize_sections(Context<E> &ctx) {
         if (name == ".got2")
           extra.got2 = this->sections[i].get();
 
-      // Save debug sections for --gdb-index.
+      // Save debug sections for --gdb-index and --debug-names.
+      if ((ctx.arg.gdb_index || ctx.arg.debug_names) && name == ".debug_info")
+        debug_info = this->sections[i].get();
+
+      // If --debug-names is given, we create a .debug_names covering
+      // all compunits, so input .debug_names sections are redundant.
+      if (ctx.arg.debug_names && name == ".debug_names")
+        this->sections[i]->is_alive = false;
+
       if (ctx.arg.gdb_index) {
         InputSection<E> *isec = this->sections[i].get();
 
-        if (name == ".debug_info")
-          debug_info = isec;
-
         // If --gdb-index is given, contents of .debug_gnu_pubnames and
         // .debug_gnu_pubtypes are copied to .gdb_index, so keeping them
         // in an output file is just a waste of space.
@@ -470,6 +517,15 @@ void ObjectFile<E>::initialize_sections(Context<E> &ctx) {
   // Attach relocation sections to their target sections.
   for (i64 i = 0; i < this->elf_sections.size(); i++) {
     const ElfShdr<E> &shdr = this->elf_sections[i];
+
+    // LLVM uses SHT_REL for .llvm.call-graph-profile even on RELA
+    // targets, so we accept both types for that section.
+    if (llvm_cg_profile && shdr.sh_info == llvm_cg_profile->shndx &&
+        (shdr.sh_type == SHT_REL || shdr.sh_type == SHT_RELA)) {
+      llvm_cg_profile->relsec_idx = i;
+      continue;
+    }
+
     if (shdr.sh_type != (E::is_rela ? SHT_RELA : SHT_REL))
       continue;
 
@@ -675,7 +731,11 @@ void ObjectFile<E>::initialize_symbols(Context<E> &ctx) {
         ctx.arg.wrap.contains(name.substr(7))) {
       sym = get_symbol(ctx, key.substr(7), name.substr(7));
     } else {
-      sym = get_symbol(ctx, key, name);
+      if (symbol_hashes.empty())
+        sym = get_symbol(ctx, key, name);
+      else
+        sym = get_symbol(ctx, key, name, symbol_hashes[i - this->first_global]);
+
       if (esym.is_undef() && sym->is_wrapped) {
         key = save_string(ctx, "__wrap_" + std::string(key));
         name = save_string(ctx, "__wrap_" + std::string(name));
@@ -685,6 +745,9 @@ void ObjectFile<E>::initialize_symbols(Context<E> &ctx) {
 
     this->symbols[i] = sym;
   }
+
+  symbol_hashes.clear();
+  symbol_hashes.shrink_to_fit();
 }
 
 // Relocations are usually sorted by r_offset in relocation tables,
@@ -860,6 +923,31 @@ void ObjectFile<E>::reattach_section_pieces(Context<E> &ctx) {
     this->symbols.push_back(&sym);
 }
 
+// Compute hash values of global symbol keys for initialize_symbols()
+// and add them to the estimator of the number of distinct symbols.
+// Symbols are not registered to the symbol table until
+// initialize_symbols() is called.
+template <typename E>
+void ObjectFile<E>::compute_symbol_hashes(Context<E> &ctx) {
+  if (this->elf_syms.empty())
+    return;
+
+  symbol_hashes.resize(this->elf_syms.size() - this->first_global);
+
+  for (i64 i = this->first_global; i < this->elf_syms.size(); i++) {
+    std::string_view key = this->symbol_strtab.data() + this->elf_syms[i].st_name;
+
+    // See initialize_symbols() for how versioned symbols are handled
+    if (i64 pos = key.find('@'); pos != key.npos)
+      if (std::string_view ver = key.substr(pos); ver != "@@" && ver.starts_with("@@"))
+        key = key.substr(0, pos);
+
+    u64 hash = hash_string(key);
+    symbol_hashes[i - this->first_global] = hash;
+    ctx.symbol_map.estimator.insert(hash);
+  }
+}
+
 template <typename E>
 void ObjectFile<E>::parse(Context<E> &ctx) {
   sections.resize(this->elf_sections.size());
@@ -891,7 +979,7 @@ void ObjectFile<E>::parse(Context<E> &ctx) {
   }
 
   initialize_sections(ctx);
-  initialize_symbols(ctx);
+  compute_symbol_hashes(ctx);
   sort_relocations(ctx);
 
   // R_ARM_TARGET1 is typically used for entries in .init_array and may
@@ -1048,10 +1136,16 @@ ObjectFile<E>::mark_live_objects(Context<E> &ctx,
 template <typename E>
 void ObjectFile<E>::scan_relocations(Context<E> &ctx) {
   // Scan relocations against seciton contents
+  if constexpr (has_reloc_program<E>)
+    reloc_slots.resize(this->symbols.size(), -1);
+
   for (std::unique_ptr<InputSection<E>> &isec : sections)
     if (isec && isec->is_alive && (isec->shdr().sh_flags & SHF_ALLOC))
       isec->scan_relocations(ctx);
 
+  if constexpr (has_reloc_program<E>)
+    reloc_slots = {};
+
   // Scan relocations against exception frames
   for (CieRecord<E> &cie : cies) {
     for (ElfRel<E> &rel : cie.get_rels()) {
@@ -1291,13 +1385,17 @@ void SharedFile<E>::parse(Context<E> &ctx) {
     this->elf_syms2.push_back(esyms[i]);
     this->versyms.push_back(ver);
 
-    if (is_default) {
-      this->symbols.push_back(get_symbol(ctx, name));
-    } else {
-      std::string_view mangled_name = save_string(
+    std::string_view key = name;
+    if (!is_default)
+      key = save_string(
         ctx, std::string(name) + "@" + std::string(version_strings[ver]));
-      this->symbols.push_back(get_symbol(ctx, mangled_name, name));
-    }
+
+    // Symbols are registered to the symbol table later by
+    // initialize_symbols().
+    u64 hash = hash_string(key);
+    symbol_keys.push_back(key);
+    symbol_hashes.push_back(hash);
+    ctx.symbol_map.estimator.insert(hash);
   }
 
   this->elf_syms = elf_syms2;
@@ -1307,6 +1405,21 @@ void SharedFile<E>::parse(Context<E> &ctx) {
   counter += this->elf_syms.size();
 }
 
+template <typename E>
+void SharedFile<E>::initialize_symbols(Context<E> &ctx) {
+  this->symbols.resize(symbol_keys.size());
+
+  for (i64 i = 0; i < symbol_keys.size(); i++) {
+    std::string_view name = this->symbol_strtab.data() + this->elf_syms[i].st_name;
+    this->symbols[i] = get_symbol(ctx, symbol_keys[i], name, symbol_hashes[i]);
+  }
+
+  symbol_keys.clear();
+  symbol_keys.shrink_to_fit();
+  symbol_hashes.clear();
+  symbol_hashes.shrink_to_fit();
+}
+
 template <typename E>
 std::vector<std::string_view> SharedFile<E>::get_dt_needed(Context<E> &ctx) {
   // Get the contents of the dynamic segment
@@ -1536,6 +1649,8 @@ using E = MOLD_TARGET;
 template class InputFile<E>;
 template class ObjectFile<E>;
 template class SharedFile<E>;
+template class SymbolMap<E>;
+template Symbol<E> *get_symbol(Context<E> &, std::string_view, std::string_view, u64);
 template Symbol<E> *get_symbol(Context<E> &, std::string_view, std::string_view);
 template Symbol<E> *get_symbol(Context<E> &, std::string_view);
 template std::string_view demangle(const Symbol<E> &);
@@ -276,6 +276,50 @@ void InputSection<E>::write_to(Context<E> &ctx, u8 *buf) {
   }
 }
 
+// Applies relocations compiled by scan_relocations(). Returns false if
+// a relocated value is out of range, in which case the caller should
+// apply all relocations with the relocation switch to report errors.
+template <typename E>
+bool InputSection<E>::apply_reloc_program(Context<E> &ctx, u8 *base) {
+  if constexpr (has_reloc_program<E>) {
+    RelocProgram &prog = *extra.reloc_program;
+    u64 *addrs = file.reloc_addrs.data();
+    u64 addr = get_addr();
+    bool ok = true;
+
+    auto get_ops = [&](RelocOpKind kind) {
+      return std::span(prog.ops.data() + prog.begin[kind],
+                       prog.ops.data() + prog.begin[kind + 1]);
+    };
+
+    for (RelocOp &op : get_ops(RELOC_OP_ABS32)) {
+      i64 val = addrs[op.slot] + op.addend;
+      ok &= ((u64)val >> 32) == 0;
+      *(U32<E> *)(base + op.offset) = val;
+    }
+
+    for (RelocOp &op : get_ops(RELOC_OP_ABS32S)) {
+      i64 val = addrs[op.slot] + op.addend;
+      ok &= (val == (i32)val);
+      *(U32<E> *)(base + op.offset) = val;
+    }
+
+    for (RelocOp &op : get_ops(RELOC_OP_PC32)) {
+      i64 val = addrs[op.slot] + op.addend - addr - op.offset;
+      ok &= (val == (i32)val);
+      *(U32<E> *)(base + op.offset) = val;
+    }
+
+    for (RelocOp &op : get_ops(RELOC_OP_PC64)) {
+      i64 val = addrs[op.slot] + op.addend - addr - op.offset;
+      *(U64<E> *)(base + op.offset) = val;
+    }
+    return ok;
+  } else {
+    unreachable();
+  }
+}
+
 // Get the name of a function containin a given offset.
 template <typename E>
 std::string_view
@@ -364,17 +408,6 @@ MergeableSection<E>::MergeableSection(Context<E> &ctx, MergedSection<E> &parent,
   parent.members.push_back(this);
 }
 
-static size_t find_null(std::string_view data, i64 pos, i64 entsize) {
-  if (entsize == 1)
-    return data.find('\0', pos);
-
-  for (; pos <= data.size() - entsize; pos += entsize)
-    if (data.substr(pos, entsize).find_first_not_of('\0') == data.npos)
-      return pos;
-
-  return data.npos;
-}
-
 // Mergeable sections (sections with SHF_MERGE bit) typically contain
 // string literals. Linker is expected to split the section contents
 // into null-terminated strings, merge them with mergeable strings
@@ -394,6 +427,10 @@ static size_t find_null(std::string_view data, i64 pos, i64 entsize) {
 // We do not support mergeable sections that have relocations.
 template <typename E>
 void MergeableSection<E>::split_contents(Context<E> &ctx) {
+  // The contents may have already been split by apply_input_cache().
+  if (!frag_offsets.empty())
+    return;
+
   std::string_view data = section->contents;
   if (data.size() > UINT32_MAX)
     Fatal(ctx) << *section
@@ -403,13 +440,9 @@ void MergeableSection<E>::split_contents(Context<E> &ctx) {
 
   // Split sections
   if (parent.shdr.sh_flags & SHF_STRINGS) {
-    for (i64 pos = 0; pos < data.size();) {
-      frag_offsets.push_back(pos);
-      size_t end = find_null(data, pos, entsize);
-      if (end == data.npos)
-        Fatal(ctx) << *section << ": string is not null terminated";
-      pos = end + entsize;
-    }
+    // split_strings() uses SIMD instructions if available.
+    if (!split_strings(data, entsize, frag_offsets))
+      Fatal(ctx) << *section << ": string is not null terminated";
   } else {
     if (data.size() % entsize)
       Fatal(ctx) << *section << ": section size is not multiple of sh_entsize";
@@ -421,12 +454,27 @@ void MergeableSection<E>::split_contents(Context<E> &ctx) {
 
   // Compute hashes for section pieces
   HyperLogLog estimator;
+
+  // We record the HyperLogLog ranks of the hashes so that we can save
+  // the result of this function to the input cache. See input-cache.cc.
+  bool record_ranks = !ctx.arg.input_cache.empty();
+  if (record_ranks)
+    ranks.reserve(frag_offsets.size());
+
+  // Hash fragments in batches. See hash_strings().
   hashes.reserve(frag_offsets.size());
+  u64 buf[256];
+
+  for (i64 i = 0; i < frag_offsets.size(); i += std::size(buf)) {
+    i64 end = std::min<i64>(i + std::size(buf), frag_offsets.size());
+    hash_strings(data, frag_offsets, i, end, buf);
 
-  for (i64 i = 0; i < frag_offsets.size(); i++) {
-    u64 hash = hash_string(get_contents(i));
-    hashes.push_back(hash);
-    estimator.insert(hash);
+    for (u64 hash : std::span(buf, end - i)) {
+      hashes.push_back(hash);
+      estimator.insert(hash);
+      if (record_ranks)
+        ranks.push_back(HyperLogLog::get_rank(hash));
+    }
   }
 
   parent.estimator.merge(estimator);
@@ -441,9 +489,69 @@ void MergeableSection<E>::resolve_contents(Context<E> &ctx) {
   for (i64 i = 0; i < frag_offsets.size(); i++)
     fragments.push_back(parent.insert(ctx, get_contents(i), hashes[i], p2align));
 
-  // Reclaim memory as we'll never use this vector again
+  // Reclaim memory as we'll never use these vectors again
   hashes.clear();
   hashes.shrink_to_fit();
+  ranks.clear();
+  ranks.shrink_to_fit();
+}
+
+// Serialize the result of split_contents(). A record consists of the
+// number of fragments followed by their offsets, hashes and HyperLogLog
+// ranks, padded to a multiple of 4 bytes.
+template <typename E>
+void MergeableSection<E>::write_split_contents(std::vector<u8> &buf) {
+  assert(ranks.size() == frag_offsets.size());
+
+  auto write = [&](const void *p, i64 size) {
+    buf.insert(buf.end(), (u8 *)p, (u8 *)p + size);
+  };
+
+  u32 num_frags = frag_offsets.size();
+  write(&num_frags, 4);
+  write(frag_offsets.data(), num_frags * 4);
+  write(hashes.data(), num_frags * 4);
+  write(ranks.data(), num_frags);
+  buf.resize(align_to(buf.size(), 4));
+}
+
+// Restore the result of split_contents() from a record written by
+// write_split_contents(). Returns false if the record is corrupted or
+// does not match the section contents.
+template <typename E>
+bool MergeableSection<E>::read_split_contents(std::string_view &buf) {
+  if (buf.size() < 4)
+    return false;
+
+  u32 num_frags = *(u32 *)buf.data();
+  i64 size = align_to(4 + num_frags * 9LL, 4);
+  if (num_frags == 0 || buf.size() < size)
+    return false;
+
+  u32 *offsets = (u32 *)(buf.data() + 4);
+  u32 *hash_vals = offsets + num_frags;
+  u8 *rank_vals = (u8 *)(hash_vals + num_frags);
+
+  // Make sure that fragments are within the section
+  i64 entsize = parent.shdr.sh_entsize;
+  std::string_view data = section->contents;
+  if (offsets[0] != 0 || data.size() < offsets[num_frags - 1] + entsize)
+    return false;
+  for (i64 i = 1; i < num_frags; i++)
+    if (offsets[i] <= offsets[i - 1])
+      return false;
+
+  frag_offsets.assign(offsets, offsets + num_frags);
+  hashes.assign(hash_vals, hash_vals + num_frags);
+  ranks.assign(rank_vals, rank_vals + num_frags);
+
+  HyperLogLog estimator;
+  for (i64 i = 0; i < num_frags; i++)
+    estimator.insert(hash_vals[i], rank_vals[i]);
+  parent.estimator.merge(estimator);
+
+  buf = buf.substr(size);
+  return true;
 }
 
 using E = MOLD_TARGET;
@@ -185,6 +185,7 @@ static PluginStatus add_input_file(const char *path) {
   file->priority = file_priority++;
   file->is_alive = true;
   file->parse(ctx);
+  file->initialize_symbols(ctx);
   file->resolve_symbols(ctx);
   return LDPS_OK;
 }
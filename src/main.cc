@@ -50,7 +50,8 @@ check_file_compatibility(Context<E> &ctx, ReaderContext &rctx, MappedFile *mf) {
 
 template <typename E>
 static ObjectFile<E> *new_object_file(Context<E> &ctx, ReaderContext &rctx,
-                                      MappedFile *mf, std::string archive_name) {
+                                      MappedFile *mf, std::string archive_name,
+                                      i64 priority) {
   static Counter count("parsed_objs");
   count++;
 
@@ -60,10 +61,13 @@ static ObjectFile<E> *new_object_file(Context<E> &ctx, ReaderContext &rctx,
 
   ObjectFile<E> *file = new ObjectFile<E>(ctx, mf, archive_name, in_lib);
   ctx.obj_pool.emplace_back(file);
-  file->priority = ctx.file_priority++;
+  file->priority = priority;
 
   // https://oneapi-src.github.io/oneTBB/main/reference/task_group_extensions.html
-  rctx.tg->run([file, &ctx] { file->parse(ctx); });
+  rctx.tg->run([file, &ctx] {
+    TaskTimer t(ctx, file->filename);
+    file->parse(ctx);
+  });
   if (ctx.arg.trace)
     Out(ctx) << "trace: " << *file;
   return file;
@@ -98,27 +102,104 @@ new_shared_file(Context<E> &ctx, ReaderContext &rctx, MappedFile *mf) {
   file->priority = ctx.file_priority++;
   file->is_alive = !rctx.as_needed;
 
-  rctx.tg->run([file, &ctx] { file->parse(ctx); });
+  rctx.tg->run([file, &ctx] {
+    TaskTimer t(ctx, file->filename);
+    file->parse(ctx);
+  });
   if (ctx.arg.trace)
     Out(ctx) << "trace: " << *file;
   return file;
 }
 
+// Most members of a large static archive are usually not needed to
+// link a program, so we don't want to parse all of them. Instead, we
+// read the archive symbol table and register the members as lazy
+// members, which are parsed by load_lazy_members() only when some
+// other file refers to a symbol they define.
+//
+// Returns false if the archive cannot be read lazily, in which case
+// the caller reads all members eagerly.
+template <typename E>
+static bool read_lazy_archive(Context<E> &ctx, ReaderContext &rctx,
+                              MappedFile *mf, std::span<MappedFile *> members,
+                              std::span<u64> hdr_offsets) {
+  if (rctx.whole_archive)
+    return false;
+
+  std::vector<ArSymbol> syms = read_archive_symtab(mf);
+  if (syms.empty())
+    return false;
+
+  // LTO IR members need to be claimed by the LTO plugin when read, so
+  // we don't read archives containing them lazily.
+  std::vector<FileType> types;
+  for (MappedFile *child : members) {
+    FileType type = get_file_type(ctx, child);
+    if (type == FileType::GCC_LTO_OBJ || type == FileType::LLVM_BITCODE)
+      return false;
+    types.push_back(type);
+  }
+
+  std::unordered_map<u64, i64> index;
+  for (i64 i = 0; i < members.size(); i++)
+    index[hdr_offsets[i]] = i;
+
+  // A symbol table that doesn't match the members is likely to be
+  // stale, so we don't trust it.
+  for (ArSymbol &sym : syms)
+    if (!index.contains(sym.offset))
+      return false;
+
+  std::vector<LazyArchiveMember *> vec(members.size());
+
+  for (i64 i = 0; i < members.size(); i++) {
+    if (types[i] == FileType::ELF_OBJ) {
+      LazyArchiveMember *m = new LazyArchiveMember;
+      ctx.lazy_members.emplace_back(m);
+      m->mf = members[i];
+      m->archive_name = mf->name;
+      m->priority = ctx.file_priority++;
+      vec[i] = m;
+    } else if (types[i] == FileType::ELF_DSO) {
+      Warn(ctx) << mf->name << "(" << members[i]->name
+                << "): shared object file in an archive is ignored";
+    }
+  }
+
+  // Symbol names may have version strings (e.g. "foo@@VERSION"), but
+  // we look them up by names without versions.
+  for (ArSymbol &sym : syms) {
+    if (LazyArchiveMember *m = vec[index[sym.offset]]) {
+      std::string_view name = sym.name.substr(0, sym.name.find('@'));
+      ctx.lazy_syms[name].push_back(m);
+    }
+  }
+  return true;
+}
+
 template <typename E>
 void read_file(Context<E> &ctx, ReaderContext &rctx, MappedFile *mf) {
   switch (get_file_type(ctx, mf)) {
   case FileType::ELF_OBJ:
-    ctx.objs.push_back(new_object_file(ctx, rctx, mf, ""));
+    ctx.objs.push_back(new_object_file(ctx, rctx, mf, "", ctx.file_priority++));
     return;
   case FileType::ELF_DSO:
     ctx.dsos.push_back(new_shared_file(ctx, rctx, mf));
     return;
   case FileType::AR:
-  case FileType::THIN_AR:
-    for (MappedFile *child : read_archive_members(ctx, mf)) {
+  case FileType::THIN_AR: {
+    std::vector<u64> hdr_offsets;
+    std::vector<MappedFile *> members =
+      read_archive_members(ctx, mf, &hdr_offsets);
+
+    if (read_lazy_archive(ctx, rctx, mf, members, hdr_offsets))
+      return;
+
+    for (MappedFile *child : members) {
       switch (get_file_type(ctx, child)) {
       case FileType::ELF_OBJ:
-        ctx.objs.push_back(new_object_file(ctx, rctx, child, mf->name));
+        ctx.objs.push_back(new_object_file(ctx, rctx, child, mf->name,
+                                           ctx.file_priority++));
         break;
       case FileType::GCC_LTO_OBJ:
       case FileType::LLVM_BITCODE:
@@ -134,6 +215,7 @@ void read_file(Context<E> &ctx, ReaderContext &rctx, MappedFile *mf) {
       }
     }
     return;
+  }
   case FileType::TEXT:
     Script(ctx, rctx, mf).parse_linker_script();
     return;
@@ -318,10 +400,116 @@ static void read_input_files(Context<E> &ctx, std::span<std::string> args) {
     }
   }
 
-  if (ctx.objs.empty())
+  if (ctx.objs.empty() && ctx.lazy_members.empty())
     Fatal(ctx) << "no input files";
 
   tg.wait();
+
+  // Now that we have an estimate of the number of distinct symbols,
+  // create the symbol table and register symbols to it. We leave room
+  // for symbols of archive members that will be loaded lazily. IR
+  // object files have already registered their symbols.
+  ctx.symbol_map.resize(ctx.symbol_map.estimator.get_cardinality() * 2);
+
+  tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
+    if (!file->is_lto_obj)
+      file->initialize_symbols(ctx);
+  });
+
+  tbb::parallel_for_each(ctx.dsos, [&](SharedFile<E> *file) {
+    file->initialize_symbols(ctx);
+  });
+
+  load_lazy_members(ctx);
+}
+
+// Parse lazy archive members that may be extracted by symbol resolution.
+//
+// An archive member is extracted if a live file has a non-weak
+// undefined symbol or a common symbol that is resolved to the member,
+// or if the member defines a symbol given by -u, --require-defined or
+// --undefined-glob. So it is safe to leave a member unparsed as long as
+// none of the parsed files refers to any symbol the member defines.
+// We parse all members defining any symbol referred to by a parsed file
+// until we reach a fixed point. That may parse more members than will
+// be extracted, but since all candidates for each referred symbol are
+// parsed, mark_live_objects() chooses exactly the same members as it
+// would if we read all archive members eagerly.
+template <typename E>
+void load_lazy_members(Context<E> &ctx) {
+  if (ctx.lazy_syms.empty())
+    return;
+
+  Timer t(ctx, "load_lazy_members");
+
+  tbb::concurrent_vector<LazyArchiveMember *> queue;
+
+  auto visit = [&](std::string_view name) {
+    if (auto it = ctx.lazy_syms.find(name); it != ctx.lazy_syms.end())
+      for (LazyArchiveMember *m : it->second)
+        if (!m->is_loaded.exchange(true))
+          queue.push_back(m);
+  };
+
+  auto scan = [&](InputFile<E> *file) {
+    for (i64 i = file->first_global; i < file->elf_syms.size(); i++) {
+      const ElfSym<E> &esym = file->elf_syms[i];
+      if ((esym.is_undef() && !esym.is_weak()) || esym.is_common())
+        visit(file->symbols[i]->name());
+    }
+  };
+
+  for (Symbol<E> *sym : ctx.arg.undefined)
+    visit(sym->name());
+  for (Symbol<E> *sym : ctx.arg.require_defined)
+    visit(sym->name());
+
+  if (!ctx.arg.undefined_glob.empty())
+    for (auto &[name, members] : ctx.lazy_syms)
+      if (ctx.arg.undefined_glob.find(name))
+        visit(name);
+
+  tbb::parallel_for_each(ctx.objs, scan);
+  tbb::parallel_for_each(ctx.dsos, scan);
+
+  std::vector<ObjectFile<E> *> loaded;
+  tbb::task_group tg;
+  ReaderContext rctx;
+  rctx.tg = &tg;
+
+  while (!queue.empty()) {
+    std::vector<LazyArchiveMember *> members(queue.begin(), queue.end());
+    queue.clear();
+
+    sort(members, [](LazyArchiveMember *a, LazyArchiveMember *b) {
+      return a->priority < b->priority;
+    });
+
+    std::vector<ObjectFile<E> *> files;
+    for (LazyArchiveMember *m : members)
+      files.push_back(new_object_file(ctx, rctx, m->mf, m->archive_name,
+                                      m->priority));
+    tg.wait();
+
+    tbb::parallel_for_each(files, [&](ObjectFile<E> *file) {
+      file->initialize_symbols(ctx);
+      scan(file);
+    });
+    append(loaded, files);
+  }
+
+  // Insert the new files so that input files are sorted by priority
+  // as if all archive members were read eagerly. Files created by the
+  // linker itself, such as the internal file or LTO results, have
+  // smaller priorities and stay at the end.
+  auto it = std::find_if(ctx.objs.begin(), ctx.objs.end(),
+                         [](ObjectFile<E> *file) { return file->priority < 10000; });
+  it = ctx.objs.insert(it, loaded.begin(), loaded.end());
+
+  std::stable_sort(ctx.objs.begin(), it + loaded.size(),
+                   [](ObjectFile<E> *a, ObjectFile<E> *b) {
+    return a->priority < b->priority;
+  });
 }
 
 template <typename E>
@@ -477,6 +665,10 @@ int mold_main(int argc, char **argv) {
   if (ctx.arg.icf)
     icf_sections(ctx);
 
+  // Remove debug info for functions that don't exist in the output.
+  if (ctx.arg.gc_debug_info)
+    gc_debug_info(ctx);
+
   // Create linker-synthesized sections such as .got or .plt.
   create_synthetic_sections(ctx);
 
@@ -556,6 +748,18 @@ int mold_main(int argc, char **argv) {
   // we need to reverse their contents.
   fixup_ctors_in_init_array(ctx);
 
+  // Handle --symbol-ordering-file and --call-graph-profile-sort. As is
+  // the case with lld, the former takes precedence over the latter.
+  if (ctx.arg.symbol_ordering_file)
+    sort_sections_by_symbol_order(ctx);
+  else if (ctx.arg.call_graph_profile_sort)
+    sort_sections_by_call_graph(ctx);
+
+  // Handle --data-access-trace. This is applied after the above so that
+  // the trace takes precedence for data sections.
+  if (!ctx.arg.data_access_trace.empty())
+    sort_sections_by_data_access_trace(ctx);
+
   // Handle --shuffle-sections
   if (ctx.arg.shuffle_sections != SHUFFLE_SECTIONS_NONE)
     shuffle_sections(ctx);
@@ -589,6 +793,11 @@ int mold_main(int argc, char **argv) {
   if (!ctx.arg.separate_debug_file.empty())
     separate_debug_sections(ctx);
 
+  // If --incremental is given, reserve space after input sections so
+  // that they can grow without changing the layout on the next link.
+  if (ctx.arg.incremental)
+    reserve_incremental_slack(ctx);
+
   // Compute sizes of output sections while assigning offsets
   // within an output section to input sections.
   compute_section_sizes(ctx);
@@ -625,6 +834,10 @@ int mold_main(int argc, char **argv) {
   // Here, we construct output .eh_frame contents.
   ctx.eh_frame->construct(ctx);
 
+  // Read names for .gdb_index so that we can reserve space for it.
+  if (ctx.gdb_index)
+    ctx.gdb_index->construct(ctx);
+
   // If --emit-relocs is given, we'll copy relocation sections from input
   // files to an output file.
   if (ctx.arg.emit_relocs)
@@ -660,6 +873,9 @@ int mold_main(int argc, char **argv) {
   // Beyond this, you can assume that symbol addresses including their
   // GOT or PLT addresses have a correct final value.
 
+  // Compute addresses of symbols referred to by relocation programs.
+  compute_reloc_addrs(ctx);
+
   // If --compress-debug-sections is given, compress .debug_* sections
   // using zlib.
   if (ctx.arg.compress_debug_sections != COMPRESS_NONE) {
@@ -669,6 +885,11 @@ int mold_main(int argc, char **argv) {
 
   // At this point, both memory and file layouts are fixed.
 
+  // If --incremental is given, compare the layout with the one recorded
+  // by the previous link to see if we can reuse the existing output.
+  if (ctx.arg.incremental)
+    prepare_incremental_link(ctx);
+
   t_before_copy.stop();
 
   // Create an output file
@@ -700,6 +921,10 @@ int mold_main(int argc, char **argv) {
   if (ctx.gdb_index && ctx.arg.separate_debug_file.empty())
     write_gdb_index(ctx);
 
+  // Likewise, write the .debug_names section.
+  if (ctx.debug_names && ctx.arg.separate_debug_file.empty())
+    write_debug_names(ctx);
+
   if (!ctx.arg.separate_debug_file.empty())
     write_gnu_debuglink(ctx);
 
@@ -709,6 +934,10 @@ int mold_main(int argc, char **argv) {
   // Close the output file. This is the end of the linker's main job.
   ctx.output_file->close(ctx);
 
+  // Record the layout for the next --incremental link.
+  if (ctx.arg.incremental)
+    write_incremental_state(ctx);
+
   // Handle --dependency-file
   if (!ctx.arg.dependency_file.empty())
     write_dependency_file(ctx);
@@ -731,6 +960,9 @@ int mold_main(int argc, char **argv) {
   if (ctx.arg.perf)
     print_timer_records(ctx.timer_records);
 
+  if (!ctx.arg.perf_trace.empty())
+    write_perf_trace(ctx);
+
   std::cout << std::flush;
   std::cerr << std::flush;
 
@@ -750,5 +982,6 @@ int mold_main(int argc, char **argv) {
 using E = MOLD_TARGET;
 
 template int mold_main<E>(int, char **);
+template void load_lazy_members(Context<E> &);
 
 } // namespace mold
@@ -3,6 +3,7 @@
 #include "../lib/common.h"
 #include "elf.h"
 
+#include <array>
 #include <atomic>
 #include <bitset>
 #include <cassert>
@@ -74,6 +75,10 @@ struct __attribute__((aligned(4))) SectionFragment {
   u32 offset = -1;
   Atomic<u8> p2align = 0;
   Atomic<bool> is_alive = false;
+
+  // True if this string is stored as a suffix of another string.
+  // Set only with --tail-merge-strings.
+  bool is_tail = false;
 };
 
 // Additional class members for dynamic symbols. Because most symbols
@@ -255,6 +260,47 @@ struct InputSectionExtras<E> {
   std::vector<i32> r_deltas;
 };
 
+// On targets that support it, InputSection::scan_relocations() compiles
+// relocations of an allocated section into a RelocProgram, so that
+// apply_reloc_alloc() doesn't have to decode ElfRel records, look up
+// symbols and dispatch on relocation types again.
+//
+// Each operation refers to its symbol by a slot in the file's
+// `reloc_addrs`, which is filled once the layout is fixed. Operations
+// of the same kind are stored contiguously, so that each kind is
+// applied by its own tight loop. Relocations that need more than
+// storing S + A or S + A - P (e.g. GOT or TLS relocations) are listed
+// in `generic` and applied by the target's relocation switch.
+template <typename E> concept has_reloc_program = is_x86_64<E>;
+
+enum RelocOpKind : u8 {
+  RELOC_OP_ABS32,       // S + A as a zero-extended 32-bit value
+  RELOC_OP_ABS32S,      // S + A as a sign-extended 32-bit value
+  RELOC_OP_PC32,        // S + A - P as a sign-extended 32-bit value
+  RELOC_OP_PC64,        // S + A - P as a 64-bit value
+  NUM_RELOC_OPS,
+  RELOC_OP_SKIP = NUM_RELOC_OPS, // Not applied by apply_reloc_alloc()
+  RELOC_OP_GENERIC,              // Applied by the relocation switch
+  RELOC_OP_UNSUPPORTED,          // The section can't be compiled
+};
+
+struct RelocOp {
+  u32 offset;
+  u32 slot;
+  i32 addend;
+};
+
+struct RelocProgram {
+  std::vector<RelocOp> ops;
+  std::array<u32, NUM_RELOC_OPS + 1> begin = {};
+  std::vector<u32> generic;
+};
+
+template <typename E> requires has_reloc_program<E>
+struct InputSectionExtras<E> {
+  std::unique_ptr<RelocProgram> reloc_program;
+};
+
 // InputSection represents a section in an input object file.
 template <typename E>
 class __attribute__((aligned(4))) InputSection {
@@ -267,11 +313,13 @@ public:
   void write_to(Context<E> &ctx, u8 *buf);
   void apply_reloc_alloc(Context<E> &ctx, u8 *base);
   void apply_reloc_nonalloc(Context<E> &ctx, u8 *base);
+  bool apply_reloc_program(Context<E> &ctx, u8 *base);
   void kill();
 
   std::string_view name() const;
   i64 get_priority() const;
   u64 get_addr() const;
+  i64 get_capacity() const;
   const ElfShdr<E> &shdr() const;
   std::span<ElfRel<E>> get_rels(Context<E> &ctx) const;
   std::span<FdeRecord<E>> get_fdes() const;
@@ -872,9 +920,15 @@ public:
   bool resolved = false;
 
 private:
+  using Entry = typename ConcurrentMap<SectionFragment<E>>::Entry;
+
   MergedSection(std::string_view name, i64 flags, i64 type, i64 entsize);
+  void tail_merge(Context<E> &ctx);
 
   std::vector<i64> shard_offsets;
+
+  // Pairs of a tail-merged string and the string containing it
+  std::vector<std::pair<Entry *, Entry *>> tails;
 };
 
 template <typename E>
@@ -1009,6 +1063,13 @@ public:
   void copy_buf(Context<E> &ctx) override;
 
   std::vector<u8> contents;
+
+  // For a hash-based build-id, the output file is hashed in shards while
+  // copy_chunks() is running. `shard_refcnt[i]` is the number of chunks
+  // overlapping with the i'th shard that have not been written yet.
+  std::vector<std::span<u8>> shards;
+  std::vector<u8> shard_hashes;
+  std::vector<Atomic<i32>> shard_refcnt;
 };
 
 template <typename E>
@@ -1068,6 +1129,61 @@ public:
     this->shdr.sh_type = SHT_PROGBITS;
     this->shdr.sh_addralign = 4;
   }
+
+  void construct(Context<E> &ctx);
+  void update_shdr(Context<E> &ctx) override;
+  void copy_buf(Context<E> &ctx) override;
+
+  struct NameType {
+    bool operator==(const NameType &) const = default;
+
+    bool operator<(const NameType &other) const {
+      return std::tuple(hash, type, name) <
+             std::tuple(other.hash, other.type, other.name);
+    }
+
+    std::string_view name;
+    u64 hash;
+    u8 type;
+  };
+
+  struct MapValue {
+    u32 gdb_hash = 0;
+    Atomic<u32> count;
+    Atomic<u32> cursor;
+    u32 name_offset = 0;
+    u32 type_offset = 0;
+  };
+
+  // Names read from a .debug_gnu_pubnames or .debug_gnu_pubtypes record
+  // for the compunit at `debug_info_offset` of a given file.
+  struct Pubnames {
+    ObjectFile<E> *file;
+    u64 debug_info_offset;
+    std::vector<NameType> nametypes;
+    std::vector<MapValue *> entries;
+  };
+
+  using Entry = typename ConcurrentMap<MapValue>::Entry;
+
+  ConcurrentMap<MapValue> map;
+  std::vector<Pubnames> pubnames;
+  std::vector<Entry *> entries;
+
+  i64 num_cus = 0;
+  i64 max_ranges = 0;
+  i64 symtab_size = 0;
+  i64 const_pool_size = 0;
+};
+
+template <typename E>
+class DebugNamesSection : public Chunk<E> {
+public:
+  DebugNamesSection() {
+    this->name = ".debug_names";
+    this->shdr.sh_type = SHT_PROGBITS;
+    this->shdr.sh_addralign = 4;
+  }
 };
 
 template <typename E>
@@ -1142,17 +1258,32 @@ public:
   virtual void close(Context<E> &ctx) = 0;
   virtual ~OutputFile() = default;
 
+  // Called when a given range of `buf` has its final contents. An
+  // output file that doesn't write `buf` directly to the file may use
+  // it to start writing the range in the background.
+  virtual void write_behind(Context<E> &ctx, i64 offset, i64 size) {}
+
   u8 *buf = nullptr;
   std::vector<u8> buf2;
   std::string path;
   int fd = -1;
   i64 filesize = 0;
+
+  // The size of `buf`. `filesize` may be reduced after `buf` is
+  // allocated if the end of the buffer turns out to be unused, in
+  // which case the file is truncated when closed.
+  i64 bufsize = 0;
   bool is_mmapped = false;
   bool is_unmapped = false;
 
+  // True if an existing output file was reused, in which case `buf`
+  // initially contains the previous link result.
+  bool is_reused = false;
+
 protected:
   OutputFile(std::string path, i64 filesize, bool is_mmapped)
-    : path(path), filesize(filesize), is_mmapped(is_mmapped) {}
+    : path(path), filesize(filesize), bufsize(filesize),
+      is_mmapped(is_mmapped) {}
 };
 
 template <typename E>
@@ -1211,6 +1342,34 @@ public:
 
 template <typename E> void write_gdb_index(Context<E> &ctx);
 
+template <typename E>
+std::span<u8> get_buffer(Context<E> &ctx, Chunk<E> *chunk);
+
+//
+// debug-names.cc
+//
+
+template <typename E> void write_debug_names(Context<E> &ctx);
+
+//
+// incremental.cc
+//
+
+template <typename E> void reserve_incremental_slack(Context<E> &ctx);
+template <typename E> void prepare_incremental_link(Context<E> &ctx);
+template <typename E> void write_incremental_state(Context<E> &ctx);
+
+//
+// input-cache.cc
+//
+
+template <typename E> u64 get_input_cache_key(ObjectFile<E> &file);
+template <typename E> void apply_input_cache(Context<E> &ctx);
+
+std::string get_input_cache_path(const std::string &dir, u64 key,
+                                 std::string_view suffix);
+void write_input_cache_file(const std::string &path, std::span<u8> buf);
+
 //
 // input-files.cc
 //
@@ -1249,6 +1408,10 @@ public:
   std::pair<SectionFragment<E> *, i64> get_fragment(i64 offset);
   std::string_view get_contents(i64 idx);
 
+  // For --input-cache
+  void write_split_contents(std::vector<u8> &buf);
+  bool read_split_contents(std::string_view &buf);
+
   MergedSection<E> &parent;
   std::vector<SectionFragment<E> *> fragments;
 
@@ -1256,6 +1419,7 @@ private:
   std::unique_ptr<InputSection<E>> section;
   std::vector<u32> frag_offsets;
   std::vector<u32> hashes;
+  std::vector<u8> ranks;
   u8 p2align = 0;
 };
 
@@ -1387,16 +1551,33 @@ public:
   // For ICF
   std::unique_ptr<InputSection<E>> llvm_addrsig;
 
+  // For --call-graph-profile-sort
+  std::unique_ptr<InputSection<E>> llvm_cg_profile;
+
   // For .gdb_index
   InputSection<E> *debug_info = nullptr;
   InputSection<E> *debug_pubnames = nullptr;
   InputSection<E> *debug_pubtypes = nullptr;
 
+  // For --incremental
+  bool is_reusable = false;
+  u64 layout_hash = 0;
+  std::vector<u32> section_capacities;
+
+  // For RelocProgram. `reloc_syms` and `reloc_addrs` are the symbol
+  // index and the address of the symbol for each slot. `reloc_slots`
+  // maps a symbol index to a slot and is used only while relocations
+  // are being scanned.
+  std::vector<u32> reloc_syms;
+  std::vector<u64> reloc_addrs;
+  std::vector<u32> reloc_slots;
+
   // For LTO
   std::vector<ElfSym<E>> lto_elf_syms;
 
 private:
   void initialize_sections(Context<E> &ctx);
+  void compute_symbol_hashes(Context<E> &ctx);
   void sort_relocations(Context<E> &ctx);
   void initialize_ehframe_sections(Context<E> &ctx);
   void parse_note_gnu_property(Context <E> &ctx, const ElfShdr <E> &shdr);
@@ -1409,6 +1590,9 @@ private:
   const ElfShdr<E> *symtab_sec;
   std::span<U32<E>> symtab_shndx_sec;
 
+  // Hash values of global symbol keys computed by parse()
+  std::vector<u64> symbol_hashes;
+
 public:
   // Target-specific member
   [[no_unique_address]] ObjectFileExtras<E> extra;
@@ -1421,6 +1605,7 @@ public:
   SharedFile(Context<E> &ctx, MappedFile *mf) : InputFile<E>(ctx, mf) {}
 
   void parse(Context<E> &ctx);
+  void initialize_symbols(Context<E> &ctx);
   void resolve_symbols(Context<E> &ctx) override;
   std::span<Symbol<E> *> get_symbols_at(Symbol<E> *sym);
   i64 get_alignment(Symbol<E> *sym);
@@ -1446,6 +1631,10 @@ private:
   std::vector<u16> versyms;
   const ElfShdr<E> *symtab_sec;
 
+  // Symbol keys and their hash values computed by parse()
+  std::vector<std::string_view> symbol_keys;
+  std::vector<u64> symbol_hashes;
+
   // Used by get_symbols_at()
   std::once_flag init_sorted_syms;
   std::vector<Symbol<E> *> sorted_syms;
@@ -1542,6 +1731,13 @@ template <typename E>
 i64 compute_distance(Context<E> &ctx, Symbol<E> &sym,
                      InputSection<E> &isec, const ElfRel<E> &rel);
 
+//
+// gc-debug-info.cc
+//
+
+template <typename E>
+void gc_debug_info(Context<E> &ctx);
+
 //
 // gc-sections.cc
 //
@@ -1556,6 +1752,13 @@ void gc_sections(Context<E> &ctx);
 template <typename E>
 void icf_sections(Context<E> &ctx);
 
+//
+// call-graph-sort.cc
+//
+
+template <typename E>
+void sort_sections_by_call_graph(Context<E> &ctx);
+
 //
 // relocatable.cc
 //
@@ -1618,6 +1821,11 @@ template <typename E> void sort_init_fini(Context<E> &);
 template <typename E> void sort_ctor_dtor(Context<E> &);
 template <typename E> void fixup_ctors_in_init_array(Context<E> &);
 template <typename E> void shuffle_sections(Context<E> &);
+template <typename E> void sort_sections_by_symbol_order(Context<E> &);
+template <typename E> void sort_sections_by_data_access_trace(Context<E> &);
+template <typename E>
+void reorder_input_sections(Context<E> &,
+                            const std::unordered_map<InputSection<E> *, i64> &);
 template <typename E> void compute_section_sizes(Context<E> &);
 template <typename E> void sort_output_sections(Context<E> &);
 template <typename E> void claim_unresolved_symbols(Context<E> &);
@@ -1628,6 +1836,7 @@ template <typename E> void sort_dynsyms(Context<E> &);
 template <typename E> void create_output_symtab(Context<E> &);
 template <typename E> void report_undef_errors(Context<E> &);
 template <typename E> void create_reloc_sections(Context<E> &);
+template <typename E> void compute_reloc_addrs(Context<E> &);
 template <typename E> void copy_chunks(Context<E> &);
 template <typename E> void apply_version_script(Context<E> &);
 template <typename E> void parse_symbol_version(Context<E> &);
@@ -1642,6 +1851,7 @@ template <typename E> void write_build_id(Context<E> &);
 template <typename E> void write_gnu_debuglink(Context<E> &);
 template <typename E> void write_separate_debug_file(Context<E> &ctx);
 template <typename E> void write_dependency_file(Context<E> &);
+template <typename E> void write_perf_trace(Context<E> &);
 template <typename E> void show_stats(Context<E> &);
 
 //
@@ -1749,6 +1959,14 @@ template <> u64 get_eflags(Context<PPC64V2> &ctx);
 // main.cc
 //
 
+// An archive member that has not been parsed yet. See load_lazy_members().
+struct LazyArchiveMember {
+  MappedFile *mf = nullptr;
+  std::string archive_name;
+  i64 priority = 0;
+  Atomic<bool> is_loaded = false;
+};
+
 struct BuildId {
   i64 size() const {
     switch (kind) {
@@ -1796,6 +2014,17 @@ typedef enum {
   CET_REPORT_ERROR,
 } CetReportKind;
 
+typedef enum {
+  ICF_HASH,
+  ICF_REFINE,
+} IcfAlgorithm;
+
+typedef enum {
+  OUTPUT_IO_MMAP,
+  OUTPUT_IO_PWRITE,
+  OUTPUT_IO_URING,
+} OutputIoKind;
+
 typedef enum {
   SHUFFLE_SECTIONS_NONE,
   SHUFFLE_SECTIONS_SHUFFLE,
@@ -1816,6 +2045,37 @@ struct SectionOrder {
   u64 value = 0;
 };
 
+// The global symbol table, which maps symbol names to Symbol objects.
+//
+// get_symbol() is called for each global symbol of each input file
+// from all threads parsing input files, so the table needs to scale
+// with the number of cores. We use ConcurrentMap for that, which
+// stores Symbol objects in place and doesn't take a lock to find an
+// existing symbol. Since ConcurrentMap can't grow, we create it once
+// all input files are read, sized by a HyperLogLog estimate of the
+// number of distinct global symbol names.
+//
+// Symbols created before that (e.g. ones given by -u or LTO IR
+// symbols) and symbols that don't fit in the table are stored to a
+// conventional concurrent hash map instead.
+template <typename E>
+class SymbolMap {
+public:
+  Symbol<E> *insert(std::string_view key, u64 hash, std::string_view name,
+                    bool demangle);
+  void resize(i64 nbuckets);
+
+  HyperLogLog estimator;
+
+private:
+  ConcurrentMap<Symbol<E>> map;
+  tbb::concurrent_hash_map<std::string_view, Symbol<E>, HashCmp> map2;
+
+  // A bitmap of hash values of symbols created before resize()
+  BitVector filter;
+  i64 filter_size = 0;
+};
+
 // Target-specific context members
 template <typename E>
 struct ContextExtras {};
@@ -1883,7 +2143,9 @@ struct Context {
     BuildId build_id;
     CetReportKind z_cet_report = CET_REPORT_NONE;
     CompressKind compress_debug_sections = COMPRESS_NONE;
+    IcfAlgorithm icf_algorithm = ICF_HASH;
     MultiGlob undefined_glob;
+    OutputIoKind output_io = OUTPUT_IO_MMAP;
     SeparateCodeKind z_separate_code = NOSEPARATE_CODE;
     ShuffleSectionsKind shuffle_sections = SHUFFLE_SECTIONS_NONE;
     Symbol<E> *entry = nullptr;
@@ -1893,7 +2155,9 @@ struct Context {
     bool allow_multiple_definition = false;
     bool allow_shlib_undefined = true;
     bool apply_dynamic_relocs = true;
+    bool call_graph_profile_sort = true;
     bool color_diagnostics = false;
+    bool debug_names = false;
     bool default_symver = false;
     bool demangle = true;
     bool detach = true;
@@ -1907,6 +2171,7 @@ struct Context {
     bool export_dynamic = false;
     bool fatal_warnings = false;
     bool fork = true;
+    bool gc_debug_info = false;
     bool gc_sections = false;
     bool gdb_index = false;
     bool hash_style_gnu = true;
@@ -1914,6 +2179,7 @@ struct Context {
     bool icf = false;
     bool icf_all = false;
     bool ignore_data_address_equality = false;
+    bool incremental = false;
     bool lto_pass2 = false;
     bool nmagic = false;
     bool noinhibit_exec = false;
@@ -1932,6 +2198,7 @@ struct Context {
     bool relocatable = false;
     bool relocatable_merge_sections = false;
     bool repro = false;
+    bool reuse_compressed_debug_sections = false;
     bool rosegment = true;
     bool shared = false;
     bool start_stop = false;
@@ -1940,10 +2207,12 @@ struct Context {
     bool strip_all = false;
     bool strip_debug = false;
     bool suppress_warnings = false;
+    bool tail_merge_strings = false;
     bool trace = false;
     bool undefined_version = false;
     bool warn_common = false;
     bool warn_once = false;
+    bool warn_symbol_ordering = true;
     bool warn_textrel = false;
     bool z_copyreloc = true;
     bool z_delete = true;
@@ -1966,6 +2235,7 @@ struct Context {
     bool z_shstk = false;
     bool z_start_stop_visibility_protected = false;
     bool z_text = false;
+    i64 compress_debug_level = 0;
     i64 filler = -1;
     i64 spare_dynamic_tags = 5;
     i64 spare_program_headers = 0;
@@ -1978,8 +2248,10 @@ struct Context {
     std::string dependency_file;
     std::string directory;
     std::string dynamic_linker;
+    std::string input_cache;
     std::string output = "a.out";
     std::string package_metadata;
+    std::string perf_trace;
     std::string plugin;
     std::string rpaths;
     std::string separate_debug_file;
@@ -1987,6 +2259,7 @@ struct Context {
     std::string sysroot;
     std::string_view emulation;
     std::optional<std::vector<Symbol<E> *>> retain_symbols_file;
+    std::optional<std::vector<Symbol<E> *>> symbol_ordering_file;
     std::unordered_map<std::string_view, u64> section_align;
     std::unordered_map<std::string_view, u64> section_start;
     std::unordered_set<std::string_view> ignore_ir_file;
@@ -1995,6 +2268,8 @@ struct Context {
     std::vector<Symbol<E> *> require_defined;
     std::vector<Symbol<E> *> undefined;
     std::vector<std::pair<Symbol<E> *, std::variant<Symbol<E> *, u64>>> defsyms;
+    std::vector<std::tuple<Symbol<E> *, Symbol<E> *, u64>> call_graph_ordering;
+    std::vector<std::pair<std::string_view, u64>> data_access_trace;
     std::vector<std::string> library_paths;
     std::vector<std::string> plugin_opt;
     std::vector<std::string> version_definitions;
@@ -2016,6 +2291,11 @@ struct Context {
   // Reader context
   i64 file_priority = 10000;
 
+  // Archive members that are parsed only when needed, and a map from
+  // symbol names to the members defining them.
+  std::vector<std::unique_ptr<LazyArchiveMember>> lazy_members;
+  std::unordered_map<std::string_view, std::vector<LazyArchiveMember *>> lazy_syms;
+
   // tbb::concurrent_vector
   //   https://oneapi-src.github.io/oneTBB/main/tbb_userguide/concurrent_vector_ug.html
   //
@@ -2023,7 +2303,7 @@ struct Context {
   //   https://oneapi-src.github.io/oneTBB/main/tbb_userguide/concurrent_hash_map.html
 
   // Symbol table
-  tbb::concurrent_hash_map<std::string_view, Symbol<E>, HashCmp> symbol_map;
+  SymbolMap<E> symbol_map;
   tbb::concurrent_hash_map<std::string_view, ComdatGroup, HashCmp> comdat_groups;
   tbb::concurrent_vector<std::unique_ptr<MergedSection<E>>> merged_sections;
 
@@ -2065,6 +2345,9 @@ struct Context {
   // For --separate-debug-file
   std::vector<Chunk<E> *> debug_chunks;
 
+  // For --incremental
+  u64 layout_hash = 0;
+
   // Output chunks
   OutputEhdr<E> *ehdr = nullptr;
   OutputShdr<E> *shdr = nullptr;
@@ -2099,15 +2382,18 @@ struct Context {
   NotePackageSection<E> *note_package = nullptr;
   NotePropertySection<E> *note_property = nullptr;
   GdbIndexSection<E> *gdb_index = nullptr;
+  DebugNamesSection<E> *debug_names = nullptr;
   RelroPaddingSection<E> *relro_padding = nullptr;
   MergedSection<E> *comment = nullptr;
 
-  // For --gdb-index
+  // For --gdb-index and --debug-names
   std::span<u8> debug_info;
   std::span<u8> debug_abbrev;
   std::span<u8> debug_ranges;
   std::span<u8> debug_addr;
   std::span<u8> debug_rnglists;
+  std::span<u8> debug_str;
+  std::span<u8> debug_str_offsets;
 
   // For thread-local variables
   u64 tls_begin = 0;
@@ -2158,6 +2444,9 @@ MappedFile *find_library(Context<E> &ctx, ReaderContext &rctx, std::string path)
 template <typename E>
 void read_file(Context<E> &ctx, ReaderContext &rctx, MappedFile *mf);
 
+template <typename E>
+void load_lazy_members(Context<E> &ctx);
+
 template <typename E>
 int mold_main(int argc, char **argv);
 
@@ -2455,6 +2744,10 @@ public:
   [[no_unique_address]] SymbolExtras<E> extra;
 };
 
+template <typename E>
+Symbol<E> *get_symbol(Context<E> &ctx, std::string_view key,
+                      std::string_view name, u64 hash);
+
 template <typename E>
 Symbol<E> *get_symbol(Context<E> &ctx, std::string_view key,
                       std::string_view name);
@@ -2491,6 +2784,16 @@ inline u64 InputSection<E>::get_addr() const {
   return output_section->shdr.sh_addr + offset;
 }
 
+// Returns the number of bytes reserved for this section in the output
+// section. With --incremental, it may be larger than the section size
+// so that the section can grow in place. See incremental.cc.
+template <typename E>
+inline i64 InputSection<E>::get_capacity() const {
+  if (shndx < file.section_capacities.size())
+    return std::max<i64>(sh_size, file.section_capacities[shndx]);
+  return sh_size;
+}
+
 template <typename E>
 inline std::string_view InputSection<E>::name() const {
   if (file.elf_sections.size() <= shndx)
@@ -2516,6 +2819,73 @@ i64 get_addend(InputSection<E> &isec, const ElfRel<E> &rel) {
   return get_addend((u8 *)isec.contents.data() + rel.r_offset, rel);
 }
 
+// Compiles relocations of a section into a RelocProgram. add() is
+// called for each relocation by the target's scan_relocations().
+template <typename E> requires has_reloc_program<E>
+class RelocProgramBuilder {
+public:
+  RelocProgramBuilder(InputSection<E> &isec, i64 num_rels)
+    : isec(isec), num_rels(num_rels) {}
+
+  void add(RelocOpKind kind, i64 idx, const ElfRel<E> &rel) {
+    if (kind == RELOC_OP_SKIP || failed)
+      return;
+
+    if (kind == RELOC_OP_UNSUPPORTED) {
+      failed = true;
+      return;
+    }
+
+    i64 addend = get_addend(isec, rel);
+    if (kind == RELOC_OP_GENERIC || rel.r_offset > UINT32_MAX ||
+        addend != (i32)addend) {
+      generic.push_back(idx);
+      return;
+    }
+
+    u32 &slot = isec.file.reloc_slots[rel.r_sym];
+    if (slot == (u32)-1) {
+      slot = isec.file.reloc_syms.size();
+      isec.file.reloc_syms.push_back(rel.r_sym);
+    }
+
+    std::vector<RelocOp> &vec = ops[kind];
+    if (vec.empty())
+      vec.reserve(num_rels - idx);
+    vec.push_back({(u32)rel.r_offset, slot, (i32)addend});
+  }
+
+  void finish() {
+    i64 total = 0;
+    for (std::vector<RelocOp> &vec : ops)
+      total += vec.size();
+
+    if (failed || total == 0)
+      return;
+
+    // Concatenate operations. Most sections contain only one kind of
+    // operations, e.g. PC32 for code, in which case we don't copy them.
+    RelocProgram *prog = new RelocProgram;
+    for (i64 i = 0; i < NUM_RELOC_OPS; i++) {
+      prog->begin[i + 1] = prog->begin[i] + ops[i].size();
+      if (ops[i].size() == total)
+        prog->ops = std::move(ops[i]);
+      else
+        append(prog->ops, ops[i]);
+    }
+
+    prog->generic = std::move(generic);
+    isec.extra.reloc_program.reset(prog);
+  }
+
+private:
+  InputSection<E> &isec;
+  i64 num_rels;
+  std::array<std::vector<RelocOp>, NUM_RELOC_OPS> ops;
+  std::vector<u32> generic;
+  bool failed = false;
+};
+
 template <typename E>
 void write_addend(u8 *loc, i64 val, const ElfRel<E> &rel);
 
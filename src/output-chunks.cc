@@ -930,7 +930,8 @@ void OutputSection<E>::compute_section_size(Context<E> &ctx) {
 
   tbb::parallel_for_each(groups, [](Group &group) {
     for (InputSection<E> *isec : group.members) {
-      group.size = align_to(group.size, 1 << isec->p2align) + isec->sh_size;
+      group.size = align_to(group.size, 1 << isec->p2align) +
+                   isec->get_capacity();
       group.p2align = std::max<i64>(group.p2align, isec->p2align);
     }
   });
@@ -950,7 +951,7 @@ void OutputSection<E>::compute_section_size(Context<E> &ctx) {
     for (InputSection<E> *isec : group.members) {
       offset = align_to(offset, 1 << isec->p2align);
       isec->offset = offset;
-      offset += isec->sh_size;
+      offset += isec->get_capacity();
     }
   });
 }
@@ -972,7 +973,11 @@ void OutputSection<E>::write_to(Context<E> &ctx, u8 *buf, ElfRel<E> *rel) {
   // Copy section contents to an output file.
   tbb::parallel_for((i64)0, (i64)members.size(), [&](i64 i) {
     InputSection<E> &isec = *members[i];
-    isec.write_to(ctx, buf + isec.offset);
+
+    // With --incremental, a reused output file may already contain
+    // the up-to-date contents of this section. See incremental.cc.
+    if (!isec.file.is_reusable || !ctx.output_file->is_reused)
+      isec.write_to(ctx, buf + isec.offset);
 
     // Clear trailing padding. We write trap or nop instructions for
     // an executable segment so that a disassembler wouldn't try to
@@ -2149,16 +2154,101 @@ void MergedSection<E>::resolve(Context<E> &ctx) {
   resolved = true;
 }
 
+// With --tail-merge-strings (or -O2), a string that is a suffix of
+// another string is not emitted by itself but shares the bytes of the
+// longer string. For example, "bar" is stored as the last four bytes of
+// "foobar".
+//
+// Strings sharing a suffix share their last non-null element, so we
+// first distribute strings into buckets by that element and process the
+// buckets in parallel. In each bucket, we sort strings in the descending
+// order of their reversed contents. Then a string that is a suffix of
+// another always comes right after the longest string having it as a
+// suffix (or after another suffix of that string), so a single linear
+// pass can find all of them. The result doesn't depend on the insertion
+// order of the strings, so the output is deterministic.
+template <typename E>
+void MergedSection<E>::tail_merge(Context<E> &ctx) {
+  // This function may be called more than once.
+  for (std::pair<Entry *, Entry *> &p : tails)
+    p.first->value.is_tail = false;
+  tails.clear();
+
+  constexpr i64 NUM_BUCKETS = decltype(map)::NUM_SHARDS;
+  i64 entsize = this->shdr.sh_entsize;
+  i64 shard_size = map.nbuckets / map.NUM_SHARDS;
+
+  // buckets[i][j] contains strings in the i'th shard of the map that
+  // belong to the j'th bucket.
+  std::vector<std::vector<std::vector<Entry *>>> buckets(map.NUM_SHARDS);
+
+  tbb::parallel_for((i64)0, map.NUM_SHARDS, [&](i64 i) {
+    buckets[i].resize(NUM_BUCKETS);
+
+    for (i64 j = shard_size * i; j < shard_size * (i + 1); j++) {
+      Entry &ent = map.entries[j];
+      if (!ent.key || !ent.value.is_alive)
+        continue;
+
+      // Empty strings are suffixes of any strings. We put them in the
+      // first bucket.
+      if (ent.keylen < entsize * 2) {
+        buckets[i][0].push_back(&ent);
+      } else {
+        std::string_view last(ent.key + ent.keylen - entsize * 2, entsize);
+        buckets[i][hash_string(last) % NUM_BUCKETS].push_back(&ent);
+      }
+    }
+  });
+
+  std::vector<std::vector<std::pair<Entry *, Entry *>>> vec(NUM_BUCKETS);
+
+  tbb::parallel_for((i64)0, NUM_BUCKETS, [&](i64 i) {
+    std::vector<Entry *> entries;
+    for (std::vector<std::vector<Entry *>> &vec : buckets)
+      append(entries, vec[i]);
+
+    std::sort(entries.begin(), entries.end(), [](Entry *a, Entry *b) {
+      std::string_view x(a->key, a->keylen);
+      std::string_view y(b->key, b->keylen);
+      return std::lexicographical_compare(y.rbegin(), y.rend(),
+                                          x.rbegin(), x.rend());
+    });
+
+    Entry *root = nullptr;
+
+    for (Entry *ent : entries) {
+      if (root && std::string_view(root->key, root->keylen).ends_with(
+                    std::string_view(ent->key, ent->keylen))) {
+        // The string is placed at `root`'s offset plus `delta`, so it
+        // has to be sufficiently aligned at that position.
+        i64 delta = root->keylen - ent->keylen;
+        i64 p2align = ent->value.p2align;
+        if (p2align <= root->value.p2align && delta % (1 << p2align) == 0) {
+          ent->value.is_tail = true;
+          vec[i].push_back({ent, root});
+          continue;
+        }
+      }
+      root = ent;
+    }
+  });
+
+  tails = flatten(vec);
+}
+
 template <typename E>
 void MergedSection<E>::compute_section_size(Context<E> &ctx) {
   if (!resolved)
     resolve(ctx);
 
+  if (ctx.arg.tail_merge_strings && (this->shdr.sh_flags & SHF_STRINGS))
+    tail_merge(ctx);
+
   std::vector<i64> sizes(map.NUM_SHARDS);
   Atomic<i64> alignment = 1;
 
   tbb::parallel_for((i64)0, map.NUM_SHARDS, [&](i64 i) {
-    using Entry = typename decltype(map)::Entry;
     std::vector<Entry *> entries = map.get_sorted_entries(i);
 
     i64 offset = 0;
@@ -2166,7 +2256,7 @@ void MergedSection<E>::compute_section_size(Context<E> &ctx) {
 
     for (Entry *ent : entries) {
       SectionFragment<E> &frag = ent->value;
-      if (frag.is_alive) {
+      if (frag.is_alive && !frag.is_tail) {
         offset = align_to(offset, 1 << frag.p2align);
         frag.offset = offset;
         offset += ent->keylen;
@@ -2191,11 +2281,16 @@ void MergedSection<E>::compute_section_size(Context<E> &ctx) {
   tbb::parallel_for((i64)1, map.NUM_SHARDS, [&](i64 i) {
     for (i64 j = shard_size * i; j < shard_size * (i + 1); j++) {
       SectionFragment<E> &frag = map.entries[j].value;
-      if (frag.is_alive)
+      if (frag.is_alive && !frag.is_tail)
         frag.offset += shard_offsets[i];
     }
   });
 
+  tbb::parallel_for_each(tails, [](std::pair<Entry *, Entry *> &p) {
+    auto [tail, root] = p;
+    tail->value.offset = root->value.offset + root->keylen - tail->keylen;
+  });
+
   this->shdr.sh_size = shard_offsets[map.NUM_SHARDS];
   this->shdr.sh_addralign = alignment;
 
@@ -2221,7 +2316,8 @@ void MergedSection<E>::write_to(Context<E> &ctx, u8 *buf, ElfRel<E> *rel) {
     // Copy strings
     for (i64 j = shard_size * i; j < shard_size * (i + 1); j++)
       if (const char *key = map.entries[j].key)
-        if (SectionFragment<E> &frag = map.entries[j].value; frag.is_alive)
+        if (SectionFragment<E> &frag = map.entries[j].value;
+            frag.is_alive && !frag.is_tail)
           memcpy(buf + frag.offset, key, map.entries[j].keylen);
   });
 }
@@ -2255,30 +2351,73 @@ void EhFrameSection<E>::construct(Context<E> &ctx) {
     file->fde_size = offset;
   });
 
-  // Uniquify CIEs and assign offsets to them.
-  std::vector<CieRecord<E> *> leaders;
-  auto find_leader = [&](CieRecord<E> &cie) -> CieRecord<E> * {
-    for (CieRecord<E> *leader : leaders)
-      if (cie_equals(*leader, cie))
-        return leader;
-    return nullptr;
+  // Uniquify CIEs. Two CIEs are identical if they have the same contents
+  // and relocations. We serialize each CIE into a byte string and insert
+  // it into a concurrent hash map so that we can find identical CIEs in
+  // parallel. The one that comes first in the command line order becomes
+  // the leader, so the output is deterministic.
+  struct Leader {
+    Atomic<u64> idx = -1;
   };
 
-  i64 offset = 0;
-  for (ObjectFile<E> *file : ctx.objs) {
-    for (CieRecord<E> &cie : file->cies) {
-      if (CieRecord<E> *leader = find_leader(cie)) {
-        cie.output_offset = leader->output_offset;
-      } else {
-        cie.output_offset = offset;
-        cie.is_leader = true;
-        offset += cie.size();
-        leaders.push_back(&cie);
+  std::vector<std::vector<std::string>> keys(ctx.objs.size());
+  std::vector<std::vector<Leader *>> leaders(ctx.objs.size());
+  i64 num_cies = 0;
+  for (ObjectFile<E> *file : ctx.objs)
+    num_cies += file->cies.size();
+
+  ConcurrentMap<Leader> map(num_cies * 2);
+
+  tbb::parallel_for((i64)0, (i64)ctx.objs.size(), [&](i64 i) {
+    ObjectFile<E> &file = *ctx.objs[i];
+
+    // The map refers to the keys, so they must not be moved.
+    keys[i].reserve(file.cies.size());
+
+    for (i64 j = 0; j < file.cies.size(); j++) {
+      CieRecord<E> &cie = file.cies[j];
+      std::string &key = keys[i].emplace_back(cie.get_contents());
+
+      for (const ElfRel<E> &rel : cie.get_rels()) {
+        u64 buf[] = {
+          rel.r_offset - cie.input_offset,
+          rel.r_type,
+          (u64)file.symbols[rel.r_sym],
+          (u64)get_addend(cie.input_section, rel),
+        };
+        key.append((char *)buf, sizeof(buf));
       }
+
+      Leader *leader = map.insert(key, hash_string(key), {}).first;
+      update_minimum(leader->idx, (i << 32) | j);
+      leaders[i].push_back(leader);
     }
+  });
+
+  // Compute the total size of the leader CIEs of each file.
+  std::vector<i64> cie_sizes(ctx.objs.size());
+
+  tbb::parallel_for((i64)0, (i64)ctx.objs.size(), [&](i64 i) {
+    ObjectFile<E> &file = *ctx.objs[i];
+    for (i64 j = 0; j < file.cies.size(); j++) {
+      CieRecord<E> &cie = file.cies[j];
+      cie.is_leader = (leaders[i][j]->idx == ((i << 32) | j));
+      if (cie.is_leader)
+        cie_sizes[i] += cie.size();
+    }
+  });
+
+  // Compute the start offsets of each file's CIEs and FDEs. All CIEs are
+  // placed before all FDEs. This loop is just a prefix sum over files
+  // and is cheap.
+  std::vector<i64> cie_offsets(ctx.objs.size());
+  i64 offset = 0;
+
+  for (i64 i = 0; i < ctx.objs.size(); i++) {
+    cie_offsets[i] = offset;
+    offset += cie_sizes[i];
   }
 
-  // Assign FDE offsets to files.
   i64 idx = 0;
   for (ObjectFile<E> *file : ctx.objs) {
     file->fde_idx = idx;
@@ -2288,6 +2427,28 @@ void EhFrameSection<E>::construct(Context<E> &ctx) {
     offset += file->fde_size;
   }
 
+  // Assign offsets to leader CIEs and then copy them to non-leaders.
+  tbb::parallel_for((i64)0, (i64)ctx.objs.size(), [&](i64 i) {
+    i64 offset = cie_offsets[i];
+    for (CieRecord<E> &cie : ctx.objs[i]->cies) {
+      if (cie.is_leader) {
+        cie.output_offset = offset;
+        offset += cie.size();
+      }
+    }
+  });
+
+  tbb::parallel_for((i64)0, (i64)ctx.objs.size(), [&](i64 i) {
+    ObjectFile<E> &file = *ctx.objs[i];
+    for (i64 j = 0; j < file.cies.size(); j++) {
+      if (!file.cies[j].is_leader) {
+        u64 idx = leaders[i][j]->idx;
+        file.cies[j].output_offset =
+          ctx.objs[idx >> 32]->cies[(u32)idx].output_offset;
+      }
+    }
+  });
+
   // .eh_frame must end with a null word.
   this->shdr.sh_size = offset + 4;
 }
@@ -2848,30 +3009,162 @@ void NotePropertySection<E>::copy_buf(Context<E> &ctx) {
   }
 }
 
+// Returns true if the zstd-compressed contents of a given input
+// section can be copied to the output as-is. That's the case only if
+// no relocation modifies the section contents.
+template <typename E>
+static bool can_reuse_compressed(Context<E> &ctx, InputSection<E> &isec) {
+  if (!(isec.shdr().sh_flags & SHF_COMPRESSED) || isec.uncompressed ||
+      isec.sh_size == 0 || isec.contents.size() < sizeof(ElfChdr<E>))
+    return false;
+
+  ElfChdr<E> &chdr = *(ElfChdr<E> *)isec.contents.data();
+  return chdr.ch_type == ELFCOMPRESS_ZSTD && isec.get_rels(ctx).empty();
+}
+
+// A piece of an output section that can be written and compressed
+// independently from other pieces.
+template <typename E>
+struct CompressionPiece {
+  i64 offset = 0;
+  i64 size = 0;
+
+  // Non-null if the piece consists of a single input section whose
+  // compressed contents are copied to the output as-is.
+  InputSection<E> *reuse = nullptr;
+};
+
+// Splits a given chunk into pieces. Each piece is at least
+// Compressor::SHARD_SIZE bytes long unless it's the last one or it's
+// followed by a reused input section. For an output section, pieces
+// are split at input section boundaries.
+template <typename E>
+static std::vector<CompressionPiece<E>>
+split_into_pieces(Context<E> &ctx, Chunk<E> &chunk, bool reuse) {
+  std::vector<CompressionPiece<E>> vec;
+  i64 begin = 0;
+
+  auto flush = [&](i64 end) {
+    if (begin < end)
+      vec.push_back({begin, end - begin});
+    begin = end;
+  };
+
+  if (OutputSection<E> *osec = chunk.to_osec()) {
+    for (InputSection<E> *isec : osec->members) {
+      if (reuse && can_reuse_compressed(ctx, *isec)) {
+        flush(isec->offset);
+        vec.push_back({isec->offset, isec->sh_size, isec});
+        begin = isec->offset + isec->sh_size;
+      } else if (isec->offset - begin >= Compressor::SHARD_SIZE) {
+        flush(isec->offset);
+      }
+    }
+  }
+
+  flush(chunk.shdr.sh_size);
+  return vec;
+}
+
+// Compressing debug sections is done in a streaming fashion. We write
+// a piece of a section to a small temporary buffer, compress it and
+// discard the buffer, so that relocation and compression are
+// pipelined and we don't need to keep the entire uncompressed
+// contents in memory.
+//
+// If --reuse-compressed-debug-sections is given, zstd-compressed input
+// sections that aren't modified by relocations are not decompressed
+// at all. Their compressed frames are copied to the output instead.
 template <typename E>
 CompressedSection<E>::CompressedSection(Context<E> &ctx, Chunk<E> &chunk) {
   assert(chunk.name.starts_with(".debug"));
   this->name = chunk.name;
   this->is_compressed = true;
 
-  this->uncompressed_data.resize(chunk.shdr.sh_size);
-  u8 *buf = this->uncompressed_data.data();
+  // We don't need to keep the original data unless --gdb-index or
+  // --debug-names is given.
+  bool keep = ctx.arg.gdb_index || ctx.arg.debug_names;
+  if (keep)
+    this->uncompressed_data.resize(chunk.shdr.sh_size);
+
+  bool reuse = ctx.arg.reuse_compressed_debug_sections && !keep &&
+               ctx.arg.compress_debug_sections == COMPRESS_ZSTD;
+
+  std::vector<CompressionPiece<E>> pieces =
+    split_into_pieces(ctx, chunk, reuse);
+  std::vector<i64> shard_indices(pieces.size() + 1);
 
-  chunk.write_to(ctx, buf, nullptr);
+  for (i64 i = 0; i < pieces.size(); i++) {
+    i64 n = 1;
+    if (!pieces[i].reuse)
+      n = align_to(pieces[i].size, Compressor::SHARD_SIZE) /
+          Compressor::SHARD_SIZE;
+    shard_indices[i + 1] = shard_indices[i] + n;
+  }
+
+  i64 num_shards = shard_indices.back();
+  i64 level = ctx.arg.compress_debug_level;
+  ZstdCompressor *zstd = nullptr;
 
   switch (ctx.arg.compress_debug_sections) {
   case COMPRESS_ZLIB:
     chdr.ch_type = ELFCOMPRESS_ZLIB;
-    compressor.reset(new ZlibCompressor(buf, chunk.shdr.sh_size));
+    compressor.reset(new ZlibCompressor(num_shards, level));
     break;
   case COMPRESS_ZSTD:
     chdr.ch_type = ELFCOMPRESS_ZSTD;
-    compressor.reset(new ZstdCompressor(buf, chunk.shdr.sh_size));
+    zstd = new ZstdCompressor(num_shards, level);
+    compressor.reset(zstd);
     break;
   default:
     unreachable();
   }
 
+  OutputSection<E> *osec = chunk.to_osec();
+
+  tbb::parallel_for((i64)0, (i64)pieces.size(), [&](i64 i) {
+    i64 begin = pieces[i].offset;
+    i64 size = pieces[i].size;
+
+    if (InputSection<E> *isec = pieces[i].reuse) {
+      zstd->add_compressed_shard(shard_indices[i],
+                                 isec->contents.substr(sizeof(ElfChdr<E>)));
+      return;
+    }
+
+    std::vector<u8> vec;
+    u8 *buf;
+    if (keep) {
+      buf = this->uncompressed_data.data() + begin;
+    } else {
+      vec.resize(size);
+      buf = vec.data();
+    }
+
+    // Write the piece. Gaps between input sections are left as zeros.
+    if (osec) {
+      std::span<InputSection<E> *> members = osec->members;
+      auto it = std::partition_point(members.begin(), members.end(),
+                                     [&](InputSection<E> *isec) {
+        return isec->offset < begin;
+      });
+
+      for (; it != members.end() && (*it)->offset < begin + size; it++)
+        (*it)->write_to(ctx, buf + (*it)->offset - begin);
+    } else {
+      chunk.write_to(ctx, buf, nullptr);
+    }
+
+    // Compress the piece
+    tbb::parallel_for(shard_indices[i], shard_indices[i + 1], [&](i64 j) {
+      i64 offset = (j - shard_indices[i]) * Compressor::SHARD_SIZE;
+      i64 len = std::min(Compressor::SHARD_SIZE, size - offset);
+      compressor->add_shard(j, {(char *)buf + offset, (size_t)len});
+    });
+  });
+
+  compressor->finish();
+
   chdr.ch_size = chunk.shdr.sh_size;
   chdr.ch_addralign = chunk.shdr.sh_addralign;
 
@@ -2880,12 +3173,6 @@ CompressedSection<E>::CompressedSection(Context<E> &ctx, Chunk<E> &chunk) {
   this->shdr.sh_addralign = 1;
   this->shdr.sh_size = sizeof(chdr) + compressor->compressed_size;
   this->shndx = chunk.shndx;
-
-  // We don't need to keep the original data unless --gdb-index is given.
-  if (!ctx.arg.gdb_index) {
-    this->uncompressed_data.clear();
-    this->uncompressed_data.shrink_to_fit();
-  }
 }
 
 template <typename E>
@@ -1,11 +1,19 @@
 #include "mold.h"
 
+#include <condition_variable>
 #include <fcntl.h>
 #include <filesystem>
 #include <sys/file.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <thread>
+
+#if __has_include(<linux/io_uring.h>)
+# include <linux/io_uring.h>
+# include <sys/syscall.h>
+# define MOLD_HAS_IO_URING 1
+#endif
 
 namespace mold {
 
@@ -18,14 +26,16 @@ static u32 get_umask() {
 template <typename E>
 static int
 open_or_create_file(Context<E> &ctx, std::string path, std::string tmpfile,
-                    int perm) {
+                    int perm, bool &is_reused) {
   // Reuse an existing file if exists and writable because on Linux,
   // writing to an existing file is much faster than creating a fresh
   // file and writing to it.
   if (ctx.overwrite_output_file && rename(path.c_str(), tmpfile.c_str()) == 0) {
     i64 fd = ::open(tmpfile.c_str(), O_RDWR | O_CREAT, perm);
-    if (fd != -1)
+    if (fd != -1) {
+      is_reused = true;
       return fd;
+    }
     unlink(tmpfile.c_str());
   }
 
@@ -35,6 +45,285 @@ open_or_create_file(Context<E> &ctx, std::string path, std::string tmpfile,
   return fd;
 }
 
+// OutputWriter writes byte ranges of an in-memory output image to a
+// file in a background thread, so that the linker can keep working on
+// the image while the data is being written.
+//
+// With io_uring, the background thread keeps multiple writes in flight
+// instead of issuing one pwrite(2) at a time. That helps on file
+// systems where each write has a high latency, such as NFS.
+class OutputWriter {
+public:
+  OutputWriter(int fd, u8 *buf, bool use_uring) : fd(fd), buf(buf) {
+#ifdef MOLD_HAS_IO_URING
+    // If io_uring is not available (e.g. it is disabled by a seccomp
+    // filter), we silently fall back to pwrite(2).
+    if (use_uring)
+      setup_ring();
+#endif
+    thread = std::thread([this] { run(); });
+  }
+
+  OutputWriter(const OutputWriter &) = delete;
+
+  ~OutputWriter() {
+    if (thread.joinable())
+      finish(0);
+
+#ifdef MOLD_HAS_IO_URING
+    if (ring_fd != -1) {
+      munmap(sqes, sqes_size);
+      if (cq_ring != sq_ring)
+        munmap(cq_ring, cq_size);
+      munmap(sq_ring, sq_size);
+      ::close(ring_fd);
+    }
+#endif
+  }
+
+  // Schedules a given range to be written.
+  void add(i64 offset, i64 size) {
+    std::scoped_lock lock(mu);
+    queue.push_back({offset, size});
+    ranges.push_back({offset, size});
+    cv.notify_one();
+  }
+
+  // Writes everything in [0, filesize) that hasn't been scheduled yet
+  // and waits for all writes to complete. Returns 0 on success or an
+  // errno value.
+  int finish(i64 filesize) {
+    {
+      std::scoped_lock lock(mu);
+      sort(ranges);
+
+      i64 pos = 0;
+      for (std::pair<i64, i64> r : ranges) {
+        if (pos < r.first)
+          queue.push_back({pos, r.first - pos});
+        pos = std::max(pos, r.first + r.second);
+      }
+      if (pos < filesize)
+        queue.push_back({pos, filesize - pos});
+
+      done = true;
+      cv.notify_one();
+    }
+
+    thread.join();
+    return error;
+  }
+
+private:
+  // A large range is split into pieces so that multiple writes to the
+  // same range can be in flight with io_uring.
+  static constexpr i64 PIECE_SIZE = 4 * 1024 * 1024;
+
+  void run() {
+    for (;;) {
+      std::vector<std::pair<i64, i64>> vec;
+      {
+        std::unique_lock lock(mu);
+        cv.wait(lock, [&] { return done || !queue.empty(); });
+        if (queue.empty())
+          return;
+        vec.swap(queue);
+      }
+
+      std::vector<std::pair<i64, i64>> pieces;
+      for (std::pair<i64, i64> r : vec)
+        for (i64 off = 0; off < r.second; off += PIECE_SIZE)
+          pieces.push_back({r.first + off, std::min(PIECE_SIZE, r.second - off)});
+
+#ifdef MOLD_HAS_IO_URING
+      if (ring_fd != -1) {
+        write_uring(pieces);
+        continue;
+      }
+#endif
+
+      for (std::pair<i64, i64> p : pieces)
+        if (!error)
+          write_pwrite(p.first, p.second);
+    }
+  }
+
+  void write_pwrite(i64 offset, i64 size) {
+    while (size > 0) {
+      ssize_t n = pwrite(fd, buf + offset, size, offset);
+      if (n == -1) {
+        if (errno == EINTR)
+          continue;
+        error = errno;
+        return;
+      }
+      offset += n;
+      size -= n;
+    }
+  }
+
+#ifdef MOLD_HAS_IO_URING
+  // We use the raw io_uring system calls rather than liburing to avoid
+  // adding a dependency. See io_uring_setup(2) and io_uring_enter(2)
+  // for the details of the ring buffer protocol.
+  //
+  // https://man7.org/linux/man-pages/man2/io_uring_setup.2.html
+  // https://man7.org/linux/man-pages/man2/io_uring_enter.2.html
+  void setup_ring() {
+    io_uring_params p = {};
+    int rfd = syscall(__NR_io_uring_setup, 32, &p);
+    if (rfd == -1)
+      return;
+
+    sq_size = p.sq_off.array + p.sq_entries * sizeof(u32);
+    cq_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+      sq_size = cq_size = std::max(sq_size, cq_size);
+    sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+
+    auto map = [&](i64 size, u64 off) -> u8 * {
+      void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, rfd, off);
+      return (ptr == MAP_FAILED) ? nullptr : (u8 *)ptr;
+    };
+
+    sq_ring = map(sq_size, IORING_OFF_SQ_RING);
+    if (!sq_ring) {
+      ::close(rfd);
+      return;
+    }
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+      cq_ring = sq_ring;
+    else
+      cq_ring = map(cq_size, IORING_OFF_CQ_RING);
+
+    if (!cq_ring) {
+      munmap(sq_ring, sq_size);
+      ::close(rfd);
+      return;
+    }
+
+    sqes = (io_uring_sqe *)map(sqes_size, IORING_OFF_SQES);
+    if (!sqes) {
+      if (cq_ring != sq_ring)
+        munmap(cq_ring, cq_size);
+      munmap(sq_ring, sq_size);
+      ::close(rfd);
+      return;
+    }
+
+    sq_tail = (u32 *)(sq_ring + p.sq_off.tail);
+    sq_mask = *(u32 *)(sq_ring + p.sq_off.ring_mask);
+    sq_array = (u32 *)(sq_ring + p.sq_off.array);
+    cq_head = (u32 *)(cq_ring + p.cq_off.head);
+    cq_tail = (u32 *)(cq_ring + p.cq_off.tail);
+    cq_mask = *(u32 *)(cq_ring + p.cq_off.ring_mask);
+    cqes = (io_uring_cqe *)(cq_ring + p.cq_off.cqes);
+    ring_entries = p.sq_entries;
+    ring_fd = rfd;
+  }
+
+  void write_uring(std::vector<std::pair<i64, i64>> &pieces) {
+    std::reverse(pieces.begin(), pieces.end());
+
+    std::vector<std::pair<i64, i64>> slots(ring_entries);
+    std::vector<u64> free_slots;
+    for (i64 i = 0; i < ring_entries; i++)
+      free_slots.push_back(i);
+
+    i64 inflight = 0;
+    i64 unsubmitted = 0;
+
+    while ((!pieces.empty() && !error) || inflight) {
+      // Fill the submission queue. We are the only producer, so we
+      // can read the tail without synchronization.
+      u32 tail = *sq_tail;
+      while (!pieces.empty() && !error && !free_slots.empty()) {
+        auto [offset, size] = pieces.back();
+        pieces.pop_back();
+
+        u64 slot = free_slots.back();
+        free_slots.pop_back();
+        slots[slot] = {offset, size};
+
+        u32 idx = tail & sq_mask;
+        io_uring_sqe &sqe = sqes[idx];
+        memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_WRITE;
+        sqe.fd = fd;
+        sqe.addr = (u64)(buf + offset);
+        sqe.len = size;
+        sqe.off = offset;
+        sqe.user_data = slot;
+        sq_array[idx] = idx;
+
+        tail++;
+        inflight++;
+        unsubmitted++;
+      }
+      std::atomic_ref(*sq_tail).store(tail, std::memory_order_release);
+
+      // Submit new requests and wait for at least one completion.
+      int r = syscall(__NR_io_uring_enter, ring_fd, unsubmitted, 1,
+                      IORING_ENTER_GETEVENTS, nullptr, 0);
+      if (r == -1) {
+        if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+          continue;
+        error = errno;
+        return;
+      }
+      unsubmitted -= r;
+
+      // Reap completions. A short write is resubmitted for the rest.
+      u32 head = *cq_head;
+      u32 end = std::atomic_ref(*cq_tail).load(std::memory_order_acquire);
+
+      for (; head != end; head++) {
+        io_uring_cqe &cqe = cqes[head & cq_mask];
+        auto [offset, size] = slots[cqe.user_data];
+        free_slots.push_back(cqe.user_data);
+        inflight--;
+
+        if (cqe.res == -EINTR || cqe.res == -EAGAIN)
+          pieces.push_back({offset, size});
+        else if (cqe.res < 0)
+          error = -cqe.res;
+        else if (cqe.res < size)
+          pieces.push_back({offset + cqe.res, size - cqe.res});
+      }
+      std::atomic_ref(*cq_head).store(head, std::memory_order_release);
+    }
+  }
+
+  int ring_fd = -1;
+  u8 *sq_ring = nullptr;
+  u8 *cq_ring = nullptr;
+  io_uring_sqe *sqes = nullptr;
+  i64 sq_size = 0;
+  i64 cq_size = 0;
+  i64 sqes_size = 0;
+  u32 *sq_tail = nullptr;
+  u32 *sq_array = nullptr;
+  u32 *cq_head = nullptr;
+  u32 *cq_tail = nullptr;
+  u32 sq_mask = 0;
+  u32 cq_mask = 0;
+  io_uring_cqe *cqes = nullptr;
+  i64 ring_entries = 0;
+#endif
+
+  int fd;
+  u8 *buf;
+  std::thread thread;
+  std::mutex mu;
+  std::condition_variable cv;
+  std::vector<std::pair<i64, i64>> queue;
+  std::vector<std::pair<i64, i64>> ranges;
+  bool done = false;
+  int error = 0;
+};
+
 template <typename E>
 class MemoryMappedOutputFile : public OutputFile<E> {
 public:
@@ -44,7 +333,7 @@ public:
     std::string tmpfile =
       path_dirname(path) / ("." + path_filename(path) + "." + pid);
 
-    this->fd = open_or_create_file(ctx, path, tmpfile, perm);
+    this->fd = open_or_create_file(ctx, path, tmpfile, perm, this->is_reused);
 
     if (fchmod(this->fd, perm & ~get_umask()) == -1)
       Fatal(ctx) << "fchmod failed: " << errno_string();
@@ -58,10 +347,27 @@ public:
     fallocate(this->fd, 0, 0, filesize);
 #endif
 
-    this->buf = (u8 *)mmap(nullptr, filesize, PROT_READ | PROT_WRITE,
-                           MAP_SHARED, this->fd, 0);
-    if (this->buf == MAP_FAILED)
-      Fatal(ctx) << path << ": mmap failed: " << errno_string();
+    if (ctx.arg.output_io == OUTPUT_IO_MMAP) {
+      this->buf = (u8 *)mmap(nullptr, filesize, PROT_READ | PROT_WRITE,
+                             MAP_SHARED, this->fd, 0);
+      if (this->buf == MAP_FAILED)
+        Fatal(ctx) << path << ": mmap failed: " << errno_string();
+    } else {
+      // With --output-io=pwrite or uring, we build an output image in
+      // anonymous memory and write it to the file with system calls.
+      // Unlike a shared file mapping, this doesn't leave dirty pages
+      // of the file to the kernel's writeback, which can be slow on
+      // NFS or overlayfs.
+      this->buf = (u8 *)mmap(nullptr, filesize, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (this->buf == MAP_FAILED)
+        Fatal(ctx) << path << ": mmap failed: " << errno_string();
+
+      this->is_mmapped = false;
+      this->is_reused = false;
+      writer.reset(new OutputWriter(this->fd, this->buf,
+                                    ctx.arg.output_io == OUTPUT_IO_URING));
+    }
 
     mold::output_buffer_start = this->buf;
     mold::output_buffer_end = this->buf + filesize;
@@ -72,11 +378,28 @@ public:
       ::close(fd2);
   }
 
+  void write_behind(Context<E> &ctx, i64 offset, i64 size) override {
+    if (writer && size > 0)
+      writer->add(offset, size);
+  }
+
   void close(Context<E> &ctx) override {
     Timer t(ctx, "close_file");
 
+    if (writer) {
+      if (int err = writer->finish(this->filesize)) {
+        errno = err;
+        Fatal(ctx) << this->path << ": write failed: " << errno_string();
+      }
+      writer.reset();
+    }
+
     if (!this->is_unmapped)
-      munmap(this->buf, this->filesize);
+      munmap(this->buf, this->bufsize);
+
+    if (this->filesize < this->bufsize &&
+        ftruncate(this->fd, this->filesize) == -1)
+      Fatal(ctx) << "ftruncate failed: " << errno_string();
 
     if (this->buf2.empty()) {
       ::close(this->fd);
@@ -100,6 +423,7 @@ public:
   }
 
 private:
+  std::unique_ptr<OutputWriter> writer;
   int fd2 = -1;
 };
 
@@ -139,8 +463,10 @@ OutputFile<E>::open(Context<E> &ctx, std::string path, i64 filesize, int perm) {
   madvise(file->buf, filesize, MADV_HUGEPAGE);
 #endif
 
-  if (ctx.arg.filler != -1)
+  if (ctx.arg.filler != -1) {
     memset(file->buf, ctx.arg.filler, filesize);
+    file->is_reused = false;
+  }
   return std::unique_ptr<OutputFile>(file);
 }
 
@@ -173,6 +499,7 @@ void LockingOutputFile<E>::resize(Context<E> &ctx, i64 filesize) {
     Fatal(ctx) << this->path << ": mmap failed: " << errno_string();
 
   this->filesize = filesize;
+  this->bufsize = filesize;
   mold::output_buffer_start = this->buf;
   mold::output_buffer_end = this->buf + filesize;
 }
@@ -180,7 +507,11 @@ void LockingOutputFile<E>::resize(Context<E> &ctx, i64 filesize) {
 template <typename E>
 void LockingOutputFile<E>::close(Context<E> &ctx) {
   if (!this->is_unmapped)
-    munmap(this->buf, this->filesize);
+    munmap(this->buf, this->bufsize);
+
+  if (this->filesize < this->bufsize &&
+      ftruncate(this->fd, this->filesize) == -1)
+    Fatal(ctx) << "ftruncate failed: " << errno_string();
 
   if (!this->buf2.empty()) {
     FILE *out = fdopen(this->fd, "w");
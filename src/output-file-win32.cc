@@ -45,6 +45,15 @@ public:
 
     UnmapViewOfFile(this->buf);
 
+    if (this->filesize < this->bufsize) {
+      LARGE_INTEGER size;
+      size.QuadPart = this->filesize;
+      if (!SetFilePointerEx(handle, size, nullptr, FILE_BEGIN) ||
+          !SetEndOfFile(handle))
+        Fatal(ctx) << this->path << ": SetEndOfFile failed: "
+                   << GetLastError();
+    }
+
     if (!this->buf2.empty()) {
       if (SetFilePointer(handle, 0, nullptr, FILE_END) == INVALID_SET_FILE_POINTER)
         Fatal(ctx) << this->path << ": SetFilePointer failed: "
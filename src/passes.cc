@@ -155,6 +155,8 @@ void create_synthetic_sections(Context<E> &ctx) {
     ctx.eh_frame_hdr = push(new EhFrameHdrSection<E>);
   if (ctx.arg.gdb_index && has_debug_info_section(ctx))
     ctx.gdb_index = push(new GdbIndexSection<E>);
+  if (ctx.arg.debug_names && has_debug_info_section(ctx))
+    ctx.debug_names = push(new DebugNamesSection<E>);
   if (ctx.arg.z_relro && ctx.arg.section_order.empty() &&
       ctx.arg.z_separate_code != SEPARATE_LOADABLE_SEGMENTS)
     ctx.relro_padding = push(new RelroPaddingSection<E>);
@@ -361,6 +363,11 @@ void do_lto(Context<E> &ctx) {
   std::vector<ObjectFile<E> *> lto_objs = run_lto_plugin(ctx);
   append(ctx.objs, lto_objs);
 
+  // LTO results may refer to symbols that were not referred to by IR
+  // object files (e.g. memcpy), so parse archive members defining them.
+  load_lazy_members(ctx);
+  apply_exclude_libs(ctx);
+
   // Redo name resolution.
   clear_symbols(ctx);
 
@@ -395,6 +402,11 @@ void create_merged_sections(Context<E> &ctx) {
     file->convert_mergeable_sections(ctx);
   });
 
+  // Restore split mergeable sections from the cache if --input-cache
+  // is given.
+  if (!ctx.arg.input_cache.empty())
+    apply_input_cache(ctx);
+
   tbb::parallel_for_each(ctx.merged_sections,
                          [&](std::unique_ptr<MergedSection<E>> &sec) {
     if (sec->shdr.sh_flags & SHF_ALLOC)
@@ -1294,25 +1306,31 @@ static void shuffle(std::vector<T> &vec, u64 seed) {
     std::swap(vec[i], vec[i + rand() % (vec.size() - i)]);
 }
 
+// Returns true if the order of input sections in a given output section
+// doesn't matter. Pieces of .init and .fini have to be concatenated in
+// the original order, and the order of .ctors and .init_array has been
+// fixed by sort_ctor_dtor() and sort_init_fini().
+template <typename E>
+static bool is_eligible_for_reordering(OutputSection<E> *osec) {
+  if (osec) {
+    std::string_view name = osec->name;
+    return name != ".init" && name != ".fini" &&
+           name != ".ctors" && name != ".dtors" &&
+           name != ".init_array" && name != ".preinit_array" &&
+           name != ".fini_array";
+  }
+  return false;
+}
+
 template <typename E>
 void shuffle_sections(Context<E> &ctx) {
   Timer t(ctx, "shuffle_sections");
 
-  auto is_eligible = [](OutputSection<E> *osec) {
-    if (osec) {
-      std::string_view name = osec->name;
-      return name != ".init" && name != ".fini" &&
-             name != ".ctors" && name != ".dtors" &&
-             name != ".init_array" && name != ".preinit_array" &&
-             name != ".fini_array";
-    }
-    return false;
-  };
-
   switch (ctx.arg.shuffle_sections) {
   case SHUFFLE_SECTIONS_SHUFFLE: {
     tbb::parallel_for_each(ctx.chunks, [&](Chunk<E> *chunk) {
-      if (OutputSection<E> *osec = chunk->to_osec(); is_eligible(osec)) {
+      if (OutputSection<E> *osec = chunk->to_osec();
+          is_eligible_for_reordering(osec)) {
         u64 seed = ctx.arg.shuffle_sections_seed + hash_string(osec->name);
         shuffle(osec->members, seed);
       }
@@ -1321,7 +1339,8 @@ void shuffle_sections(Context<E> &ctx) {
   }
   case SHUFFLE_SECTIONS_REVERSE:
     tbb::parallel_for_each(ctx.chunks, [&](Chunk<E> *chunk) {
-      if (OutputSection<E> *osec = chunk->to_osec(); is_eligible(osec))
+      if (OutputSection<E> *osec = chunk->to_osec();
+          is_eligible_for_reordering(osec))
         std::reverse(osec->members.begin(), osec->members.end());
     });
     break;
@@ -1330,6 +1349,191 @@ void shuffle_sections(Context<E> &ctx) {
   }
 }
 
+// Sort input sections in each output section by a given order. Sections
+// not in `order` keep their relative order and are placed after the
+// ones in `order`.
+template <typename E>
+void reorder_input_sections(Context<E> &ctx,
+                            const std::unordered_map<InputSection<E> *, i64> &order) {
+  std::unordered_set<OutputSection<E> *> osecs;
+  for (auto [isec, idx] : order)
+    if (is_eligible_for_reordering(isec->output_section))
+      osecs.insert(isec->output_section);
+
+  auto get_order = [&](InputSection<E> *isec) {
+    auto it = order.find(isec);
+    return (it == order.end()) ? INT64_MAX : it->second;
+  };
+
+  tbb::parallel_for_each(osecs, [&](OutputSection<E> *osec) {
+    std::stable_sort(osec->members.begin(), osec->members.end(),
+                     [&](InputSection<E> *a, InputSection<E> *b) {
+      return get_order(a) < get_order(b);
+    });
+  });
+}
+
+// Handle --symbol-ordering-file. Input sections defining the listed
+// symbols are placed at the beginning of their output sections in the
+// order of the symbols. Local symbols match too, as is the case with lld.
+template <typename E>
+void sort_sections_by_symbol_order(Context<E> &ctx) {
+  Timer t(ctx, "sort_sections_by_symbol_order");
+  std::vector<Symbol<E> *> &syms = *ctx.arg.symbol_ordering_file;
+
+  auto warn = [&](std::string_view msg, Symbol<E> &sym) {
+    if (ctx.arg.warn_symbol_ordering)
+      Warn(ctx) << "--symbol-ordering-file: " << msg << sym;
+  };
+
+  // Map symbol names to their first appearances in the file.
+  std::unordered_map<std::string_view, i64> map;
+  for (i64 i = 0; i < syms.size(); i++)
+    if (!map.insert({syms[i]->name(), i}).second)
+      warn("symbol specified multiple times: ", *syms[i]);
+
+  auto get_section = [](Symbol<E> &sym) -> InputSection<E> * {
+    InputSection<E> *isec = sym.get_input_section();
+    if (isec && isec->icf_removed())
+      return isec->leader;
+    return isec;
+  };
+
+  // Find local symbols with the listed names.
+  std::vector<std::vector<std::pair<InputSection<E> *, i64>>> locals(ctx.objs.size());
+
+  tbb::parallel_for((i64)0, (i64)ctx.objs.size(), [&](i64 i) {
+    ObjectFile<E> *file = ctx.objs[i];
+    for (i64 j = 1; j < file->first_global; j++) {
+      Symbol<E> &sym = *file->symbols[j];
+      if (file->elf_syms[j].st_type == STT_SECTION)
+        continue;
+
+      if (auto it = map.find(sym.name()); it != map.end())
+        if (InputSection<E> *isec = get_section(sym); isec && isec->is_alive)
+          locals[i].push_back({isec, it->second});
+    }
+  });
+
+  std::unordered_map<InputSection<E> *, i64> order;
+  std::vector<bool> found(syms.size());
+
+  auto add = [&](InputSection<E> *isec, i64 idx) {
+    auto [it, inserted] = order.insert({isec, idx});
+    if (!inserted)
+      it->second = std::min(it->second, idx);
+    found[idx] = true;
+  };
+
+  for (std::vector<std::pair<InputSection<E> *, i64>> &vec : locals)
+    for (auto [isec, idx] : vec)
+      add(isec, idx);
+
+  // Handle global symbols.
+  for (i64 i = 0; i < syms.size(); i++) {
+    Symbol<E> &sym = *syms[i];
+    if (map[sym.name()] != i)
+      continue;
+
+    if (!sym.file) {
+      if (!found[i])
+        warn("no such symbol: ", sym);
+      continue;
+    }
+
+    if (sym.file->is_dso) {
+      warn("unable to order shared symbol: ", sym);
+      continue;
+    }
+
+    InputSection<E> *isec = get_section(sym);
+    if (!isec) {
+      if (sym.get_frag())
+        warn("unable to order symbol in a mergeable section: ", sym);
+      else
+        warn("unable to order absolute symbol: ", sym);
+      continue;
+    }
+
+    if (!isec->is_alive) {
+      warn("unable to order discarded symbol: ", sym);
+      continue;
+    }
+
+    add(isec, i);
+  }
+
+  reorder_input_sections(ctx, order);
+}
+
+// Handle --data-access-trace. Input sections of non-executable output
+// sections such as .data, .data.rel.ro and .rodata that were touched at
+// runtime are placed at the beginning of their output sections in the
+// order of their first touches, so that pages needed at startup are
+// packed together and untouched data doesn't have to be paged in.
+//
+// Each trace entry names either a symbol or an input section. Unknown
+// names are silently ignored because a trace usually contains entries
+// for shared libraries too.
+template <typename E>
+void sort_sections_by_data_access_trace(Context<E> &ctx) {
+  Timer t(ctx, "sort_sections_by_data_access_trace");
+
+  // Map names to their first-touch timestamps.
+  std::unordered_map<std::string_view, u64> map;
+  for (auto [name, time] : ctx.arg.data_access_trace) {
+    auto [it, inserted] = map.insert({name, time});
+    if (!inserted)
+      it->second = std::min(it->second, time);
+  }
+
+  auto is_data = [](InputSection<E> *isec) {
+    OutputSection<E> *osec = isec->output_section;
+    return isec->is_alive && osec && (osec->shdr.sh_flags & SHF_ALLOC) &&
+           !(osec->shdr.sh_flags & SHF_EXECINSTR) &&
+           !(osec->shdr.sh_flags & SHF_TLS);
+  };
+
+  std::vector<std::vector<std::pair<InputSection<E> *, u64>>> vec(ctx.objs.size());
+
+  tbb::parallel_for((i64)0, (i64)ctx.objs.size(), [&](i64 i) {
+    ObjectFile<E> *file = ctx.objs[i];
+
+    for (std::unique_ptr<InputSection<E>> &isec : file->sections)
+      if (isec && is_data(isec.get()))
+        if (auto it = map.find(isec->name()); it != map.end())
+          vec[i].push_back({isec.get(), it->second});
+
+    for (i64 j = 1; j < file->elf_syms.size(); j++) {
+      Symbol<E> &sym = *file->symbols[j];
+      if (sym.file != file || file->elf_syms[j].st_type == STT_SECTION)
+        continue;
+
+      if (auto it = map.find(sym.name()); it != map.end()) {
+        InputSection<E> *isec = sym.get_input_section();
+        if (isec && isec->icf_removed())
+          isec = isec->leader;
+        if (isec && is_data(isec))
+          vec[i].push_back({isec, it->second});
+      }
+    }
+  });
+
+  // Timestamps are used as sort keys as-is. Sections sharing the same
+  // timestamp keep their original relative order.
+  std::unordered_map<InputSection<E> *, i64> order;
+  for (std::vector<std::pair<InputSection<E> *, u64>> &v : vec) {
+    for (auto [isec, time] : v) {
+      i64 key = std::min<u64>(time, INT64_MAX - 1);
+      auto [it, inserted] = order.insert({isec, key});
+      if (!inserted)
+        it->second = std::min(it->second, key);
+    }
+  }
+
+  reorder_input_sections(ctx, order);
+}
+
 template <typename E>
 void compute_section_sizes(Context<E> &ctx) {
   Timer t(ctx, "compute_section_sizes");
@@ -1454,6 +1658,7 @@ void scan_relocations(Context<E> &ctx) {
 
   // Scan relocations to find dynamic symbols.
   tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
+    TaskTimer t2(ctx, file->filename);
     file->scan_relocations(ctx);
   });
 
@@ -1615,15 +1820,196 @@ void create_reloc_sections(Context<E> &ctx) {
         ctx.chunks.push_back(x);
 }
 
+// Fill the symbol address table for relocation programs. See the
+// comment for RelocProgram. Computing a symbol address involves
+// visiting the symbol, its input section and its output section, which
+// are scattered in memory, so we do it once per symbol rather than once
+// per relocation.
+template <typename E>
+void compute_reloc_addrs(Context<E> &ctx) {
+  Timer t(ctx, "compute_reloc_addrs");
+
+  tbb::parallel_for_each(ctx.objs, [&](ObjectFile<E> *file) {
+    file->reloc_addrs.resize(file->reloc_syms.size());
+    for (i64 i = 0; i < file->reloc_syms.size(); i++)
+      file->reloc_addrs[i] = file->symbols[file->reloc_syms[i]]->get_addr(ctx);
+  });
+}
+
+// Returns true if a chunk is written to by other chunks' copy_buf().
+// Such chunk becomes final only after all chunks are copied.
+//
+// For --relocatable and --emit-relocs, relocation sections write
+// addends to other sections, so we assume nothing is final until all
+// chunks are copied.
+template <typename E>
+static bool is_shared_chunk(Context<E> &ctx, Chunk<E> *chunk) {
+  return chunk == ctx.symtab || chunk == ctx.strtab ||
+         chunk == ctx.symtab_shndx || chunk == ctx.eh_frame_hdr ||
+         ctx.arg.relocatable || ctx.arg.emit_relocs;
+}
+
+// Returns true if a chunk is modified after copy_chunks() but before
+// write_build_id().
+template <typename E>
+static bool is_modified_before_build_id(Context<E> &ctx, Chunk<E> *chunk) {
+  return chunk == ctx.reldyn ||
+         (ctx.arg.z_rewrite_endbr && (chunk->shdr.sh_flags & SHF_EXECINSTR));
+}
+
+// Returns true if a chunk is modified after copy_chunks(). Note that
+// write_gdb_index() and write_debug_names() rewrite the section header
+// as well.
+template <typename E>
+static bool is_modified_later(Context<E> &ctx, Chunk<E> *chunk) {
+  return is_modified_before_build_id(ctx, chunk) || chunk == ctx.buildid ||
+         chunk == ctx.gdb_index || chunk == ctx.debug_names ||
+         chunk == ctx.gnu_debuglink ||
+         ((ctx.gdb_index || ctx.debug_names) && chunk == ctx.shdr);
+}
+
+template <typename E>
+std::vector<std::span<u8>> get_shards(Context<E> &ctx) {
+  constexpr i64 shard_size = 4 * 1024 * 1024; // 4 MiB
+  std::span<u8> buf = {ctx.buf, (size_t)ctx.output_file->filesize};
+  std::vector<std::span<u8>> vec;
+
+  while (!buf.empty()) {
+    i64 sz = std::min<i64>(shard_size, buf.size());
+    vec.push_back(buf.subspan(0, sz));
+    buf = buf.subspan(sz);
+  }
+  return vec;
+}
+
+// BLAKE3 is a cryptographic hash function just like SHA256.
+// We use it instead of SHA256 because it's faster.
+static void blake3_hash(u8 *buf, i64 size, u8 *out) {
+  blake3_hasher hasher;
+  blake3_hasher_init(&hasher);
+  blake3_hasher_update(&hasher, buf, size);
+  blake3_hasher_finalize(&hasher, out, BLAKE3_OUT_LEN);
+}
+
+// A hash-based build-id is a hash of the entire output file. Hashing a
+// large output file after writing it takes time and makes us touch
+// every page of the file twice. So we hash each shard of the file as
+// soon as all chunks overlapping with it are written, while other
+// chunks are still being copied. write_build_id() then combines the
+// shard hashes.
+template <typename E>
+static std::pair<i64, i64> get_shard_range(Context<E> &ctx, Chunk<E> *chunk) {
+  BuildIdSection<E> &sec = *ctx.buildid;
+  if (chunk->shdr.sh_type == SHT_NOBITS || chunk->shdr.sh_size == 0)
+    return {0, 0};
+
+  i64 shard_size = sec.shards[0].size();
+  i64 begin = chunk->shdr.sh_offset / shard_size;
+  i64 end = (chunk->shdr.sh_offset + chunk->shdr.sh_size - 1) / shard_size + 1;
+  return {begin, end};
+}
+
+template <typename E>
+static void hash_shards(Context<E> &ctx, std::span<i64> indices) {
+  BuildIdSection<E> &sec = *ctx.buildid;
+
+  tbb::parallel_for_each(indices, [&](i64 i) {
+    blake3_hash(sec.shards[i].data(), sec.shards[i].size(),
+                sec.shard_hashes.data() + i * BLAKE3_OUT_LEN);
+
+#ifdef HAVE_MADVISE
+    // Make the kernel page out the file contents we've just written
+    // so that subsequent close(2) call will become quicker.
+    if (i > 0 && ctx.output_file->is_mmapped)
+      madvise(sec.shards[i].data(), sec.shards[i].size(), MADV_DONTNEED);
+#endif
+  });
+}
+
+template <typename E>
+static void start_build_id_hashing(Context<E> &ctx) {
+  BuildIdSection<E> &sec = *ctx.buildid;
+  sec.shards = get_shards(ctx);
+  sec.shard_hashes.resize(sec.shards.size() * BLAKE3_OUT_LEN);
+  sec.shard_refcnt = std::vector<Atomic<i32>>(sec.shards.size());
+
+  for (Chunk<E> *chunk : ctx.chunks) {
+    auto [begin, end] = get_shard_range(ctx, chunk);
+    for (i64 i = begin; i < end; i++)
+      sec.shard_refcnt[i]++;
+  }
+
+  // Shards that don't overlap with any chunk contain only padding.
+  std::vector<i64> indices;
+  for (i64 i = 0; i < sec.shards.size(); i++)
+    if (sec.shard_refcnt[i] == 0)
+      indices.push_back(i);
+  hash_shards(ctx, indices);
+}
+
+// Called when a given chunk has been written. Hashes shards that have
+// become complete.
+template <typename E>
+static void release_build_id_shards(Context<E> &ctx, Chunk<E> *chunk) {
+  BuildIdSection<E> &sec = *ctx.buildid;
+  auto [begin, end] = get_shard_range(ctx, chunk);
+
+  std::vector<i64> indices;
+  for (i64 i = begin; i < end; i++)
+    if (sec.shard_refcnt[i].fetch_sub(1) == 1)
+      indices.push_back(i);
+  hash_shards(ctx, indices);
+}
+
 // Copy chunks to an output file
 template <typename E>
 void copy_chunks(Context<E> &ctx) {
   Timer t(ctx, "copy_chunks");
 
+  // Zero-clear paddings between chunks. We do this first so that the
+  // paddings are already final when shards are hashed for build-id.
+  auto zero = [&](Chunk<E> *chunk, i64 next_start) {
+    i64 pos = chunk->shdr.sh_offset + chunk->shdr.sh_size;
+    memset(ctx.buf + pos, 0, next_start - pos);
+  };
+
+  std::vector<Chunk<E> *> chunks = ctx.chunks;
+
+  std::erase_if(chunks, [](Chunk<E> *chunk) {
+    return chunk->shdr.sh_type == SHT_NOBITS;
+  });
+
+  for (i64 i = 1; i < chunks.size(); i++)
+    zero(chunks[i - 1], chunks[i]->shdr.sh_offset);
+  zero(chunks.back(), ctx.output_file->filesize);
+
+  // The build-id may have already been computed if we are writing a
+  // separate debug info file.
+  bool hash_build_id = ctx.buildid && ctx.buildid->contents.empty() &&
+                       ctx.arg.build_id.kind == BuildId::HASH;
+  if (hash_build_id)
+    start_build_id_hashing(ctx);
+
+  // With --output-io=pwrite or uring, we pass each chunk to the output
+  // file as soon as its contents become final so that it is written to
+  // the file while we are still working on other chunks. Chunks that
+  // are modified after copy_chunks() are left to OutputFile::close(),
+  // which writes all ranges that haven't been passed to write_behind().
+  auto finish = [&](Chunk<E> *chunk) {
+    if (!is_modified_later(ctx, chunk) && chunk->shdr.sh_type != SHT_NOBITS)
+      ctx.output_file->write_behind(ctx, chunk->shdr.sh_offset,
+                                    chunk->shdr.sh_size);
+
+    if (hash_build_id && !is_modified_before_build_id(ctx, chunk))
+      release_build_id_shards(ctx, chunk);
+  };
+
   auto copy = [&](Chunk<E> &chunk) {
     std::string name = chunk.name.empty() ? "(header)" : std::string(chunk.name);
     Timer t2(ctx, name, &t);
     chunk.copy_buf(ctx);
+    if (!is_shared_chunk(ctx, &chunk))
+      finish(&chunk);
   };
 
   // For --relocatable and --emit-relocs, we want to copy non-relocation
@@ -1647,27 +2033,16 @@ void copy_chunks(Context<E> &ctx) {
       copy(*chunk);
   });
 
+  tbb::parallel_for_each(ctx.chunks, [&](Chunk<E> *chunk) {
+    if (is_shared_chunk(ctx, chunk))
+      finish(chunk);
+  });
+
   // Undefined symbols in SHF_ALLOC sections are found by scan_relocations(),
   // but those in non-SHF_ALLOC sections cannot be found until we copy section
   // contents. So we need to call this function again to report possible
   // undefined errors.
   report_undef_errors(ctx);
-
-  // Zero-clear paddings between chunks
-  auto zero = [&](Chunk<E> *chunk, i64 next_start) {
-    i64 pos = chunk->shdr.sh_offset + chunk->shdr.sh_size;
-    memset(ctx.buf + pos, 0, next_start - pos);
-  };
-
-  std::vector<Chunk<E> *> chunks = ctx.chunks;
-
-  std::erase_if(chunks, [](Chunk<E> *chunk) {
-    return chunk->shdr.sh_type == SHT_NOBITS;
-  });
-
-  for (i64 i = 1; i < chunks.size(); i++)
-    zero(chunks[i - 1], chunks[i]->shdr.sh_offset);
-  zero(chunks.back(), ctx.output_file->filesize);
 }
 
 template <typename E>
@@ -2078,7 +2453,13 @@ void compute_import_export(Context<E> &ctx) {
 // significance" table in the ".llvm_addrsig" section to mark symbols
 // whose addresses are taken in code. If that table is available, we use
 // that information in this function. Otherwise, we conservatively assume
-// that all data items are address-taken.
+// that all data items are address-taken, as well as all data items
+// referenced from files without the table.
+//
+// Read-only and RELRO data that is not address-significant, such as
+// vtables or constant tables, is merged by ICF. If
+// --ignore-data-address-equality is given, ICF merges such data even if
+// it is address-significant.
 template <typename E>
 void compute_address_significance(Context<E> &ctx) {
   Timer t(ctx, "compute_address_significance");
@@ -2104,12 +2485,15 @@ void compute_address_significance(Context<E> &ctx) {
       if (!(isec->shdr().sh_flags & SHF_EXECINSTR))
         isec->address_taken = true;
 
+      // A reference from this file may take the address of a section
+      // in another file. If the other file has .llvm_addrsig, the
+      // section may not be marked by that file's table, so we need to
+      // mark it here. Any reference to data is considered address-taking.
       for (const ElfRel<E> &r : isec->get_rels(ctx))
-        if (!is_func_call_rel(r))
-          if (Symbol<E> *sym = file->symbols[r.r_sym];
-              InputSection<E> *dst = sym->get_input_section())
-            if (dst->shdr().sh_flags & SHF_EXECINSTR)
-              dst->address_taken = true;
+        if (Symbol<E> *sym = file->symbols[r.r_sym];
+            InputSection<E> *dst = sym->get_input_section())
+          if (!(dst->shdr().sh_flags & SHF_EXECINSTR) || !is_func_call_rel(r))
+            dst->address_taken = true;
     }
   });
 
@@ -2159,6 +2543,7 @@ void compute_address_significance(Context<E> &ctx) {
 //   <non-memory-allocated sections>
 //   <section header>
 //   .gdb_index
+//   .debug_names
 //
 // .interp and some other linker-synthesized sections are placed at the
 // beginning of a file because they are needed by loader. Especially on
@@ -2173,6 +2558,7 @@ void compute_address_significance(Context<E> &ctx) {
 // .gdb_index cannot be constructed before applying relocations to
 // other debug sections, so we create it after completing other part
 // of the output file and append it to the very end of the file.
+// The same is true for .debug_names if --debug-names is given.
 //
 // A PT_NOTE segment will contain multiple .note sections if exists,
 // but there's no way to represent a gap between .note sections.
@@ -2219,8 +2605,10 @@ void sort_output_sections_regular(Context<E> &ctx) {
     if (chunk == ctx.relplt)
       return 11;
     if (chunk == ctx.shdr)
-      return INT32_MAX - 1;
+      return INT32_MAX - 2;
     if (chunk == ctx.gdb_index)
+      return INT32_MAX - 1;
+    if (chunk == ctx.debug_names)
       return INT32_MAX;
 
     bool alloc = (flags & SHF_ALLOC);
@@ -2625,7 +3013,8 @@ void separate_debug_sections(Context<E> &ctx) {
   auto is_debug_section = [&](Chunk<E> *chunk) {
     if (chunk->shdr.sh_flags & SHF_ALLOC)
       return false;
-    return chunk == ctx.gdb_index || chunk == ctx.symtab || chunk == ctx.strtab ||
+    return chunk == ctx.gdb_index || chunk == ctx.debug_names ||
+           chunk == ctx.symtab || chunk == ctx.strtab ||
            chunk->name.starts_with(".debug_");
   };
 
@@ -2645,7 +3034,7 @@ void compute_section_headers(Context<E> &ctx) {
   // Remove empty chunks.
   std::erase_if(ctx.chunks, [&](Chunk<E> *chunk) {
     return !chunk->to_osec() && chunk != ctx.gdb_index &&
-           chunk->shdr.sh_size == 0;
+           chunk != ctx.debug_names && chunk->shdr.sh_size == 0;
   });
 
   // Set section indices.
@@ -2954,29 +3343,6 @@ void compress_debug_sections(Context<E> &ctx) {
     ctx.shdr->update_shdr(ctx);
 }
 
-// BLAKE3 is a cryptographic hash function just like SHA256.
-// We use it instead of SHA256 because it's faster.
-static void blake3_hash(u8 *buf, i64 size, u8 *out) {
-  blake3_hasher hasher;
-  blake3_hasher_init(&hasher);
-  blake3_hasher_update(&hasher, buf, size);
-  blake3_hasher_finalize(&hasher, out, BLAKE3_OUT_LEN);
-}
-
-template <typename E>
-std::vector<std::span<u8>> get_shards(Context<E> &ctx) {
-  constexpr i64 shard_size = 4 * 1024 * 1024; // 4 MiB
-  std::span<u8> buf = {ctx.buf, (size_t)ctx.output_file->filesize};
-  std::vector<std::span<u8>> vec;
-
-  while (!buf.empty()) {
-    i64 sz = std::min<i64>(shard_size, buf.size());
-    vec.push_back(buf.subspan(0, sz));
-    buf = buf.subspan(sz);
-  }
-  return vec;
-}
-
 template <typename E>
 void write_build_id(Context<E> &ctx) {
   Timer t(ctx, "write_build_id");
@@ -2986,26 +3352,24 @@ void write_build_id(Context<E> &ctx) {
     ctx.buildid->contents = ctx.arg.build_id.value;
     break;
   case BuildId::HASH: {
-    std::vector<std::span<u8>> shards = get_shards(ctx);
-    std::vector<u8> hashes(shards.size() * BLAKE3_OUT_LEN);
-
-    tbb::parallel_for((i64)0, (i64)shards.size(), [&](i64 i) {
-      blake3_hash(shards[i].data(), shards[i].size(),
-                  hashes.data() + i * BLAKE3_OUT_LEN);
+    // Most shards have already been hashed by copy_chunks(). Hash the
+    // rest, which overlap with chunks that have been modified since.
+    BuildIdSection<E> &sec = *ctx.buildid;
 
-#ifdef HAVE_MADVISE
-      // Make the kernel page out the file contents we've just written
-      // so that subsequent close(2) call will become quicker.
-      if (i > 0 && ctx.output_file->is_mmapped)
-        madvise(begin, end - begin, MADV_DONTNEED);
-#endif
+    tbb::parallel_for_each(ctx.chunks, [&](Chunk<E> *chunk) {
+      if (is_modified_before_build_id(ctx, chunk))
+        release_build_id_shards(ctx, chunk);
     });
 
     u8 buf[BLAKE3_OUT_LEN];
-    blake3_hash(hashes.data(), hashes.size(), buf);
+    blake3_hash(sec.shard_hashes.data(), sec.shard_hashes.size(), buf);
 
     assert(ctx.arg.build_id.size() <= BLAKE3_OUT_LEN);
     ctx.buildid->contents = {buf, buf + ctx.arg.build_id.size()};
+
+    sec.shards = {};
+    sec.shard_hashes = {};
+    sec.shard_refcnt = {};
     break;
   }
   case BuildId::UUID: {
@@ -3112,6 +3476,8 @@ void write_separate_debug_file(Context<E> &ctx) {
 
   if (ctx.gdb_index)
     write_gdb_index(ctx);
+  if (ctx.debug_names)
+    write_debug_names(ctx);
 
   // Reverse-compute a CRC32 value so that the CRC32 checksum embedded to
   // the .gnu_debuglink section in the main executable matches with the
@@ -3155,6 +3521,19 @@ void write_dependency_file(Context<E> &ctx) {
   out.close();
 }
 
+// Write timer records to a file specified by --perf-trace.
+template <typename E>
+void write_perf_trace(Context<E> &ctx) {
+  std::ofstream out;
+  out.open(ctx.arg.perf_trace);
+  if (out.fail())
+    Fatal(ctx) << "--perf-trace: cannot open " << ctx.arg.perf_trace
+               << ": " << errno_string();
+
+  write_chrome_trace(ctx.timer_records, out);
+  out.close();
+}
+
 template <typename E>
 void show_stats(Context<E> &ctx) {
   for (ObjectFile<E> *obj : ctx.objs) {
@@ -3247,6 +3626,11 @@ template void sort_init_fini(Context<E> &);
 template void sort_ctor_dtor(Context<E> &);
 template void fixup_ctors_in_init_array(Context<E> &);
 template void shuffle_sections(Context<E> &);
+template void
+reorder_input_sections(Context<E> &,
+                       const std::unordered_map<InputSection<E> *, i64> &);
+template void sort_sections_by_symbol_order(Context<E> &);
+template void sort_sections_by_data_access_trace(Context<E> &);
 template void compute_section_sizes(Context<E> &);
 template void sort_output_sections(Context<E> &);
 template void claim_unresolved_symbols(Context<E> &);
@@ -3254,6 +3638,7 @@ template void compute_imported_symbol_weakness(Context<E> &);
 template void scan_relocations(Context<E> &);
 template void report_undef_errors(Context<E> &);
 template void create_reloc_sections(Context<E> &);
+template void compute_reloc_addrs(Context<E> &);
 template void copy_chunks(Context<E> &);
 template void construct_relr(Context<E> &);
 template void sort_dynsyms(Context<E> &);
@@ -3271,6 +3656,7 @@ template void write_build_id(Context<E> &);
 template void write_gnu_debuglink(Context<E> &);
 template void write_separate_debug_file(Context<E> &);
 template void write_dependency_file(Context<E> &);
+template void write_perf_trace(Context<E> &);
 template void show_stats(Context<E> &);
 
 } // namespace mold
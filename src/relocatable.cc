@@ -185,6 +185,9 @@ void combine_objects(Context<E> &ctx) {
   if (ctx.arg.perf)
     print_timer_records(ctx.timer_records);
 
+  if (!ctx.arg.perf_trace.empty())
+    write_perf_trace(ctx);
+
   if (ctx.arg.quick_exit)
     _exit(0);
 }
@@ -0,0 +1,33 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+cat <<EOF | $CC -o $t/a.o -c -xc -ffunction-sections -
+void f1() {}
+void f2() {}
+void f3() {}
+void f4() {}
+int main() { f1(); f2(); f3(); f4(); }
+EOF
+
+# A .llvm.call-graph-profile section as Clang would emit with PGO
+cat <<EOF | $CC -o $t/b.o -c -xassembler -
+.section .llvm.call-graph-profile,"e",@0x6fff4c09
+.reloc 0, BFD_RELOC_NONE, main
+.reloc 0, BFD_RELOC_NONE, f4
+.quad 100
+.reloc 8, BFD_RELOC_NONE, f4
+.reloc 8, BFD_RELOC_NONE, f2
+.quad 50
+EOF
+
+get_order() {
+  nm -n $1 | grep -E ' (main|f[1-4])$' | awk '{print $3}' | tr '\n' ' '
+}
+
+$CC -B. -o $t/exe1 $t/a.o $t/b.o
+$QEMU $t/exe1
+[ "$(get_order $t/exe1)" = 'main f4 f2 f1 f3 ' ]
+! readelf -SW $t/exe1 | grep -q call-graph-profile || false
+
+$CC -B. -o $t/exe2 $t/a.o $t/b.o -Wl,--no-call-graph-profile-sort
+[ "$(get_order $t/exe2)" = 'f1 f2 f3 f4 main ' ]
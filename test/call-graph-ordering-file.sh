@@ -0,0 +1,37 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+[ $MACHINE = ppc64 ] && skip
+
+cat <<EOF | $CC -o $t/a.o -c -xc -ffunction-sections -
+void f1() {}
+void f2() {}
+void f3() {}
+void f4() {}
+int main() { f1(); f2(); f3(); f4(); }
+EOF
+
+cat <<EOF > $t/order
+main f4 100
+f4 f2 50
+EOF
+
+get_order() {
+  nm -n $1 | grep -E ' (main|f[1-4])$' | awk '{print $3}' | tr '\n' ' '
+}
+
+$CC -B. -o $t/exe1 $t/a.o -Wl,--call-graph-ordering-file=$t/order
+$QEMU $t/exe1
+[ "$(get_order $t/exe1)" = 'main f4 f2 f1 f3 ' ]
+
+$CC -B. -o $t/exe2 $t/a.o -Wl,--call-graph-ordering-file=$t/order \
+  -Wl,--no-call-graph-profile-sort
+[ "$(get_order $t/exe2)" = 'f1 f2 f3 f4 main ' ]
+
+echo 'f1 foo 10' > $t/order2
+$CC -B. -o $t/exe3 $t/a.o -Wl,--call-graph-ordering-file=$t/order2 2> $t/log
+grep -q 'no such symbol: foo' $t/log
+
+echo 'f1 f2' > $t/order3
+! $CC -B. -o $t/exe4 $t/a.o -Wl,--call-graph-ordering-file=$t/order3 2> $t/log || false
+grep -q 'parse error: f1 f2' $t/log
@@ -0,0 +1,22 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+cat <<EOF | $CC -c -g -o $t/a.o -xc -
+#include <stdio.h>
+int main() { printf("Hello world\n"); }
+EOF
+
+$CC -B. -o $t/exe1 $t/a.o
+$CC -B. -o $t/exe2 $t/a.o -Wl,--compress-debug-sections=zlib:9
+
+readelf -WS $t/exe2 | grep -q '\.debug_info .* [Cx] '
+
+readelf -x .debug_info $t/exe1 > $t/log1
+readelf -zx .debug_info $t/exe2 > $t/log2
+diff -q $t/log1 $t/log2
+
+$CC -B. -o $t/exe3 $t/a.o -Wl,--compress-debug-sections=zstd:19
+readelf -WS $t/exe3 | grep -q '\.debug_info .* [Cx] '
+
+! $CC -B. -o $t/exe4 $t/a.o -Wl,--compress-debug-sections=zlib:10 >& $t/log
+grep -q 'invalid compression level' $t/log
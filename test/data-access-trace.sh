@@ -0,0 +1,37 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+cat <<EOF | $CC -o $t/a.o -c -xc -fdata-sections -
+#include <stdio.h>
+int d1 = 1;
+int d2 = 2;
+int d3 = 3;
+static int d4 = 4;
+const int r1 = 1;
+const int r2 = 2;
+const int r3 = 3;
+int *p = &d4;
+int main() { printf("%d %d %d %d %d\n", d1, d2, d3, *p, r1 + r2 + r3); }
+EOF
+
+cat <<EOF > $t/trace
+d3 300   # a comment
+.rodata.r2 10
+r3 20
+d4 100
+d3 50
+foo 1
+EOF
+
+get_order() {
+  nm -n $1 | grep -E " ($2)\$" | awk '{print $3}' | tr '\n' ' '
+}
+
+$CC -B. -o $t/exe1 $t/a.o -Wl,--data-access-trace=$t/trace
+$QEMU $t/exe1 | grep -q '1 2 3 4 6'
+[ "$(get_order $t/exe1 'd[1-4]')" = 'd3 d4 d1 d2 ' ]
+[ "$(get_order $t/exe1 'r[1-3]')" = 'r2 r3 r1 ' ]
+
+echo 'd1' > $t/trace2
+! $CC -B. -o $t/exe2 $t/a.o -Wl,--data-access-trace=$t/trace2 2> $t/log || false
+grep -q 'parse error: d1' $t/log
@@ -0,0 +1,44 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+command -v llvm-dwarfdump >& /dev/null || skip
+test_cflags -gdwarf-5 -g || skip
+
+cat <<EOF | $CC -c -o $t/a.o -xc -gdwarf-5 -ffunction-sections -
+typedef struct { int member; } my_struct_type;
+my_struct_type my_global_var;
+int my_used_function(void) { return my_global_var.member; }
+int my_unused_function(void) { return 42; }
+EOF
+
+cat <<EOF | $CC -c -o $t/b.o -xc -gdwarf-4 -
+int my_used_function(void);
+int main() { return my_used_function(); }
+EOF
+
+$CC -B. -o $t/exe1 $t/a.o $t/b.o -Wl,--gc-sections -Wl,--debug-names
+$QEMU $t/exe1
+
+llvm-dwarfdump --debug-names $t/exe1 > $t/log
+grep -q 'CU count: 2' $t/log
+grep -q '"my_struct_type"' $t/log
+grep -q '"my_global_var"' $t/log
+grep -q '"my_used_function"' $t/log
+grep -q '"main"' $t/log
+! grep -q '"my_unused_function"' $t/log || false
+
+# Input .debug_names sections are discarded.
+echo foo > $t/foo.txt
+objcopy --add-section .debug_names=$t/foo.txt $t/b.o $t/c.o
+$CC -B. -o $t/exe2 $t/a.o $t/c.o -Wl,--debug-names
+[ "$(readelf -SW $t/exe2 | grep -c ' \.debug_names ')" = 1 ]
+llvm-dwarfdump --debug-names $t/exe2 | grep -q '"my_used_function"'
+
+$CC -B. -o $t/exe3 $t/a.o $t/b.o -Wl,--debug-names -Wl,--no-threads
+$CC -B. -o $t/exe4 $t/a.o $t/b.o -Wl,--debug-names
+cmp $t/exe3 $t/exe4
+
+$CC -B. -o $t/exe5 $t/a.o $t/b.o -Wl,--debug-names -Wl,--gdb-index \
+  -Wl,--compress-debug-sections=zlib
+llvm-dwarfdump --debug-names $t/exe5 | grep -q '"my_global_var"'
+readelf -SW $t/exe5 | grep -q '\.gdb_index'
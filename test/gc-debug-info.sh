@@ -0,0 +1,39 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+cat <<EOF | $CC -c -o $t/a.o -g -ffunction-sections -xc -
+#include <stdio.h>
+
+void dead1() { printf("dead1\n"); }
+void live() { printf("live\n"); }
+void dead2() { printf("dead2\n"); }
+
+int main() {
+  live();
+}
+EOF
+
+cat <<EOF > $t/dead.c
+#include <stdio.h>
+void dead3() { printf("dead3\n"); }
+EOF
+
+$CC -c -o $t/b.o -g -ffunction-sections $t/dead.c
+
+$CC -B. -o $t/exe1 $t/a.o $t/b.o -Wl,--gc-sections
+$CC -B. -o $t/exe2 $t/a.o $t/b.o -Wl,--gc-sections,--gc-debug-info
+$QEMU $t/exe2 | grep -q live
+
+# The compunit for dead.c is removed entirely
+readelf --debug-dump=info $t/exe1 > $t/log1
+readelf --debug-dump=info $t/exe2 > $t/log2
+grep -q dead.c $t/log1
+! grep -q dead.c $t/log2 || false
+
+# Line number sequences for dead1 and dead2 are removed
+$OBJCOPY --dump-section .debug_line=$t/line1 $t/exe1
+$OBJCOPY --dump-section .debug_line=$t/line2 $t/exe2
+[ $(wc -c < $t/line2) -lt $(wc -c < $t/line1) ]
+
+readelf --debug-dump=decodedline $t/exe2 > $t/log 2>&1
+! grep -qi warning $t/log || false
@@ -0,0 +1,38 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+[ $MACHINE = $(uname -m) ] || skip
+
+echo 'int main() {}' | clang++ -faddrsig -o /dev/null -xc++ - >& /dev/null \
+  || skip
+
+# Clang emits vtables as unnamed_addr, so they are not listed in
+# .llvm_addrsig. Once A::foo and B::foo are merged, the vtables of A
+# and B become identical and can be merged too. tbl1 and tbl2 are
+# address-significant, so they must not be merged.
+cat <<EOF | clang++ -c -o $t/a.o -faddrsig -fno-rtti -ffunction-sections \
+  -fdata-sections -xc++ -
+#include <stdio.h>
+
+struct A { virtual int foo() { return 1; } virtual int bar() { return 2; } };
+struct B { virtual int foo() { return 1; } virtual int bar() { return 2; } };
+
+const int tbl1[] = { 1, 2, 3, 4 };
+const int tbl2[] = { 1, 2, 3, 4 };
+
+int main() {
+  A a;
+  B b;
+  A *volatile pa = &a;
+  B *volatile pb = &b;
+  const int *volatile p[] = { tbl1, tbl2 };
+  printf("%d %d %d\n", pa->foo() + pb->bar(),
+         *(void **)pa == *(void **)pb, p[0] == p[1]);
+}
+EOF
+
+clang++ -B. -o $t/exe1 $t/a.o
+$QEMU $t/exe1 | grep -q '^3 0 0$'
+
+clang++ -B. -o $t/exe2 $t/a.o -Wl,--icf=all
+$QEMU $t/exe2 | grep -q '^3 1 0$'
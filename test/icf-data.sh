@@ -0,0 +1,52 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+[ $MACHINE = ppc64 ] && skip
+
+cat <<EOF | $CC -c -o $t/a.o -xassembler -
+.section .text.foo,"ax"
+.globl foo
+foo:
+.byte 1, 2, 3, 4, 5, 6, 7, 8
+
+.section .rodata.bar,"a"
+.globl bar
+bar:
+.byte 1, 2, 3, 4, 5, 6, 7, 8
+
+.section .rodata.baz1,"a"
+.balign 8
+.globl baz1
+baz1:
+.byte 1, 2, 3, 4, 5, 6, 7, 8
+
+.section .rodata.baz2,"a"
+.balign 64
+.globl baz2
+baz2:
+.byte 1, 2, 3, 4, 5, 6, 7, 8
+EOF
+
+cat <<EOF | $CC -c -o $t/b.o -fPIC -ffunction-sections -fdata-sections -xc -
+#include <stdio.h>
+
+extern char foo[], bar[], baz1[], baz2[];
+
+int f1() { return 1; }
+int f2() { return 2; }
+
+const void *const tbl1[] = { f1, f2 };
+const void *const tbl2[] = { f1, f2 };
+
+int main() {
+  char *volatile p[] = { foo, bar, baz1, baz2, (char *)tbl1, (char *)tbl2 };
+  printf("%d %d %d %d %d\n", p[0] == p[1], p[2] == p[3],
+         (long)p[3] % 64 == 0, p[4] == p[5], tbl1[1] == f2);
+}
+EOF
+
+$CC -B. -o $t/exe1 $t/a.o $t/b.o
+$QEMU $t/exe1 | grep -q '^0 0 1 0 1$'
+
+$CC -B. -o $t/exe2 $t/a.o $t/b.o -Wl,--icf=all,--ignore-data-address-equality
+$QEMU $t/exe2 | grep -q '^0 0 1 1 1$'
@@ -0,0 +1,57 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+[ $MACHINE = ppc64 ] && skip
+
+cat <<EOF | $CC -c -o $t/a.o -ffunction-sections -xc -
+#include <stdio.h>
+int foo1(int x);
+int foo2(int x);
+int bar(int x) { return x; }
+int main() {
+  printf("%d %d\n", (long)foo1 == (long)foo2, foo1(3) + foo2(4));
+}
+EOF
+
+# foo1 and foo2 have relocations, so their digests are not computed
+# by comparing their contents as leaf sections but read from the cache.
+cat <<EOF > $t/b.c
+int bar(int x);
+int foo1(int x) { return bar(x) * 7; }
+int foo2(int x) { return bar(x) * 7; }
+EOF
+
+$CC -c -o $t/b.o -ffunction-sections $t/b.c
+
+rm -rf $t/cache
+$CC -B. -o $t/exe1 $t/a.o $t/b.o -Wl,--icf=all
+$CC -B. -o $t/exe2 $t/a.o $t/b.o -Wl,--icf=all,--input-cache=$t/cache
+$QEMU $t/exe2 | grep -q '^1 49$'
+ls $t/cache | grep -q '\.icf$'
+cmp $t/exe1 $t/exe2
+
+$CC -B. -o $t/exe3 $t/a.o $t/b.o -Wl,--icf=all,--input-cache=$t/cache
+cmp $t/exe1 $t/exe3
+
+# Cache entries are keyed by file contents, not by mtime
+ls $t/cache > $t/log1
+touch $t/b.o
+$CC -B. -o $t/exe3 $t/a.o $t/b.o -Wl,--icf=all,--input-cache=$t/cache
+ls $t/cache > $t/log2
+diff $t/log1 $t/log2
+
+# Corrupted cache files are ignored
+for f in $t/cache/*.icf; do printf 'foo' > $f; done
+$CC -B. -o $t/exe4 $t/a.o $t/b.o -Wl,--icf=all,--input-cache=$t/cache
+cmp $t/exe1 $t/exe4
+
+# An updated input file is hashed again
+cat <<EOF > $t/b.c
+int bar(int x);
+int foo1(int x) { return bar(x) * 7; }
+int foo2(int x) { return bar(x) * 9; }
+EOF
+
+$CC -c -o $t/b.o -ffunction-sections $t/b.c
+$CC -B. -o $t/exe5 $t/a.o $t/b.o -Wl,--icf=all,--input-cache=$t/cache
+$QEMU $t/exe5 | grep -q '^0 57$'
@@ -0,0 +1,53 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+# On PPC64V1, function pointers refer function descriptors in .opd
+# instead of directly referring .text section. We create a .opd entry
+# for each symbol. So function pointer comparison on two different
+# symbols are always the same, even if their function body are at the
+# same location.
+[ $MACHINE = ppc64 ] && skip
+
+cat <<EOF | $CC -c -o $t/a.o -ffunction-sections -fdata-sections -xc -
+#include <stdio.h>
+
+int bar() {
+  return 5;
+}
+
+int foo1(int x) {
+  return bar() + x;
+}
+
+int foo2(int x) {
+  return bar() + x;
+}
+
+int foo3() {
+  bar();
+  return 5;
+}
+
+int C(int x);
+int D(int x);
+
+__attribute__((noinline)) int A(int x) { return x ? C(x - 1) + 1 : 0; }
+__attribute__((noinline)) int B(int x) { return x ? D(x - 1) + 1 : 0; }
+__attribute__((noinline)) int C(int x) { return x ? A(x - 1) + 2 : 0; }
+__attribute__((noinline)) int D(int x) { return x ? B(x - 1) + 2 : 0; }
+
+int main() {
+  printf("%d %d %d\n", (long)foo1 == (long)foo2, (long)foo1 == (long)foo3,
+         (long)A == (long)B);
+  return 0;
+}
+EOF
+
+$CC -B. -o $t/exe1 $t/a.o -Wl,--icf=all,--icf-algorithm=refine
+$QEMU $t/exe1 | grep -q '1 0 1'
+
+$CC -B. -o $t/exe2 $t/a.o -Wl,--icf=all,--icf-algorithm=hash \
+  -Wl,--print-icf-sections | sort > $t/log2
+$CC -B. -o $t/exe3 $t/a.o -Wl,--icf=all,--icf-algorithm=refine \
+  -Wl,--print-icf-sections | sort > $t/log3
+diff $t/log2 $t/log3
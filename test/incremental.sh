@@ -0,0 +1,109 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+cat <<EOF > $t/a.c
+#include <stdio.h>
+int foo();
+char msg[] = "incremental-marker";
+int main() { printf("%s %d\n", msg, foo()); }
+EOF
+
+echo 'int foo() { return 3; }' > $t/b.c
+
+$CC -c -o $t/a.o $t/a.c
+$CC -c -o $t/b.o $t/b.c
+$CC -B. -o $t/exe $t/a.o $t/b.o -Wl,--incremental
+$QEMU $t/exe | grep -q '^incremental-marker 3$'
+[ -f $t/exe.incremental ]
+
+# Change the code without changing its size
+echo 'int foo() { return 4; }' > $t/b.c
+$CC -c -o $t/b.o $t/b.c
+$CC -B. -o $t/exe $t/a.o $t/b.o -Wl,--incremental
+$QEMU $t/exe | grep -q '^incremental-marker 4$'
+
+rm -f $t/exe2
+$CC -B. -o $t/exe2 $t/a.o $t/b.o -Wl,--incremental
+cmp $t/exe $t/exe2
+
+# Sections of unchanged files are not rewritten
+touch -r $t/exe $t/stamp
+off=$(grep -obUa incremental-marker $t/exe | head -1 | cut -d: -f1)
+printf X | dd of=$t/exe bs=1 seek=$off conv=notrunc 2> /dev/null
+touch -r $t/stamp $t/exe
+$CC -B. -o $t/exe $t/a.o $t/b.o -Wl,--incremental
+$QEMU $t/exe | grep -q '^Xncremental-marker 4$'
+
+touch $t/a.o
+$CC -B. -o $t/exe $t/a.o $t/b.o -Wl,--incremental
+$QEMU $t/exe | grep -q '^incremental-marker 4$'
+cmp $t/exe $t/exe2
+
+# A layout change results in a full link
+cat <<EOF > $t/b.c
+int bar() { return 6; }
+int foo() { return 5; }
+EOF
+
+$CC -c -o $t/b.o $t/b.c
+$CC -B. -o $t/exe $t/a.o $t/b.o -Wl,--incremental
+$QEMU $t/exe | grep -q '^incremental-marker 5$'
+
+rm -f $t/exe2
+$CC -B. -o $t/exe2 $t/a.o $t/b.o -Wl,--incremental
+cmp $t/exe $t/exe2
+
+# Input sections are padded only on targets that don't create range
+# extension thunks or shrink sections
+case $MACHINE in
+x86_64 | i686 | s390x | sh4 | m68k) ;;
+*) exit ;;
+esac
+
+# Start over so that slack is reserved for the current files
+rm -f $t/exe.incremental $t/exe2.incremental
+$CC -B. -o $t/exe $t/a.o $t/b.o -Wl,--incremental
+$CC -B. -o $t/exe2 $t/a.o $t/b.o -Wl,--incremental
+
+# An input section can grow in place. a.o is not rewritten because
+# foo doesn't move.
+cat <<EOF > $t/b.c
+int bar() { return 6; }
+int foo() { volatile int x = 8; return x; }
+EOF
+
+$CC -c -o $t/b.o $t/b.c
+touch -r $t/exe $t/stamp
+off=$(grep -obUa incremental-marker $t/exe | head -1 | cut -d: -f1)
+printf X | dd of=$t/exe bs=1 seek=$off conv=notrunc 2> /dev/null
+touch -r $t/stamp $t/exe
+$CC -B. -o $t/exe $t/a.o $t/b.o -Wl,--incremental
+$QEMU $t/exe | grep -q '^Xncremental-marker 8$'
+
+# If foo moves, a.o is rewritten with its relocations applied again
+cat <<EOF > $t/b.c
+int bar() { volatile int x = 6; return x; }
+int foo() { volatile int x = 9; return x; }
+EOF
+
+$CC -c -o $t/b.o $t/b.c
+$CC -B. -o $t/exe $t/a.o $t/b.o -Wl,--incremental
+$QEMU $t/exe | grep -q '^incremental-marker 9$'
+
+rm -f $t/exe2
+$CC -B. -o $t/exe2 $t/a.o $t/b.o -Wl,--incremental
+cmp $t/exe $t/exe2
+
+# If an input section outgrows its slack, we fall back to a full link
+cat <<EOF > $t/b.c
+int bar() { volatile int x = 6; $(for i in $(seq 30); do echo -n 'x++; '; done) return x; }
+int foo() { volatile int x = 10; return x; }
+EOF
+
+$CC -c -o $t/b.o $t/b.c
+$CC -B. -o $t/exe $t/a.o $t/b.o -Wl,--incremental
+$QEMU $t/exe | grep -q '^incremental-marker 10$'
+
+rm -f $t/exe2
+$CC -B. -o $t/exe2 $t/a.o $t/b.o -Wl,--incremental
+cmp $t/exe $t/exe2
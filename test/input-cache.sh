@@ -0,0 +1,38 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+cat <<EOF | $CC -c -o $t/a.o -xc -g -
+#include <stdio.h>
+const char *foo();
+int main() { printf("%s %s\n", "Hello", foo()); }
+EOF
+
+cat <<EOF > $t/b.c
+const char *foo() { return "world"; }
+EOF
+
+$CC -c -o $t/b.o -g $t/b.c
+
+rm -rf $t/cache
+$CC -B. -o $t/exe1 $t/a.o $t/b.o
+$CC -B. -o $t/exe2 $t/a.o $t/b.o -Wl,--input-cache=$t/cache
+$QEMU $t/exe2 | grep -q 'Hello world'
+[ "$(ls $t/cache | wc -l)" -gt 0 ]
+cmp $t/exe1 $t/exe2
+
+$CC -B. -o $t/exe3 $t/a.o $t/b.o -Wl,--input-cache=$t/cache
+cmp $t/exe1 $t/exe3
+
+# Corrupted cache files are ignored
+for f in $t/cache/*; do printf 'foo' > $f; done
+$CC -B. -o $t/exe4 $t/a.o $t/b.o -Wl,--input-cache=$t/cache
+cmp $t/exe1 $t/exe4
+
+# An updated input file is not read from the cache
+cat <<EOF > $t/b.c
+const char *foo() { return "mold"; }
+EOF
+
+$CC -c -o $t/b.o -g $t/b.c
+$CC -B. -o $t/exe5 $t/a.o $t/b.o -Wl,--input-cache=$t/cache
+$QEMU $t/exe5 | grep -q 'Hello mold'
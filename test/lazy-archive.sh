@@ -0,0 +1,50 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+cat <<EOF | $CC -o $t/a.o -c -xc -
+#include <stdio.h>
+int foo();
+int main() { printf("%d\n", foo()); }
+EOF
+
+cat <<EOF | $CC -o $t/b.o -c -xc -
+int baz();
+int foo() { return baz() + 1; }
+EOF
+
+cat <<EOF | $CC -o $t/c.o -c -xc -
+int baz() { return 41; }
+EOF
+
+cat <<EOF | $CC -o $t/d.o -c -xc -
+int unused1() { return 0; }
+EOF
+
+cat <<EOF | $CC -o $t/e.o -c -xc -
+int unused2() { return 0; }
+EOF
+
+rm -f $t/f.a
+ar rcs $t/f.a $t/c.o $t/d.o $t/b.o $t/e.o
+
+$CC -B. -Wl,--trace -o $t/exe $t/a.o $t/f.a > $t/log
+$QEMU $t/exe | grep -q '^42$'
+grep -Fq 'f.a(b.o)' $t/log
+grep -Fq 'f.a(c.o)' $t/log
+! grep -Fq 'f.a(d.o)' $t/log || false
+! grep -Fq 'f.a(e.o)' $t/log || false
+
+$CC -B. -Wl,--trace -o $t/exe $t/a.o $t/f.a -Wl,-u,unused1 > $t/log
+grep -Fq 'f.a(d.o)' $t/log
+! grep -Fq 'f.a(e.o)' $t/log || false
+readelf --symbols $t/exe | grep -q ' unused1$'
+
+$CC -B. -Wl,--trace -o $t/exe $t/a.o $t/f.a -Wl,--undefined-glob='unused*' > $t/log
+grep -Fq 'f.a(d.o)' $t/log
+grep -Fq 'f.a(e.o)' $t/log
+
+# Archives without a symbol table are read eagerly
+rm -f $t/g.a
+ar rcS $t/g.a $t/c.o $t/d.o $t/b.o $t/e.o
+$CC -B. -o $t/exe $t/a.o $t/g.a
+$QEMU $t/exe | grep -q '^42$'
@@ -0,0 +1,31 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+[ -x ./mold-bench ] || skip
+on_qemu && skip
+
+rm -rf $t/bench1 $t/bench2
+
+opts="--cc=$CC --objects=10 --symbols=5 --archives=1 --archive-members=3 \
+  --dsos=1 --dso-objects=2 --runs=2 --warmup=0 -j4"
+
+./mold-bench $opts --dir=$t/bench1 -o $t/report.json -- --gc-sections
+grep -q '^  "config": {"objects":10,"symbols":5,' $t/report.json
+grep -q '{"name":"resolve_symbols","real_ms":[0-9.e-]*,"user_ms":' $t/report.json
+grep -q '^  "median": {"wall_ms":' $t/report.json
+grep -q '{"name":"gc",' $t/report.json
+
+readelf --dynamic $t/bench1/bench.out | grep -q 'libbenchdso0.so'
+readelf --sections $t/bench1/bench.out | grep -q '\.debug_info'
+readelf --sections $t/bench1/bench.out | grep -q '\.eh_frame'
+
+# Generated files are reproducible
+./mold-bench $opts --dir=$t/bench2 -o /dev/null
+cmp $t/bench1/u7.cc $t/bench2/u7.cc
+cmp $t/bench1/libbench0.a $t/bench2/libbench0.a
+
+./mold-bench $opts --dir=$t/bench2 --seed=2 -o /dev/null
+! cmp $t/bench1/u7.cc $t/bench2/u7.cc >& /dev/null || false
+
+! ./mold-bench --foo 2> $t/log || false
+grep -q 'unknown command line option: --foo' $t/log
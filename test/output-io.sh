@@ -0,0 +1,32 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+cat <<EOF | $CC -o $t/a.o -c -xc -g -
+#include <stdio.h>
+int main() { printf("Hello world\n"); }
+EOF
+
+$CC -B. -o $t/exe1 $t/a.o -Wl,--output-io=mmap
+$QEMU $t/exe1 | grep -q 'Hello world'
+
+$CC -B. -o $t/exe2 $t/a.o -Wl,--output-io=pwrite
+$QEMU $t/exe2 | grep -q 'Hello world'
+cmp $t/exe1 $t/exe2
+
+$CC -B. -o $t/exe3 $t/a.o -Wl,--output-io=uring
+$QEMU $t/exe3 | grep -q 'Hello world'
+cmp $t/exe1 $t/exe3
+
+# Overwrite an existing file
+$CC -B. -o $t/exe2 $t/a.o -Wl,--output-io=pwrite,--build-id
+$QEMU $t/exe2 | grep -q 'Hello world'
+
+$CC -B. -o $t/exe4 $t/a.o -Wl,--output-io=pwrite,--build-id
+cmp $t/exe2 $t/exe4
+
+! $CC -B. -o $t/exe5 $t/a.o -Wl,--output-io=foo 2> $t/log || false
+grep -q 'unknown --output-io argument: foo' $t/log
+
+$CC -B. -o $t/exe6 $t/a.o -Wl,--output-io=mmap,--gdb-index
+$CC -B. -o $t/exe7 $t/a.o -Wl,--output-io=uring,--gdb-index
+cmp $t/exe6 $t/exe7
@@ -0,0 +1,16 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+cat <<EOF | $CC -o $t/a.o -c -xc -
+#include <stdio.h>
+int main() { printf("Hello world\n"); }
+EOF
+
+$CC -B. -o $t/exe $t/a.o -Wl,--perf-trace=$t/trace.json
+$QEMU $t/exe | grep -q 'Hello world'
+
+grep -q '^{"traceEvents":\[' $t/trace.json
+grep -q '"name":"read_input_files","cat":"phase","ph":"X"' $t/trace.json
+grep -q '"name":"copy_chunks"' $t/trace.json
+grep -q '"name":"[^"]*a.o","cat":"task"' $t/trace.json
+tail -1 $t/trace.json | grep -q '"displayTimeUnit":"ms"}$'
@@ -0,0 +1,35 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+cat <<EOF | $CC -c -o $t/a.o -xassembler -
+.section .debug_foo,"",@progbits
+.fill 4096, 1, 0x41
+EOF
+
+$OBJCOPY --compress-debug-sections=zstd $t/a.o $t/b.o >& /dev/null || skip
+readelf -WS $t/b.o | grep -q '\.debug_foo .* C ' || skip
+
+cat <<EOF | $CC -c -o $t/c.o -xc -
+int main() { return 0; }
+EOF
+
+$CC -B. -o $t/exe1 $t/b.o $t/c.o \
+  -Wl,--compress-debug-sections=zstd,--reuse-compressed-debug-sections
+
+# The compressed section should be copied as-is
+$OBJCOPY --dump-section .debug_foo=$t/foo1 $t/b.o
+$OBJCOPY --dump-section .debug_foo=$t/foo2 $t/exe1
+cmp $t/foo1 $t/foo2
+
+cat <<EOF | $CC -c -o $t/d.o -xassembler -
+.section .debug_foo,"",@progbits
+.fill 4096, 1, 0x42
+EOF
+
+$CC -B. -o $t/exe2 $t/b.o $t/c.o $t/d.o
+$CC -B. -o $t/exe3 $t/b.o $t/c.o $t/d.o \
+  -Wl,--compress-debug-sections=zstd,--reuse-compressed-debug-sections
+
+readelf -x .debug_foo $t/exe2 > $t/log2
+readelf -zx .debug_foo $t/exe3 > $t/log3
+diff -q $t/log2 $t/log3
@@ -0,0 +1,16 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+[ -x ./split-strings-bench ] || skip
+on_qemu && skip
+
+# The benchmark fails if any SIMD implementation disagrees with the
+# scalar one.
+./split-strings-bench --size=1 --runs=1 > $t/log
+grep -q '^scalar ' $t/log
+grep -q '^batched ' $t/log
+
+./split-strings-bench --size=1 --runs=1 --average-length=3 --seed=7 > /dev/null
+
+! ./split-strings-bench --foo=1 2> $t/log || false
+grep -q 'unknown command line option: --foo' $t/log
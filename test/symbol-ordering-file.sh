@@ -0,0 +1,56 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+[ $MACHINE = ppc64 ] && skip
+
+cat <<EOF | $CC -o $t/a.o -c -xc -ffunction-sections -fdata-sections -
+#include <stdio.h>
+int d1 = 1;
+int d2 = 2;
+int d3 = 3;
+void f1() {}
+void f2() {}
+void f3() {}
+void f4() {}
+static void s1() {}
+int main() { f1(); f2(); f3(); f4(); s1(); puts("Hello world"); }
+EOF
+
+cat <<EOF > $t/order
+f3
+d2
+s1   # a local symbol
+f1
+d1
+EOF
+
+get_order() {
+  nm -n $1 | grep -E " ($2)\$" | awk '{print $3}' | tr '\n' ' '
+}
+
+$CC -B. -o $t/exe1 $t/a.o -Wl,--symbol-ordering-file=$t/order
+$QEMU $t/exe1 | grep -q 'Hello world'
+[ "$(get_order $t/exe1 'main|f[1-4]|s1')" = 'f3 s1 f1 f2 f4 main ' ]
+[ "$(get_order $t/exe1 'd[1-3]')" = 'd2 d1 d3 ' ]
+
+cat <<EOF > $t/order2
+f2
+foo
+f2
+puts
+EOF
+
+$CC -B. -o $t/exe2 $t/a.o -Wl,--symbol-ordering-file=$t/order2 2> $t/log
+grep -q 'no such symbol: foo' $t/log
+grep -q 'symbol specified multiple times: f2' $t/log
+grep -q 'unable to order shared symbol: puts' $t/log
+[ "$(get_order $t/exe2 'main|f[1-4]')" = 'f2 f1 f3 f4 main ' ]
+
+$CC -B. -o $t/exe3 $t/a.o -Wl,--symbol-ordering-file=$t/order2 \
+  -Wl,--no-warn-symbol-ordering 2> $t/log
+! grep -q symbol-ordering-file $t/log || false
+
+echo 'f1 f2 10' > $t/cg
+! $CC -B. -o $t/exe4 $t/a.o -Wl,--symbol-ordering-file=$t/order \
+  -Wl,--call-graph-ordering-file=$t/cg 2> $t/log || false
+grep -q 'may not be used together' $t/log
@@ -0,0 +1,43 @@
+#!/bin/bash
+. $(dirname $0)/common.inc
+
+cat <<EOF | $CC -o $t/a.o -c -xc -O -
+#include <stdio.h>
+const char *s1 = "Hello world";
+const char *s2 = "world";
+const char *s3 = "foobarbaz";
+const char *s4 = "";
+EOF
+
+cat <<EOF | $CC -o $t/b.o -c -xc -O -
+#include <stdio.h>
+extern const char *s1, *s2, *s3, *s4;
+const char *s5 = "barbaz";
+const char *s6 = "arbaz";
+int main() { printf("%s|%s|%s|%s|%s|%s\n", s1, s2, s3, s4, s5, s6); }
+EOF
+
+$CC -B. -o $t/exe1 $t/a.o $t/b.o
+$QEMU $t/exe1 | grep -q '^Hello world|world|foobarbaz||barbaz|arbaz$'
+readelf -p .rodata.str1.1 $t/exe1 | grep -q ']  world$'
+
+$CC -B. -o $t/exe2 $t/a.o $t/b.o -Wl,-O2
+$QEMU $t/exe2 | grep -q '^Hello world|world|foobarbaz||barbaz|arbaz$'
+! readelf -p .rodata.str1.1 $t/exe2 | grep -Eq ']  (world|barbaz|arbaz)$' || false
+
+$CC -B. -o $t/exe3 $t/a.o $t/b.o -Wl,--tail-merge-strings -Wl,--no-threads
+cmp $t/exe2 $t/exe3
+
+$CC -B. -o $t/exe4 $t/a.o $t/b.o -Wl,-O2 -Wl,--no-tail-merge-strings
+readelf -p .rodata.str1.1 $t/exe4 | grep -q ']  world$'
+
+# Mergeable strings in debug info are tail-merged too.
+$CC -o $t/c.o -c -xc -g - <<EOF
+int foo_bar_baz;
+int bar_baz;
+EOF
+
+$CC -B. -o $t/exe5 $t/a.o $t/b.o $t/c.o -Wl,-O2
+readelf --debug-dump=info $t/exe5 | grep -q 'bar_baz'
+readelf -p .debug_str $t/exe5 | grep -q foo_bar_baz
+! readelf -p .debug_str $t/exe5 | grep -q ']  bar_baz$' || false